@@ -1,6 +1,8 @@
 #ifndef ARM_H
 #define ARM_H
 
+#include <stdint.h>
+
 // Portable across ARMv7 and ARMv8 Aarch32
 
 static inline void int_enable()
@@ -12,6 +14,31 @@ static inline void int_disable()
     asm volatile ("cpsid i");
 }
 
+// For critical sections that may be entered with interrupts disabled (e.g.
+// from an ISR): returns the state for int_restore, which re-enables only if
+// interrupts were enabled on entry.
+static inline uint32_t int_save_disable()
+{
+    uint32_t state;
+#if __ARM_ARCH_PROFILE == 'M'
+    asm volatile ("mrs %0, primask\n"
+                  "cpsid i" : "=r" (state) : : "memory");
+#else // A/R: CPSR
+    asm volatile ("mrs %0, cpsr\n"
+                  "cpsid i" : "=r" (state) : : "memory");
+#endif
+    return state;
+}
+static inline void int_restore(uint32_t state)
+{
+#if __ARM_ARCH_PROFILE == 'M'
+    asm volatile ("msr primask, %0" : : "r" (state) : "memory");
+#else // A/R: CPSR.I
+    if (!(state & (1 << 7)))
+        int_enable();
+#endif
+}
+
 
 // Enables/disables interrupts that bypass the interrupt controller
 void sys_ints_enable();
@@ -19,4 +46,8 @@ void sys_ints_disable();
 
 unsigned self_core_id();
 
+// Free-running count of CPU clock cycles, wraps around at 32 bits
+void cycle_counter_enable();
+uint32_t cycle_counter_read();
+
 #endif // ARM_H
@@ -1,3 +1,5 @@
+#include "hwinfo.h"
+#include "regops.h"
 #include "systick.h"
 
 #include "arm.h" // the interface being implemented
@@ -13,3 +15,22 @@ void sys_ints_disable()
     systick_disable();
     // others (see comment above)
 }
+
+#define REG__DEMCR              0xdfc /* in SCS */
+#define REG__DEMCR__TRCENA      (1 << 24)
+
+#define REG__DWT_CTRL           0x000
+#define REG__DWT_CYCCNT         0x004
+#define REG__DWT_CTRL__CYCCNTENA (1 << 0)
+
+void cycle_counter_enable()
+{
+    REGB_SET32(TRCH_SCS_BASE, REG__DEMCR, REG__DEMCR__TRCENA);
+    REGB_WRITE32(TRCH_DWT_BASE, REG__DWT_CYCCNT, 0);
+    REGB_SET32(TRCH_DWT_BASE, REG__DWT_CTRL, REG__DWT_CTRL__CYCCNTENA);
+}
+
+uint32_t cycle_counter_read()
+{
+    return REGB_READ32(TRCH_DWT_BASE, REG__DWT_CYCCNT);
+}
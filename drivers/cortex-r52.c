@@ -16,3 +16,23 @@ unsigned self_core_id()
     asm volatile ("mrc p15, 0, %0, c0, c0, 5":"=r" (id) :);
     return id;
 }
+
+#define PMCR__E         (1 << 0) /* enable all counters */
+#define PMCR__C         (1 << 2) /* reset cycle counter */
+#define PMCNTEN__C      (1u << 31)
+
+void cycle_counter_enable()
+{
+    uint32_t pmcr;
+    asm volatile ("mrc p15, 0, %0, c9, c12, 0":"=r" (pmcr) :);
+    pmcr |= PMCR__E | PMCR__C;
+    asm volatile ("mcr p15, 0, %0, c9, c12, 0" : : "r" (pmcr));
+    asm volatile ("mcr p15, 0, %0, c9, c12, 1" : : "r" (PMCNTEN__C));
+}
+
+uint32_t cycle_counter_read()
+{
+    uint32_t cycles;
+    asm volatile ("mrc p15, 0, %0, c9, c13, 0":"=r" (cycles) :);
+    return cycles;
+}
@@ -7,6 +7,7 @@
 #include "mem.h"
 #include "dma.h"
 #include "bit.h"
+#include "work.h"
 
 #define PL330_DEBUG_MCGEN
 
@@ -351,6 +352,7 @@ struct _pl330_req {
         void *cb_arg;
         int rc;
         struct dma_tx *tx;
+        struct work cb_work; /* calls cb, from the main loop */
 };
 
 /* A DMAC Thread */
@@ -1370,9 +1372,22 @@ void dma_destroy(struct dma *dma)
     OBJECT_FREE(pl330);
 }
 
-struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
-                            uint32_t *src, uint32_t *dst, unsigned sz,
-                            dma_cb_t cb, void *cb_arg)
+/* Deferred from the ISRs: the request stays busy until the callback ran */
+static void req_complete(void *arg)
+{
+    struct _pl330_req *req = arg;
+    struct dma_tx *tx = req->tx;
+    printf("DMA: completed: rc %u\r\n", req->rc);
+    req->cb(req->cb_arg, req->rc);
+    req->desc = NULL; // release request state
+    req->tx = NULL;
+    OBJECT_FREE(tx);
+}
+
+static struct dma_tx *transfer(struct dma *dma, unsigned chan,
+                               uint32_t *src, bool src_inc,
+                               uint32_t *dst, unsigned sz,
+                               dma_cb_t cb, void *cb_arg)
 {
     ASSERT(dma);
     ASSERT(src && dst);
@@ -1404,7 +1419,7 @@ struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
     struct _pl330_req *req = &thrd->req[idx];
 
     if (thrd->req[idx].desc) {
-        printf("DMA: channel %u busy\r\n", idx);
+        printf("DMA: channel %u busy\r\n", chan);
         return NULL;
     }
 
@@ -1424,7 +1439,7 @@ struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
     desc->px.bytes = sz;
 
     desc->rqcfg.dst_inc = 1;
-    desc->rqcfg.src_inc = 1;
+    desc->rqcfg.src_inc = src_inc;
     desc->rqcfg.nonsecure = 0;
     desc->rqcfg.privileged = 1;
     desc->rqcfg.insnaccess = 1;
@@ -1448,6 +1463,7 @@ struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
     u32 ccr = _prepare_ccr(&desc->rqcfg);
 
     thrd->ev = chan; // one-to-one thread-event allocation 
+    pl330->events[thrd->ev] = thrd->id;
 
     struct _xfer_spec xs;
     xs.ccr = ccr;
@@ -1475,12 +1491,15 @@ struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
     req->cb = cb;
     req->cb_arg = cb_arg;
     req->rc = -1;
+    if (cb)
+        work_init(&req->cb_work, pl330->name, WORK_PRIO_NORMAL,
+                  req_complete, req);
 
     _setup_req(pl330, 0, thrd, idx, &xs);
 
     u8 insn[6] = {0, 0, 0, 0, 0, 0};
     struct _arg_GO go;
-    go.chan = 0;
+    go.chan = thrd->id;
     go.addr = (u32)thrd->req[idx].mc_bus;
     go.ns = 0; // all users of this driver run in secure mode
     _emit_GO(0, insn, &go);
@@ -1492,6 +1511,20 @@ struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
     return tx;
 }
 
+struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
+                            uint32_t *src, uint32_t *dst, unsigned sz,
+                            dma_cb_t cb, void *cb_arg)
+{
+    return transfer(dma, chan, src, /* src_inc */ true, dst, sz, cb, cb_arg);
+}
+
+struct dma_tx *dma_transfer_fixed_src(struct dma *dma, unsigned chan,
+                                      uint32_t *src, uint32_t *dst, unsigned sz,
+                                      dma_cb_t cb, void *cb_arg)
+{
+    return transfer(dma, chan, src, /* src_inc */ false, dst, sz, cb, cb_arg);
+}
+
 int dma_wait(struct dma_tx *tx)
 {
     struct _pl330_req *req = tx->req;
@@ -1549,10 +1582,9 @@ void dma_abort_isr(struct dma *dma)
                 req->desc->status = DONE;
                 thrd->req_running = -1;
 
-                if (req->cb) {
-                    req->cb(req->cb_arg, req->rc);
-                    req->desc = NULL; // release request state
-                } // else: channel busy until reaped by dma_wait
+                if (req->cb)
+                    work_queue(&req->cb_work);
+                // else: channel busy until reaped by dma_wait
             }
             i++;
         }
@@ -1566,8 +1598,6 @@ void dma_event_isr(struct dma *dma, unsigned ev)
     int id, active;
     struct pl330_thread *thrd;
 
-    printf("DMA %s: ISR: event %u\r\n", pl330->name, ev);
-
     u32 inten = readl(regs + INTEN);
 
     /* Clear the event */
@@ -1593,12 +1623,8 @@ void dma_event_isr(struct dma *dma, unsigned ev)
     req->desc->status = DONE;
     thrd->req_running = -1;
 
-    if (req->cb) {
-        req->cb(req->cb_arg, req->rc);
-        struct dma_tx *tx = req->tx;
-        req->desc = NULL; // release request state
-        req->tx = NULL;
-        OBJECT_FREE(tx);
-    } // else: channel busy until reaped by dma_wait
+    if (req->cb)
+        work_queue(&req->cb_work);
+    // else: channel busy until reaped by dma_wait
 }
 
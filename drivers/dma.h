@@ -20,6 +20,10 @@ void dma_destroy(struct dma *dma);
 struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
                             uint32_t *src, uint32_t *dst, unsigned sz,
                             dma_cb_t cb, void *cb_arg);
+// Same, but every beat reads @src itself (e.g. the data port of a device)
+struct dma_tx *dma_transfer_fixed_src(struct dma *dma, unsigned chan,
+                                      uint32_t *src, uint32_t *dst, unsigned sz,
+                                      dma_cb_t cb, void *cb_arg);
 int dma_wait(struct dma_tx *tx);
 
 void dma_abort_isr(struct dma *dma);
@@ -0,0 +1,234 @@
+#define DEBUG 0
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "console.h"
+#include "panic.h"
+
+#include "ecc-eng.h"
+
+#define REG__DECODE_INPUT0      0x00
+#define REG__DECODE_INPUT1      0x04
+#define REG__DECODE_OUTPUT      0x08
+#define REG__ENCODE_INPUT       0x10
+#define REG__ENCODE_OUTPUT0     0x14
+#define REG__ENCODE_OUTPUT1     0x18
+#define REG__DECODE_STATUS      0x20 // incremented on each completed decode
+
+#define POLL_LIMIT 1000 // iterations, before declaring the engine dead
+
+#ifndef ECC_ENG_MODEL
+#include "regops.h"
+#define ENG_READ(base, reg)         REGB_READ32(base, reg)
+#define ENG_WRITE(base, reg, val)   REGB_WRITE32(base, reg, val)
+#else // register model, for the host benchmark in tools/ecc-bench
+uint32_t ecc_eng_model_read(unsigned reg);
+void ecc_eng_model_write(unsigned reg, uint32_t val);
+#define ENG_READ(base, reg)         ((void)(base), ecc_eng_model_read(reg))
+#define ENG_WRITE(base, reg, val)   ((void)(base), ecc_eng_model_write(reg, val))
+#endif // ECC_ENG_MODEL
+
+static inline unsigned parity32(uint32_t x)
+{
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    x ^= x >> 2;
+    x ^= x >> 1;
+    return x & 1;
+}
+
+// The encoder is assumed to mirror the decoder's register pair: OUTPUT0
+// returns the data word once it is encoded, OUTPUT1 its check byte. There
+// is no status counter for encodes, so completion is OUTPUT0 == input.
+static int eng_encode(uintptr_t base, uint32_t data, uint8_t *check)
+{
+    unsigned poll;
+
+    ENG_WRITE(base, REG__ENCODE_INPUT, data);
+    for (poll = 0; ENG_READ(base, REG__ENCODE_OUTPUT0) != data; ++poll)
+        if (poll == POLL_LIMIT)
+            return ECC_ENG_TIMEOUT;
+    *check = ENG_READ(base, REG__ENCODE_OUTPUT1) & 0xff;
+    return 0;
+}
+
+#define LEARN_CHECKS 16 // words with many bits set, to check linearity
+
+// Computed rather than tabulated, since BL0 runs relocated
+int ecc_eng_learn(uintptr_t base, struct ecc_code *code)
+{
+    uint8_t check;
+    unsigned d, k, j;
+    uint32_t w;
+
+    code->learned = false;
+    for (d = 0; d < 32; ++d) // unit words first: 0 may match a stale output
+        if (eng_encode(base, 1u << d, &code->cols[d]))
+            return ECC_ENG_TIMEOUT;
+    if (eng_encode(base, 0, &code->check0))
+        return ECC_ENG_TIMEOUT;
+
+    for (j = 0; j < ECC_CHECK_BITS; ++j)
+        code->masks[j] = 0;
+    for (d = 0; d < 32; ++d) {
+        uint8_t col = code->cols[d] ^ code->check0;
+        // single errors are correctable only if each data bit flips a
+        // distinct set of at least two check bits
+        if (!(col & (col - 1))) {
+            DPRINTF("ECC: data bit %u: check column %x\r\n", d, col);
+            return -1;
+        }
+        for (k = 0; k < d; ++k)
+            if (code->cols[k] == col) {
+                DPRINTF("ECC: data bits %u, %u: same check column\r\n", k, d);
+                return -1;
+            }
+        code->cols[d] = col;
+        for (j = 0; j < ECC_CHECK_BITS; ++j)
+            if (col & (1 << j))
+                code->masks[j] |= 1u << d;
+    }
+
+    for (k = 0, w = ~0u; k < LEARN_CHECKS; ++k, w = w * 2654435761u + 1) {
+        if (eng_encode(base, w, &check))
+            return ECC_ENG_TIMEOUT;
+        if (check != ecc_sw_encode(code, w)) {
+            DPRINTF("ECC: code not linear: %x: check %x\r\n", w, check);
+            return -1;
+        }
+    }
+    code->learned = true;
+    return 0;
+}
+
+uint8_t ecc_sw_encode(const struct ecc_code *code, uint32_t data)
+{
+    unsigned check = code->check0;
+    unsigned j;
+
+    for (j = 0; j < ECC_CHECK_BITS; ++j)
+        check ^= parity32(data & code->masks[j]) << j;
+    return check;
+}
+
+// Whether an error is detected rather than miscorrected depends on the
+// engine's code: with odd-weight columns (e.g. Hsiao), all double errors are.
+int ecc_sw_decode_word(const struct ecc_code *code, uint32_t *data,
+                       uint8_t check)
+{
+    unsigned syn = ecc_sw_encode(code, *data) ^ check;
+    unsigned d;
+
+    if (!syn)
+        return 0;
+    if (!(syn & (syn - 1))) // flip in a check bit
+        return 1;
+    for (d = 0; d < 32; ++d)
+        if (code->cols[d] == syn) {
+            *data ^= 1u << d;
+            return 1;
+        }
+    return -1;
+}
+
+int ecc_sw_decode(const struct ecc_code *code, uint32_t *dst,
+                  const volatile uint32_t *src, unsigned nwords,
+                  struct ecc_stats *stats)
+{
+    unsigned corrected = 0, uncorrectable = 0;
+    unsigned w = 0;
+
+    while (w < nwords) {
+        uint32_t checks = src[ECC_GROUP_DATA_WORDS];
+        for (unsigned i = 0; i < ECC_GROUP_DATA_WORDS && w < nwords;
+             ++i, ++w, checks >>= 8) {
+            uint32_t d = src[i];
+            int rc = ecc_sw_decode_word(code, &d, checks & 0xff);
+            if (rc > 0)
+                corrected++;
+            else if (rc < 0)
+                uncorrectable++;
+            *dst++ = d;
+        }
+        src += ECC_GROUP_WORDS;
+    }
+
+    if (stats) {
+        stats->words += nwords;
+        stats->corrected += corrected;
+        stats->uncorrectable += uncorrectable;
+    }
+    return uncorrectable ? -1 : 0;
+}
+
+// Software-pipelined: while the engine decodes a word, the corresponding word
+// of the next group is fetched from (slow) storage. The status counter is
+// read from the engine once, and then tracked locally, so that each word
+// costs exactly two register writes, the status poll, and one output read.
+int ecc_eng_decode(uintptr_t base, const struct ecc_code *code,
+                   uint32_t *dst, const volatile uint32_t *src,
+                   unsigned nwords, struct ecc_stats *stats)
+{
+    uint32_t cur[ECC_GROUP_DATA_WORDS], next[ECC_GROUP_DATA_WORDS];
+    uint32_t cur_checks, next_checks = 0;
+    unsigned corrected = 0, uncorrectable = 0;
+    unsigned w = 0, i, n, poll;
+
+    if (!nwords)
+        return 0;
+
+    uint32_t done = ENG_READ(base, REG__DECODE_STATUS);
+
+    n = nwords < ECC_GROUP_DATA_WORDS ? nwords : ECC_GROUP_DATA_WORDS;
+    for (i = 0; i < n; ++i)
+        cur[i] = src[i];
+    cur_checks = src[ECC_GROUP_DATA_WORDS];
+
+    while (w < nwords) {
+        const volatile uint32_t *next_src = src + ECC_GROUP_WORDS;
+        unsigned remaining = nwords - w - n;
+        unsigned next_n = remaining < ECC_GROUP_DATA_WORDS ?
+                            remaining : ECC_GROUP_DATA_WORDS;
+
+        for (i = 0; i < n; ++i, cur_checks >>= 8) {
+            ENG_WRITE(base, REG__DECODE_INPUT0, cur[i]);
+            ENG_WRITE(base, REG__DECODE_INPUT1, cur_checks & 0xff);
+            ++done;
+
+            if (i < next_n) // overlap with decode
+                next[i] = next_src[i];
+
+            for (poll = 0; ENG_READ(base, REG__DECODE_STATUS) != done; ++poll)
+                if (poll == POLL_LIMIT)
+                    return ECC_ENG_TIMEOUT;
+
+            uint32_t out = ENG_READ(base, REG__DECODE_OUTPUT);
+            if (out != cur[i])
+                corrected++;
+            if (code) { // a flip in a check bit is left alone
+                unsigned syn = ecc_sw_encode(code, out) ^ (cur_checks & 0xff);
+                if (syn & (syn - 1))
+                    uncorrectable++;
+            }
+            *dst++ = out;
+        }
+        w += n;
+
+        if (next_n)
+            next_checks = next_src[ECC_GROUP_DATA_WORDS];
+        for (i = 0; i < next_n; ++i)
+            cur[i] = next[i];
+        cur_checks = next_checks;
+        n = next_n;
+        src = next_src;
+    }
+
+    if (stats) {
+        stats->words += nwords;
+        stats->corrected += corrected;
+        stats->uncorrectable += uncorrectable;
+    }
+    return uncorrectable ? -1 : 0;
+}
@@ -0,0 +1,62 @@
+#ifndef ECC_ENG_H
+#define ECC_ENG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Layout of ECC-protected data in storage: groups of 5 words, 4 data words
+// followed by one word with their check bytes (byte i for data word i). The
+// last group is padded to full size. Each check byte is the engine's check
+// code of the data word (see struct ecc_code).
+#define ECC_GROUP_DATA_WORDS 4
+#define ECC_GROUP_WORDS      5
+
+#define ECC_CHECK_BITS       8
+
+#define ECC_ENG_TIMEOUT -2 // engine did not respond
+
+// The engine's check code, as observed through its encoder by ecc_eng_learn:
+// the check byte of a word is check0 XOR the columns of its set bits. The
+// engine's check-bit matrix is not documented, so the software decoder works
+// from this rather than from a code of its own.
+struct ecc_code {
+    bool learned;
+    uint8_t check0;                 // check byte of the zero word
+    uint8_t cols[32];               // check bits flipped by each data bit
+    uint32_t masks[ECC_CHECK_BITS]; // data bits covered by each check bit
+};
+
+struct ecc_stats {
+    unsigned words;
+    unsigned corrected;
+    unsigned uncorrectable;
+};
+
+// Derive the code from the engine's encoder, and cross-check it on a few
+// more words. Fails (and leaves code->learned false) if the engine does not
+// respond, or its code is not a linear single-error-correcting one.
+int ecc_eng_learn(uintptr_t base, struct ecc_code *code);
+
+uint8_t ecc_sw_encode(const struct ecc_code *code, uint32_t data);
+// Returns 0 if no error, 1 if corrected, -1 if uncorrectable
+int ecc_sw_decode_word(const struct ecc_code *code, uint32_t *data,
+                       uint8_t check);
+
+// Decode nwords data words from storage at src (layout above) into dst.
+// Counts are accumulated into stats (may be NULL).
+// Returns 0 on success, -1 if any word was uncorrectable.
+int ecc_sw_decode(const struct ecc_code *code, uint32_t *dst,
+                  const volatile uint32_t *src, unsigned nwords,
+                  struct ecc_stats *stats);
+
+// Same, but via the hardware ECC engine at base. The engine's status
+// register only counts decodes, so by itself it reports corrected words
+// (output differs from input) but not uncorrectable ones: with a learned
+// code (may be NULL), each output is checked against its check byte, which
+// costs a software encode per word.
+// Returns ECC_ENG_TIMEOUT if the engine stops responding.
+int ecc_eng_decode(uintptr_t base, const struct ecc_code *code,
+                   uint32_t *dst, const volatile uint32_t *src,
+                   unsigned nwords, struct ecc_stats *stats);
+
+#endif // ECC_ENG_H
@@ -26,9 +26,10 @@
 #define GICD_ISPENDRn		0x0200
 #define GICD_ICPENDRn		0x0280
 #define GICD_ISACTIVERn		0x0300
+#define GICD_IPRIORITYRn	0x0400
 #define GICD_ICFGRn             0x0c00
 #define GICD_IGROUPMODRn        0x0d00
-#define GICD_IROUTERn           0x6100
+#define GICD_IROUTERn           0x6100 // of the first SPI (INTID 32)
 
 #define GICR_TYPER              0x0008
 #define GICR_WAKER              0x0014
@@ -36,6 +37,7 @@
 #define GICR_IGROUPRn           0x0080
 #define GICR_ISENABLER0         0x0100
 #define GICR_ICENABLER0         0x0180
+#define GICR_IPRIORITYRn        0x0400
 #define GICR_ICFGR0             0x0c00
 #define GICR_ICFGR1             0x0c04
 #define GICR_IGROUPMODR0        0x0d00
@@ -46,6 +48,10 @@
 
 #define GICD_IROUTERn__IRM     (1 << 31)
 
+// 64-bit, but Aff3 (in the upper word) is 0, so only the lower word is used
+#define GICD_IROUTER(intid) \
+    (GICD(GICD_IROUTERn) + ((intid) - GIC_INTERNAL) * sizeof(uint64_t))
+
 #define GICD_TYPER__IT_LINES_NUMBER__MASK       0xf
 #define GICD_TYPER__IT_LINES_NUMBER__SHIFT        0
 
@@ -184,6 +190,82 @@ void gic_int_disable(unsigned irq, gic_irq_type_t type) {
     }
 }
 
+static void write_prio(uintptr_t reg, unsigned intid, unsigned prio)
+{
+    unsigned shift = (intid % 4) * 8;
+    uint32_t val = REGB_READ32(gic.base, reg + (intid / 4) * 4);
+    val = (val & ~(0xff << shift)) | ((prio & 0xff) << shift);
+    REGB_WRITE32(gic.base, reg + (intid / 4) * 4, val);
+}
+
+void gic_int_set_prio(unsigned irq, gic_irq_type_t type, unsigned prio)
+{
+    check_irq(irq, type);
+    unsigned intid = irq_to_intid(irq, type);
+
+    printf("GIC: IRQ #%u (INTID %u) type %u: prio 0x%x\r\n",
+           irq, intid, type, prio);
+
+    if (use_redist(type)) {
+        /* for simplicity, allow controlling only core's own interrupts */
+        unsigned core = self_core_id();
+        write_prio(GICR_PPI_SGI(core, GICR_IPRIORITYRn), intid, prio);
+    } else {
+        write_prio(GICD(GICD_IPRIORITYRn), intid, prio);
+    }
+}
+
+void gic_set_prio_grouping(unsigned preempt_bits)
+{
+    // For Group 1, the group priority is in bits [7:BPR1], and the GIC
+    // raises a BPR1 below its minimum (8 - implemented bits) to the minimum
+    unsigned bpr = preempt_bits >= 7 ? 1 : 8 - preempt_bits;
+    if (bpr > 7)
+        bpr = 7;
+    DPRINTF("GIC: core %u: BPR1 <- %u\r\n", self_core_id(), bpr);
+    asm volatile("mcr p15, 0, %0, c12, c12, 3\n" // ICC_BPR1
+                 "isb" : : "r" (bpr) : "memory");
+}
+
+unsigned gic_set_prio_mask(unsigned prio)
+{
+    uint32_t pmr, prev;
+    // An interrupt is taken if its priority is below (more urgent than) PMR
+    pmr = prio >= 0x100 ? 0xff : prio;
+    asm volatile("mrc p15, 0, %0, c4, c6, 0\n" // ICC_PMR
+                 "mcr p15, 0, %1, c4, c6, 0\n"
+                 "isb" : "=&r" (prev) : "r" (pmr) : "memory");
+    return prev == 0xff ? 0x100 : prev;
+}
+
+void gic_int_set_affinity(unsigned irq, gic_irq_type_t type, unsigned core)
+{
+    ASSERT(type == GIC_IRQ_TYPE_SPI); // the rest are per core by definition
+    ASSERT(core == INTC_AFFINITY_ANY || core < gic.num_cores);
+    unsigned intid = irq_to_intid(irq, type);
+
+    if (core == INTC_AFFINITY_ANY)
+        printf("GIC: IRQ #%u (INTID %u): route to any core\r\n", irq, intid);
+    else
+        printf("GIC: IRQ #%u (INTID %u): route to core %u\r\n", irq, intid, core);
+
+    // Affinity routing, as set up by the startup code, is required for
+    // IROUTER, and Aff0 is the core within this cluster (Aff1..3 = 0)
+    ASSERT(is_affinity_routing());
+    REGB_WRITE32(gic.base, GICD_IROUTER(intid),
+                 core == INTC_AFFINITY_ANY ? GICD_IROUTERn__IRM : core);
+}
+
+void gic_sgi_send(unsigned sgi, unsigned core)
+{
+    // ICC_SGI1R: INTID [27:24], target list of Aff0 [15:0], Aff1..3 = 0
+    uint32_t lo = (sgi << 24) | (1 << core);
+    uint32_t hi = 0;
+    DPRINTF("GIC: send SGI %u to core %u\r\n", sgi, core);
+    asm volatile("dsb\n"
+                 "mcrr p15, 0, %0, %1, c12" : : "r" (lo), "r" (hi) : "memory");
+}
+
 void gic_disable_all()
 {
     unsigned c;
@@ -227,6 +309,16 @@ static void gic_op_disable_all()
     gic_disable_all();
 }
 
+static void gic_op_int_set_prio(struct irq *irq, unsigned prio)
+{
+    gic_int_set_prio(irq->n, irq->type, prio);
+}
+
+static void gic_op_int_set_affinity(struct irq *irq, unsigned core)
+{
+    gic_int_set_affinity(irq->n, irq->type, core);
+}
+
 unsigned gic_op_int_num(struct irq *irq)
 {
     return irq->n;
@@ -240,6 +332,10 @@ static const struct intc_ops gic_ops = {
     .int_enable = gic_op_int_enable,
     .int_disable = gic_op_int_disable,
     .disable_all = gic_op_disable_all,
+    .int_set_prio = gic_op_int_set_prio,
+    .set_prio_grouping = gic_set_prio_grouping,
+    .set_prio_mask = gic_set_prio_mask,
+    .int_set_affinity = gic_op_int_set_affinity,
     .int_num = gic_op_int_num,
     .int_type = gic_op_int_type,
 };
@@ -257,8 +353,18 @@ void gic_init(uintptr_t base, unsigned num_cores)
     /* Set routing mode to all participating cores
        (important to support running on any core in an SMP set) */
     for (/* 0-31 reserved */ n = 32; n < 32 * (gic.it_lines_num + 1); ++n) {
-        REGB_SET32(gic.base, GICD(GICD_IROUTERn) + (n * sizeof(uint64_t)),
-                   GICD_IROUTERn__IRM);
+        REGB_WRITE32(gic.base, GICD_IROUTER(n), GICD_IROUTERn__IRM);
+    }
+
+    /* Out of reset, all are at the highest priority */
+    uint32_t prio = INTC_PRIO_DEFAULT * 0x01010101u;
+    for (n = 32 / 4; n < 32 * (gic.it_lines_num + 1) / 4; ++n)
+        REGB_WRITE32(gic.base, GICD(GICD_IPRIORITYRn) + n * 4, prio);
+    if (is_affinity_routing()) {
+        for (unsigned c = 0; c < gic.num_cores; ++c)
+            for (n = 0; n < 32 / 4; ++n)
+                REGB_WRITE32(gic.base, GICR_PPI_SGI(c, GICR_IPRIORITYRn) + n * 4,
+                             prio);
     }
 
     intc_register(&gic_ops);
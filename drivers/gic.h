@@ -24,6 +24,20 @@ void gic_int_enable(unsigned irq, gic_irq_type_t type, gic_irq_cfg_t cfg);
 void gic_int_disable(unsigned irq, gic_irq_type_t type);
 void gic_disable_all();
 
+// See intc.h for the meaning of priorities and masks; gic_init sets all
+// interrupts to INTC_PRIO_DEFAULT. The grouping and the mask are in the CPU
+// interface, so they are per core.
+void gic_int_set_prio(unsigned irq, gic_irq_type_t type, unsigned prio);
+void gic_set_prio_grouping(unsigned preempt_bits); // ICC_BPR1
+unsigned gic_set_prio_mask(unsigned prio); // ICC_PMR, returns previous
+
+// Deliver an SPI only to the given core in this cluster (by Aff0), or to any
+// participating core (INTC_AFFINITY_ANY, which is what gic_init sets for all)
+void gic_int_set_affinity(unsigned irq, gic_irq_type_t type, unsigned core);
+
+// Interrupt a core in this cluster (by Aff0) with a software-generated IRQ
+void gic_sgi_send(unsigned sgi, unsigned core);
+
 // For use by intc.h common adapter
 
 struct irq;
@@ -239,13 +239,14 @@ size_t mbox_read(struct mbox *m, void *buf, size_t sz)
     if (sz % sizeof(uint32_t))
         len++;
 
-    printf("mbox_read: base %p instance %u\r\n", m->base, m->instance);
-    printf("mbox_read: msg: ");
+    // called from deferred work, which may run on a core that must not print
+    DPRINTF("mbox_read: base %p instance %u\r\n", m->base, m->instance);
+    DPRINTF("mbox_read: msg: ");
     for (i = 0; i < len && i < HPSC_MBOX_DATA_REGS; i++) {
         msg[i] = REGB_READ32(m->base, REG_DATA + (i * sizeof(uint32_t)));
-        printf("%x ", msg[i]);
+        DPRINTF("%x ", msg[i]);
     }
-    printf("\r\n");
+    DPRINTF("\r\n");
 
     return i * sizeof(uint32_t);
 }
@@ -260,27 +261,27 @@ void mbox_event_set_rcv(struct mbox *m)
 void mbox_event_set_ack(struct mbox *m)
 {
     static const uint32_t val = HPSC_MBOX_EVENT_B;
-    printf("mbox_event_set_ack: raise int B <- %08lx\r\n", val);
+    DPRINTF("mbox_event_set_ack: raise int B <- %08lx\r\n", val);
     REGB_WRITE32(m->base, REG_EVENT_SET, val);
 }
 
 void mbox_event_clear_rcv(struct mbox *m)
 {
     static const uint32_t val = HPSC_MBOX_EVENT_A;
-    printf("mbox_event_clear_rcv: clear int A <- %08lx\r\n", val);
+    DPRINTF("mbox_event_clear_rcv: clear int A <- %08lx\r\n", val);
     REGB_WRITE32(m->base, REG_EVENT_CLEAR, val);
 }
 
 void mbox_event_clear_ack(struct mbox *m)
 {
     static const uint32_t val = HPSC_MBOX_EVENT_B;
-    printf("mbox_event_clear_ack: clear int B <- %08lx\r\n", val);
+    DPRINTF("mbox_event_clear_ack: clear int B <- %08lx\r\n", val);
     REGB_WRITE32(m->base, REG_EVENT_CLEAR, val);
 }
 
 static void mbox_instance_rcv_isr(struct mbox *mbox)
 {
-    printf("mbox_instance_rcv_isr: base %p instance %u\r\n", mbox->base, mbox->instance);
+    DPRINTF("mbox_instance_rcv_isr: base %p instance %u\r\n", mbox->base, mbox->instance);
     if (mbox->cb.rcv_cb)
         mbox->cb.rcv_cb(mbox->cb_arg);
     else
@@ -289,7 +290,7 @@ static void mbox_instance_rcv_isr(struct mbox *mbox)
 
 static void mbox_instance_ack_isr(struct mbox *mbox)
 {
-    printf("mbox_instance_ack_isr: base %p instance %u\r\n", mbox->base, mbox->instance);
+    DPRINTF("mbox_instance_ack_isr: base %p instance %u\r\n", mbox->base, mbox->instance);
     if (mbox->cb.ack_cb)
         mbox->cb.ack_cb(mbox->cb_arg);
     else
@@ -313,11 +314,11 @@ static void mbox_isr(unsigned event, unsigned interrupt)
         // Are we 'signed up' for this event (A) from this mailbox (i)?
         // Two criteria: (1) Cause is set, and (2) Mapped to our IRQ
         val = REGB_READ32(mbox->base, REG_EVENT_CAUSE);
-        printf("mbox_isr: cause -> %08lx\r\n", val);
+        DPRINTF("mbox_isr: cause -> %08lx\r\n", val);
         if (!(val & event))
             continue; // this mailbox didn't raise the interrupt
         val = REGB_READ32(mbox->base, REG_INT_ENABLE);
-        printf("mbox_isr: int enable -> %08lx\r\n", val);
+        DPRINTF("mbox_isr: int enable -> %08lx\r\n", val);
         if (!(val & interrupt))
             continue; // this mailbox has an event but it's not ours
 
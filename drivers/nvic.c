@@ -2,6 +2,7 @@
 
 #include "console.h"
 #include "object.h"
+#include "panic.h"
 #include "regops.h"
 #include "intc.h"
 
@@ -11,6 +12,13 @@
 #define NVIC_ISER0 0x100
 #define NVIC_ICER0 0x180
 #define NVIC_ICPR0 0x280
+#define NVIC_IPR0  0x400 // one byte per IRQ
+
+#define SCB_AIRCR  0xd0c
+
+#define SCB_AIRCR__VECTKEY          (0x05fa << 16)
+#define SCB_AIRCR__PRIGROUP__SHIFT  8
+#define SCB_AIRCR__PRIGROUP__MASK   (0x7 << SCB_AIRCR__PRIGROUP__SHIFT)
 
 #define NVIC_ICTR__INTLINESNUM__MASK 0xf
 
@@ -40,6 +48,37 @@ void nvic_int_disable(unsigned irq)
     REGB_WRITE32(nvic.base, NVIC_ICER0 + (irq / 32) * 4, 1 << (irq % 32));
 }
 
+void nvic_int_set_prio(unsigned irq, unsigned prio)
+{
+    printf("NVIC IRQ #%u: prio 0x%x\r\n", irq, prio);
+    uintptr_t reg = NVIC_IPR0 + (irq / 4) * 4;
+    unsigned shift = (irq % 4) * 8;
+    uint32_t val = REGB_READ32(nvic.base, reg);
+    val = (val & ~(0xff << shift)) | ((prio & 0xff) << shift);
+    REGB_WRITE32(nvic.base, reg, val);
+}
+
+void nvic_set_prio_grouping(unsigned preempt_bits)
+{
+    // Group priority is in bits [7:PRIGROUP+1], so at most 7 bits of it
+    unsigned prigroup = preempt_bits >= 7 ? 0 : 7 - preempt_bits;
+    uint32_t val = REGB_READ32(nvic.base, SCB_AIRCR);
+    val = (val & ~(SCB_AIRCR__PRIGROUP__MASK | 0xffff0000)) |
+          SCB_AIRCR__VECTKEY | (prigroup << SCB_AIRCR__PRIGROUP__SHIFT);
+    REGB_WRITE32(nvic.base, SCB_AIRCR, val);
+}
+
+unsigned nvic_set_prio_mask(unsigned prio)
+{
+    uint32_t basepri, prev;
+    // BASEPRI of 0 masks nothing, so the mask of 0 (all) does not exist
+    basepri = prio >= 0x100 ? 0 : prio;
+    asm volatile ("mrs %0, basepri\n"
+                  "msr basepri, %1\n"
+                  : "=&r" (prev) : "r" (basepri) : "memory");
+    return prev ? prev : 0x100;
+}
+
 unsigned nvic_num_ints()
 {
     return (REGB_READ32(nvic.base, NVIC_ICTR) & NVIC_ICTR__INTLINESNUM__MASK) * 32;
@@ -78,6 +117,14 @@ static void nvic_op_disable_all()
 {
     nvic_disable_all();
 }
+static void nvic_op_int_set_prio(struct irq *irq, unsigned prio)
+{
+    nvic_int_set_prio(irq->n, prio);
+}
+static void nvic_op_int_set_affinity(struct irq *irq, unsigned core)
+{
+    ASSERT(core == INTC_AFFINITY_ANY || core == 0); // single core
+}
 unsigned nvic_op_int_num(struct irq *irq)
 {
     return irq->n;
@@ -91,6 +138,10 @@ static const struct intc_ops nvic_ops = {
     .int_enable = nvic_op_int_enable,
     .int_disable = nvic_op_int_disable,
     .disable_all = nvic_op_disable_all,
+    .int_set_prio = nvic_op_int_set_prio,
+    .set_prio_grouping = nvic_set_prio_grouping,
+    .set_prio_mask = nvic_set_prio_mask,
+    .int_set_affinity = nvic_op_int_set_affinity,
     .int_num = nvic_op_int_num,
     .int_type = nvic_op_int_type,
 };
@@ -98,5 +149,11 @@ static const struct intc_ops nvic_ops = {
 void nvic_init(uintptr_t scs_base)
 {
     nvic.base = scs_base;
+
+    // Out of reset, all are at the highest priority
+    uint32_t prio = INTC_PRIO_DEFAULT * 0x01010101u;
+    for (unsigned i = 0; i < nvic_num_ints() / 4; ++i)
+        REGB_WRITE32(nvic.base, NVIC_IPR0 + i * 4, prio);
+
     intc_register(&nvic_ops);
 }
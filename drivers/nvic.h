@@ -11,6 +11,13 @@ void nvic_int_disable(unsigned irq);
 
 void nvic_disable_all();
 
+// See intc.h for the meaning of priorities and masks; nvic_init sets all
+// IRQs to INTC_PRIO_DEFAULT. Exceptions (e.g. SysTick) are left at the
+// highest priority.
+void nvic_int_set_prio(unsigned irq, unsigned prio);
+void nvic_set_prio_grouping(unsigned preempt_bits);
+unsigned nvic_set_prio_mask(unsigned prio); // BASEPRI, returns previous
+
 
 // For use by intc.h common adapter
 
@@ -0,0 +1,388 @@
+#define DEBUG 0
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blkdev.h"
+#include "dma.h"
+#include "ecc.h"
+#include "object.h"
+#include "panic.h"
+
+#include "smc-nand.h"
+
+#ifndef SMC_NAND_MODEL
+#include "regops.h"
+#define CSR_READ(base, reg)         REGB_READ32(base, reg)
+#define CSR_WRITE(base, reg, val)   REGB_WRITE32(base, reg, val)
+#define PORT_READ(addr)             (*(volatile uint32_t *)(addr))
+#define PORT_WRITE(addr, val)       (*(volatile uint32_t *)(addr) = (val))
+#else // model of the controller and chip, for the host test in tools/nand-sim
+uint32_t smc_nand_model_read(uintptr_t addr);
+void smc_nand_model_write(uintptr_t addr, uint32_t val);
+#define CSR_READ(base, reg)         smc_nand_model_read((base) + (reg))
+#define CSR_WRITE(base, reg, val)   smc_nand_model_write((base) + (reg), val)
+#define PORT_READ(addr)             smc_nand_model_read(addr)
+#define PORT_WRITE(addr, val)       smc_nand_model_write(addr, val)
+#endif // SMC_NAND_MODEL
+
+#define SMC__memc_status                0x000
+#define SMC__mem_cfg_clr                0x00c
+
+#define SMC__memc_status__raw_int_status0__SHIFT        5
+#define SMC__mem_cfg_clr__int_clear0__SHIFT             3
+
+/* ECC block of each interface */
+#define SMC__ecc(iface)                 (0x300 + (iface) * 0x100)
+#define SMC__ecc_status                 0x000
+#define SMC__ecc_memcfg                 0x004
+#define SMC__ecc_memcommand1            0x008
+#define SMC__ecc_value0                 0x018
+
+#define SMC__ecc_status__busy__SHIFT                    6
+
+#define SMC__ecc_memcfg__page_size__SHIFT               0
+#define SMC__ecc_memcfg__ecc_mode__SHIFT                2
+
+#define SMC__ecc_memcommand1__wr_cmd__SHIFT             0
+#define SMC__ecc_memcommand1__rd_cmd__SHIFT             8
+#define SMC__ecc_memcommand1__rd_cmd_end__SHIFT         16
+#define SMC__ecc_memcommand1__rd_cmd_end_valid__SHIFT   24
+
+#define SMC__ecc_value__value__MASK                     0x00ffffff
+#define SMC__ecc_value__valid__SHIFT                    30
+
+#define SMC__ecc_mode__MEM              0b10 /* computed as data is read */
+
+/* On the NAND interface, the address of an access encodes the command (or
+ * data) phase; the chip select is in the upper bits of the base address. */
+#define NAND__cmd__start_cmd__SHIFT     3
+#define NAND__cmd__end_cmd__SHIFT       11
+#define NAND__cmd__end_cmd_valid__SHIFT 20
+#define NAND__cmd__addr_cycles__SHIFT   21
+#define NAND__data__ecc_last__SHIFT     10
+#define NAND__data__data_phase__SHIFT   19
+#define NAND__data__clear_cs__SHIFT     21
+
+#define NAND_CMD_READ0                  0x00
+#define NAND_CMD_READSTART              0x30
+#define NAND_CMD_SEQIN                  0x80
+
+#define COLUMN_CYCLES 2
+#define POLL_LIMIT 100000 // iterations, tR is tens of us
+
+struct smc_nand {
+    struct object obj;
+    uintptr_t csr;
+    unsigned iface;
+    uintptr_t base;
+    struct smc_nand_cfg cfg;
+    struct dma *dmac;
+    unsigned chan;
+    bool hw_ecc;
+    struct blkdev blk;
+    struct smc_nand_stats stats;
+
+    /* Bad blocks, filled in lazily in block order, up to 'scanned' */
+    uint32_t bbt[SMC_NAND_MAX_BLOCKS / 32];
+    unsigned scanned;
+
+    /* Last logical to physical block mapping, so that sequential reads don't
+     * walk the table from the start */
+    bool map_valid;
+    unsigned map_logical;
+    unsigned map_physical;
+
+    /* Read in flight (via blkdev) */
+    uint8_t *buf;
+    struct dma_tx *dtx;
+    uint32_t oob[SMC_NAND_MAX_OOB_SIZE / sizeof(uint32_t)];
+};
+
+#define MAX_SMC_NANDS 1
+static struct smc_nand smc_nands[MAX_SMC_NANDS];
+
+static uintptr_t data_port(struct smc_nand *n, bool ecc_last, bool clear_cs)
+{
+    return n->base | (1 << NAND__data__data_phase__SHIFT) |
+           (ecc_last << NAND__data__ecc_last__SHIFT) |
+           (clear_cs << NAND__data__clear_cs__SHIFT);
+}
+
+static int wait_ready(struct smc_nand *n)
+{
+    uint32_t ready = 1 << (SMC__memc_status__raw_int_status0__SHIFT + n->iface);
+    unsigned poll;
+
+    for (poll = 0; !(CSR_READ(n->csr, SMC__memc_status) & ready); ++poll) {
+        if (poll == POLL_LIMIT) {
+            printf("SMC NAND: ERROR: timeout waiting for chip ready\r\n");
+            return 1;
+        }
+    }
+    CSR_WRITE(n->csr, SMC__mem_cfg_clr,
+              1 << (SMC__mem_cfg_clr__int_clear0__SHIFT + n->iface));
+    return 0;
+}
+
+/* Issue the read command for a (physical) page and wait until the chip has
+ * loaded it into its page register, from where it is read via the data port,
+ * starting at the given column. */
+static int load_page(struct smc_nand *n, unsigned page, unsigned column)
+{
+    unsigned cycles = COLUMN_CYCLES + n->cfg.row_cycles;
+    uintptr_t cmd = n->base |
+        (cycles << NAND__cmd__addr_cycles__SHIFT) |
+        (1 << NAND__cmd__end_cmd_valid__SHIFT) |
+        (NAND_CMD_READSTART << NAND__cmd__end_cmd__SHIFT) |
+        (NAND_CMD_READ0 << NAND__cmd__start_cmd__SHIFT);
+
+    CSR_WRITE(n->csr, SMC__mem_cfg_clr,
+              1 << (SMC__mem_cfg_clr__int_clear0__SHIFT + n->iface));
+    PORT_WRITE(cmd, column | (page << 16)); // first four address cycles
+    if (cycles > 4)
+        PORT_WRITE(cmd, page >> 16);
+    return wait_ready(n);
+}
+
+static void read_port(struct smc_nand *n, uint32_t *buf, unsigned words,
+                      bool ecc_last, bool clear_cs)
+{
+    uintptr_t port = data_port(n, false, false);
+    for (unsigned w = 0; w + 1 < words; ++w)
+        buf[w] = PORT_READ(port);
+    buf[words - 1] = PORT_READ(data_port(n, ecc_last, clear_cs));
+}
+
+static bool block_bad(struct smc_nand *n, unsigned block)
+{
+    uint32_t marker;
+
+    while (n->scanned <= block) {
+        unsigned b = n->scanned++;
+        if (load_page(n, b * n->cfg.pages_per_block, n->cfg.page_size)) {
+            marker = 0; // unreadable: treat as bad
+        } else {
+            read_port(n, &marker, 1, false, true);
+            marker = (marker >> (8 * SMC_NAND_OOB_BBM)) & 0xff;
+        }
+        if (marker != 0xff) {
+            n->bbt[b / 32] |= 1 << (b % 32);
+            n->stats.bad_blocks++;
+            printf("SMC NAND: block %u is bad\r\n", b);
+        }
+    }
+    return n->bbt[block / 32] & (1 << (block % 32));
+}
+
+static unsigned next_good(struct smc_nand *n, unsigned block)
+{
+    while (block < n->cfg.blocks && block_bad(n, block))
+        block++;
+    return block;
+}
+
+static int map_page(struct smc_nand *n, unsigned page, unsigned *phys)
+{
+    unsigned lblock = page / n->cfg.pages_per_block;
+    unsigned l = 0, p;
+
+    if (n->map_valid && lblock >= n->map_logical) {
+        l = n->map_logical;
+        p = n->map_physical;
+    } else {
+        p = next_good(n, 0);
+    }
+    while (l < lblock && p < n->cfg.blocks) {
+        p = next_good(n, p + 1);
+        l++;
+    }
+    if (p >= n->cfg.blocks) {
+        printf("SMC NAND: ERROR: page %u beyond last good block\r\n", page);
+        return 1;
+    }
+    n->map_valid = true;
+    n->map_logical = l;
+    n->map_physical = p;
+    *phys = p * n->cfg.pages_per_block + page % n->cfg.pages_per_block;
+    return 0;
+}
+
+/* The controller's codes are compared as-is against the stored ones: if its
+ * code layout differs from lib/ecc's, every page goes the software path,
+ * which is slower but still correct. */
+static bool hw_ecc_matches(struct smc_nand *n, const uint8_t *codes,
+                           unsigned steps)
+{
+    uintptr_t ecc = n->csr + SMC__ecc(n->iface);
+    unsigned poll;
+
+    for (poll = 0; CSR_READ(ecc, SMC__ecc_status) &
+                   (1 << SMC__ecc_status__busy__SHIFT); ++poll)
+        if (poll == POLL_LIMIT)
+            return false;
+    for (unsigned i = 0; i < steps; ++i, codes += ECC_512_SIZE) {
+        uint32_t val = CSR_READ(ecc, SMC__ecc_value0 + i * sizeof(uint32_t));
+        uint32_t stored = codes[0] | (codes[1] << 8) | (codes[2] << 16);
+        if (!(val & (1 << SMC__ecc_value__valid__SHIFT)) ||
+            (val & SMC__ecc_value__value__MASK) != stored)
+            return false;
+    }
+    return true;
+}
+
+static int check_ecc(struct smc_nand *n, uint8_t *buf)
+{
+    unsigned steps = n->cfg.page_size / SMC_NAND_ECC_STEP;
+    const uint8_t *codes = (const uint8_t *)n->oob + SMC_NAND_OOB_ECC;
+    struct ecc_region_stats stats = {0};
+    int rc;
+
+    n->stats.pages++;
+    if (n->hw_ecc && hw_ecc_matches(n, codes, steps)) {
+        n->stats.hw_ecc_ok++;
+        return 0;
+    }
+    rc = ecc_check_region(buf, n->cfg.page_size, SMC_NAND_ECC_STEP, codes,
+                          &stats);
+    n->stats.corrected += stats.corrected;
+    n->stats.uncorrectable += stats.uncorrectable;
+    if (rc)
+        printf("SMC NAND: ERROR: uncorrectable ECC error\r\n");
+    else if (stats.corrected)
+        DPRINTF("SMC NAND: corrected %u ECC errors\r\n", stats.corrected);
+    return rc;
+}
+
+/* With DMA, all but the last burst of the page data is transferred by the
+ * DMA engine (from the data port, as a fixed address); the rest, the tail
+ * that carries the ecc_last flag, and the spare area are read by the CPU. */
+static int start_page(struct smc_nand *n, unsigned page, uint8_t *buf)
+{
+    unsigned phys;
+
+    ASSERT(!n->buf);
+    ASSERT(!((uintptr_t)buf & (sizeof(uint32_t) - 1)));
+    if (map_page(n, page, &phys) || load_page(n, phys, 0))
+        return 1;
+    n->buf = buf;
+    if (n->dmac && !((uintptr_t)buf & (DMA_MAX_BURST_BYTES - 1))) {
+        n->dtx = dma_transfer_fixed_src(n->dmac, n->chan,
+                    (uint32_t *)data_port(n, false, false), (uint32_t *)buf,
+                    n->cfg.page_size - DMA_MAX_BURST_BYTES, NULL, NULL);
+        if (!n->dtx)
+            DPRINTF("SMC NAND: DMA failed to start, reading by CPU\r\n");
+    }
+    return 0;
+}
+
+static int finish_page(struct smc_nand *n)
+{
+    unsigned tail = n->cfg.page_size;
+    uint8_t *buf = n->buf;
+    int rc = 0;
+
+    ASSERT(buf);
+    n->buf = NULL;
+    if (n->dtx) {
+        rc = dma_wait(n->dtx);
+        n->dtx = NULL;
+        tail = DMA_MAX_BURST_BYTES;
+    }
+    read_port(n, (uint32_t *)(buf + n->cfg.page_size - tail),
+              tail / sizeof(uint32_t), true, false);
+    read_port(n, n->oob, n->cfg.oob_size / sizeof(uint32_t), false, true);
+    if (rc) {
+        printf("SMC NAND: ERROR: DMA of page data failed: rc %d\r\n", rc);
+        return rc;
+    }
+    return check_ecc(n, buf);
+}
+
+static int blk_read_start(struct blkdev *dev, unsigned block, uint8_t *buf)
+{
+    return start_page((struct smc_nand *)dev->priv, block, buf);
+}
+
+static int blk_read_finish(struct blkdev *dev)
+{
+    return finish_page((struct smc_nand *)dev->priv);
+}
+
+struct smc_nand *smc_nand_init(uintptr_t csr_base, unsigned iface,
+                               uintptr_t base, const struct smc_nand_cfg *cfg,
+                               struct dma *dmac, unsigned chan)
+{
+    ASSERT(cfg);
+    ASSERT(cfg->page_size <= SMC_NAND_MAX_PAGE_SIZE);
+    ASSERT(cfg->page_size % SMC_NAND_ECC_STEP == 0);
+    ASSERT(cfg->oob_size <= SMC_NAND_MAX_OOB_SIZE);
+    ASSERT(cfg->oob_size % sizeof(uint32_t) == 0);
+    ASSERT(SMC_NAND_OOB_ECC + (cfg->page_size / SMC_NAND_ECC_STEP) *
+           ECC_512_SIZE <= cfg->oob_size);
+    ASSERT(cfg->blocks <= SMC_NAND_MAX_BLOCKS);
+
+    struct smc_nand *n = OBJECT_ALLOC(smc_nands);
+    if (!n)
+        return NULL;
+    n->csr = csr_base;
+    n->iface = iface;
+    n->base = base;
+    n->cfg = *cfg;
+    n->dmac = dmac;
+    n->chan = chan;
+
+    // Controller computes ECC over up to four 512-byte steps of a page
+    unsigned steps = cfg->page_size / SMC_NAND_ECC_STEP;
+    if (steps == 1 || steps == 2 || steps == 4) {
+        uintptr_t ecc = csr_base + SMC__ecc(iface);
+        CSR_WRITE(ecc, SMC__ecc_memcommand1,
+            (NAND_CMD_SEQIN << SMC__ecc_memcommand1__wr_cmd__SHIFT) |
+            (NAND_CMD_READ0 << SMC__ecc_memcommand1__rd_cmd__SHIFT) |
+            (NAND_CMD_READSTART << SMC__ecc_memcommand1__rd_cmd_end__SHIFT) |
+            (1 << SMC__ecc_memcommand1__rd_cmd_end_valid__SHIFT));
+        CSR_WRITE(ecc, SMC__ecc_memcfg,
+            ((steps == 4 ? 3 : steps) << SMC__ecc_memcfg__page_size__SHIFT) |
+            (SMC__ecc_mode__MEM << SMC__ecc_memcfg__ecc_mode__SHIFT));
+        n->hw_ecc = true;
+    }
+
+    n->blk.priv = n;
+    n->blk.name = "smc-nand";
+    n->blk.block_size = cfg->page_size;
+    n->blk.num_blocks = cfg->blocks * cfg->pages_per_block; // incl. bad ones
+    n->blk.read_start = blk_read_start;
+    n->blk.read_finish = blk_read_finish;
+
+    printf("SMC NAND: %u blocks of %u x %u+%u byte pages%s%s\r\n",
+           cfg->blocks, cfg->pages_per_block, cfg->page_size, cfg->oob_size,
+           n->hw_ecc ? ", hw ecc" : "", dmac ? ", dma" : "");
+    return n;
+}
+
+void smc_nand_deinit(struct smc_nand *n)
+{
+    ASSERT(n);
+    ASSERT(!n->buf);
+    OBJECT_FREE(n);
+}
+
+int smc_nand_read_page(struct smc_nand *n, unsigned page, uint8_t *buf)
+{
+    ASSERT(n);
+    return blkdev_read(&n->blk, page, buf);
+}
+
+struct blkdev *smc_nand_blkdev(struct smc_nand *n)
+{
+    ASSERT(n);
+    return &n->blk;
+}
+
+void smc_nand_get_stats(struct smc_nand *n, struct smc_nand_stats *stats)
+{
+    ASSERT(n);
+    ASSERT(stats);
+    *stats = n->stats;
+}
@@ -0,0 +1,65 @@
+#ifndef SMC_NAND_H
+#define SMC_NAND_H
+
+#include <stdint.h>
+
+#define SMC_NAND_ECC_STEP 512 /* bytes of data per ECC code (ECC_512_SIZE) */
+
+/* Spare area (OOB) layout of each page */
+#define SMC_NAND_OOB_BBM 0 /* bad block marker: != 0xff in 1st page of block */
+#define SMC_NAND_OOB_ECC 8 /* ECC codes, ECC_512_SIZE bytes per step */
+
+#define SMC_NAND_MAX_PAGE_SIZE 2048
+#define SMC_NAND_MAX_OOB_SIZE 64
+#define SMC_NAND_MAX_BLOCKS 4096
+
+struct dma;
+struct blkdev;
+struct smc_nand;
+
+struct smc_nand_cfg {
+    unsigned page_size; /* bytes of data, a multiple of SMC_NAND_ECC_STEP */
+    unsigned oob_size;
+    unsigned pages_per_block;
+    unsigned blocks;
+    unsigned row_cycles; /* address cycles for page number (column takes 2) */
+};
+
+struct smc_nand_stats {
+    unsigned pages;
+    unsigned hw_ecc_ok; /* pages accepted on hardware ECC alone */
+    unsigned corrected; /* steps corrected by the software decoder */
+    unsigned uncorrectable; /* steps */
+    unsigned bad_blocks; /* found so far (blocks are scanned lazily) */
+};
+
+/* smc_nand_init: driver for a NAND chip on an interface of the SMC (PL353)
+ *
+ * @csr_base: registers of the SMC
+ * @iface: index of the NAND interface of the SMC (see smc_get_iface)
+ * @base: address that the chip is mapped at
+ * @dmac: optional, to transfer page data off the chip by DMA
+ * @chan: DMA channel, owned by the driver
+ *
+ * The interface timings are applied by smc_init, not here.
+ */
+struct smc_nand *smc_nand_init(uintptr_t csr_base, unsigned iface,
+                               uintptr_t base, const struct smc_nand_cfg *cfg,
+                               struct dma *dmac, unsigned chan);
+void smc_nand_deinit(struct smc_nand *n);
+
+/* smc_nand_read_page: read a page and check its ECC
+ *
+ * Pages are numbered logically: bad blocks are skipped, so page numbers are
+ * contiguous over the good blocks. A page is accepted if the ECC computed by
+ * the controller matches the codes in the spare area; otherwise, the data is
+ * checked and corrected in software. Returns 0 if the data is intact.
+ */
+int smc_nand_read_page(struct smc_nand *n, unsigned page, uint8_t *buf);
+
+/* smc_nand_blkdev: block device over the logical pages (one per block) */
+struct blkdev *smc_nand_blkdev(struct smc_nand *n);
+
+void smc_nand_get_stats(struct smc_nand *n, struct smc_nand_stats *stats);
+
+#endif // SMC_NAND_H
@@ -1,5 +1,7 @@
 #include <stdint.h>
 
+#include "arm.h"
+#include "console.h"
 #include "panic.h"
 #include "object.h"
 #include "regops.h"
@@ -34,6 +36,7 @@
 #define SMC__mem_cfg_clr__int_clear1__SHIFT             4
 
 #define SMC__opmode__set_mw__SHIFT                      0
+#define SMC__opmode__rd_bl__SHIFT                       3
 #define SMC__opmode__rd_sync__SHIFT                     6
 #define SMC__opmode__wr_sync__SHIFT                     2
 #define SMC__opmode__set_adv__SHIFT                    11
@@ -42,6 +45,12 @@
 #define SMC__mw__16_BIT                 0b01
 #define SMC__mw__32_BIT                 0b10
 
+#define SMC__bl__1_BEAT                 0b000
+#define SMC__bl__4_BEATS                0b001
+#define SMC__bl__8_BEATS                0b010
+#define SMC__bl__16_BEATS               0b011
+#define SMC__bl__32_BEATS               0b100
+
 #define SMC__set_opmode__MASK 0x0000ffff
 #define SMC__set_cycles__MASK 0x000fffff
 
@@ -73,6 +82,7 @@ struct smc {
 
     /* smc_iface_type -> index */
     unsigned iface_index[SMC_INTERFACES];
+    uint8_t iface_found; /* mask of smc_iface_type */
 };
 
 #define MAX_SMCS 2
@@ -94,11 +104,26 @@ static unsigned to_width_bits(unsigned width)
     return 0;
 }
 
+static unsigned to_bl_bits(unsigned beats)
+{
+   switch (beats) {
+       case  0:
+       case  1: return SMC__bl__1_BEAT;
+       case  4: return SMC__bl__4_BEATS;
+       case  8: return SMC__bl__8_BEATS;
+       case 16: return SMC__bl__16_BEATS;
+       case 32: return SMC__bl__32_BEATS;
+    }
+    panic("invalid memory burst length");
+    return 0;
+}
+
 static void smc_stage_cfg(uintptr_t base,
                           const struct smc_mem_chip_cfg *chip_cfg)
 {
     REG_WRITE32(SMC_REG(base, SMC__set_opmode),
         (chip_cfg->adv << SMC__opmode__set_adv__SHIFT) |
+        (to_bl_bits(chip_cfg->rd_bl) << SMC__opmode__rd_bl__SHIFT) |
         (chip_cfg->sync << SMC__opmode__rd_sync__SHIFT) |
         (chip_cfg->sync << SMC__opmode__wr_sync__SHIFT) |
         (to_width_bits(chip_cfg->width) << SMC__opmode__set_mw__SHIFT));
@@ -149,6 +174,7 @@ struct smc *smc_init(uintptr_t base, const struct smc_mem_cfg *cfg,
                 if (!(iface_mask & SMC_IFACE_SRAM_MASK))
                     continue;
                 s->iface_index[SMC_IFACE_SRAM] = iface;
+                s->iface_found |= SMC_IFACE_SRAM_MASK;
                 icfg = &cfg->iface[SMC_IFACE_SRAM];
 
                 DPRINTF("SMC: init interface %u as SRAM type with %u chips\r\n",
@@ -162,6 +188,22 @@ struct smc *smc_init(uintptr_t base, const struct smc_mem_cfg *cfg,
                 }
             case SMC_MEM_NONE:
                 break;
+            case SMC_MEM_NAND:
+                if (!(iface_mask & SMC_IFACE_NAND_MASK))
+                    continue;
+                s->iface_index[SMC_IFACE_NAND] = iface;
+                s->iface_found |= SMC_IFACE_NAND_MASK;
+                icfg = &cfg->iface[SMC_IFACE_NAND];
+
+                DPRINTF("SMC: init interface %u as NAND type with %u chips\r\n",
+                       iface, icfg->chips);
+                for (int chip = 0; chip < icfg->chips; ++chip) {
+                    if (!(chip_mask & (1 << chip)))
+                        continue;
+                    smc_stage_cfg(base, icfg->chip_cfgs[chip]);
+                    smc_apply_staged_cfg(base, iface, chip, icfg);
+                }
+                break;
             default:
                 DPRINTF("SMC: not initializing interface #%u: "
                        "mem type %x is not supported by driver\r\n",
@@ -187,3 +229,133 @@ uint8_t *smc_get_base_addr(struct smc *s, enum smc_iface_type iface_type,
     uint32_t mask = (reg & SMC__set_opmode_addr_mask__MASK) << 8;
     return (uint8_t *) (match & mask);
 }
+
+int smc_get_iface(struct smc *s, enum smc_iface_type iface_type)
+{
+    ASSERT(s);
+    if (!(s->iface_found & (1 << iface_type)))
+        return -1;
+    return s->iface_index[iface_type];
+}
+
+static void smc_apply_cfg(struct smc *s, const struct smc_mem_cfg *cfg,
+                          enum smc_iface_type iface, unsigned chip,
+                          const struct smc_mem_chip_cfg *chip_cfg)
+{
+    smc_stage_cfg(s->base, chip_cfg);
+    smc_apply_staged_cfg(s->base, s->iface_index[iface], chip,
+                         &cfg->iface[iface]);
+}
+
+#define TUNE_PASSES 4 // reads of the region per profile
+#define TUNE_STRIDE 97  // words, for the strided pass (odd)
+
+/* Order-independent per-block signature term: a bijection of the value, so
+ * that any single corrupted word changes the sum */
+static inline uint32_t tune_term(unsigned w, uint32_t val)
+{
+    return (val ^ (w * 0x9e3779b9u)) * 0x85ebca6bu;
+}
+
+/* Reads the region TUNE_PASSES times, each in a different order (forward,
+ * backward, strided within each block, forward), so that the bus sees
+ * varied address and data transitions, and sums the signature of each
+ * block. If @ref, returns the cycles taken, or 0 if any block's signature
+ * did not match @ref; otherwise stores the signatures (of one pass) in @sigs
+ * and returns 1, or 0 if the passes disagree. */
+static uint32_t smc_time_reads(const volatile uint32_t *region, unsigned words,
+                               const uint32_t *ref, uint32_t *sigs)
+{
+    unsigned blocks = words / SMC_TUNE_BLOCK_WORDS;
+    uint32_t start = cycle_counter_read();
+    for (unsigned b = 0; b < blocks; ++b) {
+        const volatile uint32_t *blk = region + b * SMC_TUNE_BLOCK_WORDS;
+        uint32_t sig[TUNE_PASSES];
+        for (unsigned p = 0; p < TUNE_PASSES; ++p) {
+            sig[p] = 0;
+            for (unsigned i = 0; i < SMC_TUNE_BLOCK_WORDS; ++i) {
+                unsigned w;
+                switch (p) {
+                    case 1: w = SMC_TUNE_BLOCK_WORDS - 1 - i; break;
+                    case 2: w = (i * TUNE_STRIDE) % SMC_TUNE_BLOCK_WORDS; break;
+                    default: w = i;
+                }
+                sig[p] += tune_term(w, blk[w]);
+            }
+        }
+        for (unsigned p = 1; p < TUNE_PASSES; ++p)
+            if (sig[p] != sig[0])
+                return 0;
+        if (ref && sig[0] != ref[b])
+            return 0;
+        if (!ref)
+            sigs[b] = sig[0];
+    }
+    if (!ref)
+        return 1;
+    uint32_t cycles = cycle_counter_read() - start;
+    return cycles ? cycles : 1;
+}
+
+int smc_tune(struct smc *s, const struct smc_mem_cfg *cfg,
+             enum smc_iface_type iface, unsigned chip,
+             const volatile uint32_t *region, unsigned words, uint32_t *ref)
+{
+    ASSERT(s);
+    ASSERT(chip < cfg->iface[iface].chips);
+    ASSERT(words && words % SMC_TUNE_BLOCK_WORDS == 0);
+    const struct smc_mem_chip_profiles *profiles =
+        cfg->iface[iface].profiles[chip];
+    int fastest = -1, sel = -1;
+    uint32_t sel_cycles = 0;
+
+    if (!profiles || !profiles->count)
+        return -1;
+
+    cycle_counter_enable();
+    uint32_t base_cycles = 0;
+    if (smc_time_reads(region, words, NULL, ref))
+        base_cycles = smc_time_reads(region, words, ref, NULL);
+    if (!base_cycles) {
+        printf("SMC: tune: chip %u: unstable with default config\r\n", chip);
+        return -1;
+    }
+
+    // For a margin, the profile that passes after the fastest one that does
+    const struct smc_mem_chip_cfg *def = cfg->iface[iface].chip_cfgs[chip];
+    for (unsigned i = 0; i < profiles->count && sel < 0; ++i) {
+        if (profiles->cfgs[i].t_wc != def->t_wc ||
+            profiles->cfgs[i].t_wp != def->t_wp) {
+            printf("SMC: tune: chip %u: profile %u: skipped, "
+                   "write timings are not checked\r\n", chip, i);
+            continue;
+        }
+        smc_apply_cfg(s, cfg, iface, chip, &profiles->cfgs[i]);
+        uint32_t cycles = smc_time_reads(region, words, ref, NULL);
+        DPRINTF("SMC: tune: chip %u: profile %u: %u cycles%s\r\n", chip, i,
+                cycles, cycles ? "" : " (read mismatch)");
+        if (!cycles)
+            continue;
+        if (fastest < 0) {
+            fastest = i;
+            continue;
+        }
+        sel = i;
+        sel_cycles = cycles;
+    }
+
+    if (sel < 0 || sel_cycles >= base_cycles) {
+        smc_apply_cfg(s, cfg, iface, chip, def);
+        if (fastest >= 0 && sel < 0)
+            printf("SMC: tune: chip %u: keeping default config: "
+                   "no margin below profile %u\r\n", chip, fastest);
+        else
+            printf("SMC: tune: chip %u: keeping default config\r\n", chip);
+        return -1;
+    }
+    smc_apply_cfg(s, cfg, iface, chip, &profiles->cfgs[sel]);
+    printf("SMC: tune: chip %u: profile %u (fastest passing: %u): "
+           "read %u%% of default time\r\n", chip, sel, fastest,
+           sel_cycles / (base_cycles / 100 ? base_cycles / 100 : 1));
+    return sel;
+}
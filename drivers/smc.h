@@ -30,6 +30,7 @@ struct smc_mem_chip_cfg {
     unsigned width;
     bool sync;
     bool adv;
+    unsigned rd_bl; /* beats per page (async) or burst (sync) read: 0 = 1 */
     unsigned t_rc;
     unsigned t_wc;
     unsigned t_ceoe;
@@ -40,11 +41,18 @@ struct smc_mem_chip_cfg {
     uint32_t addr_match[SMC_CHIPS_PER_INTERFACE];
 };
 
+/* Alternative configs for a chip, for smc_tune, ordered fastest first */
+struct smc_mem_chip_profiles {
+    unsigned count;
+    const struct smc_mem_chip_cfg *cfgs;
+};
+
 struct smc_mem_iface_cfg {
     unsigned ext_addr_bits;
     bool cre;
     unsigned chips;
     const struct smc_mem_chip_cfg *chip_cfgs[SMC_CHIPS_PER_INTERFACE];
+    const struct smc_mem_chip_profiles *profiles[SMC_CHIPS_PER_INTERFACE];
 };
 
 struct smc_mem_cfg {
@@ -59,4 +67,32 @@ struct smc *smc_init(uintptr_t base, const struct smc_mem_cfg *cfg,
 void smc_deinit(struct smc *);
 uint8_t *smc_get_base_addr(struct smc *s, enum smc_iface_type iface,
                            unsigned rank);
+/* smc_get_iface: index of the interface with memory of the given type, or -1
+ * if there is none (or it was not initialized) */
+int smc_get_iface(struct smc *s, enum smc_iface_type iface);
+
+/* smc_tune: select a fast timing profile that reads correctly, with margin
+ *
+ * The region is first read with the current config (chip_cfgs, which must be
+ * safe), and a signature of each block of SMC_TUNE_BLOCK_WORDS is kept in
+ * @ref. Then the profiles of the chip are applied in turn, and the region is
+ * read in several orders (forward, backward, strided), checked against the
+ * signatures, and timed by the CPU cycle counter. A profile that passes only
+ * shows that it works at this temperature and voltage, so the selected
+ * profile is the one that passes after the fastest one that passes, if it is
+ * faster than the current config, which is otherwise restored. Only reads
+ * are checked, so profiles whose write timings (t_wc, t_wp) differ from the
+ * current config are skipped.
+ *
+ * @region: in memory attached to the chip, must be readable (not written),
+ *          and hold varied data (not blank)
+ * @words: size of region, a multiple of SMC_TUNE_BLOCK_WORDS
+ * @ref: buffer of words / SMC_TUNE_BLOCK_WORDS words
+ *
+ * Returns the index of the selected profile, or -1 if none was selected.
+ */
+#define SMC_TUNE_BLOCK_WORDS 256
+int smc_tune(struct smc *s, const struct smc_mem_cfg *cfg,
+             enum smc_iface_type iface, unsigned chip,
+             const volatile uint32_t *region, unsigned words, uint32_t *ref);
 #endif // SMC_H
@@ -1,5 +1,7 @@
 #define DEBUG 0
 
+#include <stdbool.h>
+
 #include "hwinfo.h"
 #include "regops.h"
 #include "console.h"
@@ -17,6 +19,9 @@
 #define REG__STCSR__CLKSOURCE   (1 <<  2)
 #define REG__STCSR__COUNTFLAG   (1 << 16)
 
+#define REG__ICSR               0xd04
+#define REG__ICSR__PENDSTCLR    (1 << 25)
+
 struct systick {
     systick_cb_t *cb;
     void *cb_arg;
@@ -45,6 +50,36 @@ uint32_t systick_count()
     return REGB_READ32(TRCH_SCS_BASE, REG__STCVR);
 }
 
+uint32_t systick_interval()
+{
+    return REGB_READ32(TRCH_SCS_BASE, REG__STRVR);
+}
+
+uint32_t systick_retarget(uint32_t until, uint32_t min)
+{
+    uint32_t interval = REGB_READ32(TRCH_SCS_BASE, REG__STRVR);
+    uint32_t count = REGB_READ32(TRCH_SCS_BASE, REG__STCVR);
+    // reading the CSR clears COUNTFLAG, which is also cleared by the ISR
+    bool wrapped = REGB_READ32(TRCH_SCS_BASE, REG__STCSR) &
+                        REG__STCSR__COUNTFLAG;
+    uint32_t elapsed = 0;
+    if (wrapped) { // the interval ended just now: account for it here
+        count = REGB_READ32(TRCH_SCS_BASE, REG__STCVR); // since the reload
+        elapsed = interval;
+        REGB_WRITE32(TRCH_SCS_BASE, REG__ICSR, REG__ICSR__PENDSTCLR);
+    }
+    if (count) // else, not reloaded yet since the count was cleared
+        elapsed += interval - count;
+
+    interval = until > elapsed && until - elapsed > min ? until - elapsed : min;
+    if (interval > SYSTICK_MAX_INTERVAL)
+        interval = SYSTICK_MAX_INTERVAL;
+    DPRINTF("SYSTICK: retarget: elapsed %u, interval %u\r\n", elapsed, interval);
+    REGB_WRITE32(TRCH_SCS_BASE, REG__STRVR, interval);
+    REGB_WRITE32(TRCH_SCS_BASE, REG__STCVR, 0); // reloads from RVR
+    return elapsed;
+}
+
 void systick_enable()
 {
     printf("SYSTICK: enable\r\n");
@@ -60,6 +95,7 @@ void systick_disable()
 void systick_isr()
 {
     DPRINTF("SYSTICK: ISR\r\n");
+    (void)REGB_READ32(TRCH_SCS_BASE, REG__STCSR); // clears COUNTFLAG
     if (systick.cb)
         systick.cb(systick.cb_arg);
 }
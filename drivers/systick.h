@@ -4,12 +4,17 @@
 #include <stdint.h>
 
 #define SYSTICK_CLK_HZ 1000000 // appears to be fixed in Qemu model
+#define SYSTICK_MAX_INTERVAL 0xffffff // 24-bit counter
 
 typedef void (systick_cb_t)(void *arg);
 
 void systick_config(uint32_t interval, systick_cb_t *cb, void *cb_arg);
 void systick_clear();
 uint32_t systick_count();
+uint32_t systick_interval();
+
+// For tickless idle (see tickless.h): call with interrupts disabled
+uint32_t systick_retarget(uint32_t until, uint32_t min);
 void systick_enable();
 void systick_disable();
 
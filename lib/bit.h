@@ -11,7 +11,7 @@
 
 #define ALIGN_MASK(bits) ((1UL << (bits)) - 1)
 #define ALIGN(x, bits) \
-    (typeof(x))(((uint32_t)(x) + ALIGN_MASK(bits)) & ~ALIGN_MASK(bits))
+    (typeof(x))(((uintptr_t)(x) + ALIGN_MASK(bits)) & ~ALIGN_MASK(bits))
 #define ALIGNED(x, bits) (x == ALIGN(x, bits))
 
 #define ALIGN64_MASK(bits) ((1ULL << (bits)) - 1)
@@ -0,0 +1,34 @@
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include <stdint.h>
+
+/**
+ * The blkdev struct is effectively an API, populated by drivers of storage
+ * that is not memory-mapped (e.g. NAND), for consumers such as SFS.
+ *
+ * A read is split into start and finish, so that the consumer can work on
+ * the previous block while the next one is in flight. At most one read is
+ * in flight at a time.
+ */
+struct blkdev {
+    void *priv;
+    const char *name;
+    unsigned block_size; /* bytes, a multiple of DMA_MAX_BURST_BYTES */
+    unsigned num_blocks;
+
+    /* Start reading a block into buf, which must be aligned to
+     * DMA_MAX_BURST_BYTES. Returns 0 on success. */
+    int (*read_start)(struct blkdev *dev, unsigned block, uint8_t *buf);
+    /* Wait for the read in flight and check it (which may correct the data
+     * in the buffer). Returns 0 if the block was read intact. */
+    int (*read_finish)(struct blkdev *dev);
+};
+
+static inline int blkdev_read(struct blkdev *dev, unsigned block, uint8_t *buf)
+{
+    int rc = dev->read_start(dev, block, buf);
+    return rc ? rc : dev->read_finish(dev);
+}
+
+#endif // BLKDEV_H
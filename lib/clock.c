@@ -0,0 +1,96 @@
+#define DEBUG 0
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "console.h"
+#include "panic.h"
+
+#include "clock.h"
+
+/* Shorter waits spin: the alarm is not worth its interrupt, and it must be
+ * armed before the deadline passes */
+#define CLOCK_SPIN_US 20
+
+static clock_read_t *clock_read;
+static clock_alarm_t *clock_alarm;
+static void *clock_arg;
+static uint32_t clock_hz;
+static uint32_t ticks_per_us;
+static uint64_t spin_ticks;
+
+void clock_init(clock_read_t *read, clock_alarm_t *alarm, void *arg,
+                uint32_t freq)
+{
+    printf("CLOCK: init freq %u Hz, alarm %u\r\n", freq, alarm != NULL);
+    ASSERT(read);
+    ASSERT(freq >= 1000000 && freq % 1000000 == 0 &&
+           "clock freq not a multiple of 1 MHz");
+    clock_read = read;
+    clock_alarm = alarm;
+    clock_arg = arg;
+    clock_hz = freq;
+    ticks_per_us = freq / 1000000;
+    spin_ticks = clock_us(CLOCK_SPIN_US);
+}
+
+bool clock_initialized()
+{
+    return clock_read != NULL;
+}
+
+uint64_t clock_now()
+{
+    ASSERT(clock_read && "clock not initialized");
+    return clock_read(clock_arg);
+}
+
+uint32_t clock_freq()
+{
+    return clock_hz;
+}
+
+uint64_t clock_us(uint32_t us)
+{
+    return (uint64_t)us * ticks_per_us;
+}
+
+uint64_t clock_ns(uint32_t ns)
+{
+    // in 32-bit parts, since there is no 64-bit division
+    return (uint64_t)(ns / 1000) * ticks_per_us +
+           ((ns % 1000) * ticks_per_us + 999) / 1000;
+}
+
+void clock_alarm_isr()
+{
+    DPRINTF("CLOCK: alarm\r\n");
+    asm volatile ("sev"); // in case it fired right before the WFE
+}
+
+void wait_until(uint64_t deadline)
+{
+    uint64_t now = clock_now();
+    if (now >= deadline)
+        return;
+
+    bool armed = clock_alarm && deadline - now >= spin_ticks;
+    DPRINTF("CLOCK: wait %u ticks (%s)\r\n", (uint32_t)(deadline - now),
+            armed ? "wfe" : "spin");
+    if (armed)
+        clock_alarm(clock_arg, deadline);
+    while (clock_now() < deadline) {
+        if (armed)
+            asm volatile ("wfe"); // woken by the alarm, or any interrupt
+    }
+}
+
+void clock_usleep(uint32_t us)
+{
+    wait_until(clock_now() + clock_us(us));
+}
+
+void clock_nsleep(uint32_t ns)
+{
+    wait_until(clock_now() + clock_ns(ns));
+}
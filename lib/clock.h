@@ -0,0 +1,37 @@
+#ifndef LIB_CLOCK_H
+#define LIB_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Monotonic 64-bit clock, backed by a free-running hardware counter (the
+ * Elapsed Timer on TRCH, the generic timer on RTPS), for short waits that
+ * msleep is too coarse for. Time is in ticks of the counter. */
+
+typedef uint64_t (clock_read_t)(void *arg);
+
+/* Arm a one-shot interrupt at @deadline (in ticks), whose ISR must call
+ * clock_alarm_isr. Optional: without it, waits spin. */
+typedef void (clock_alarm_t)(void *arg, uint64_t deadline);
+
+void clock_init(clock_read_t *read, clock_alarm_t *alarm, void *arg,
+                uint32_t freq);
+bool clock_initialized();
+
+uint64_t clock_now();
+uint32_t clock_freq(); /* Hz */
+
+/* Durations to ticks, rounded up */
+uint64_t clock_us(uint32_t us);
+uint64_t clock_ns(uint32_t ns);
+
+void clock_alarm_isr();
+
+/* Sleep until the clock reaches @deadline: with WFE if the wait is long
+ * enough to arm the alarm, otherwise spinning. Waits that arm the alarm are
+ * for the main context only, since there is one alarm. */
+void wait_until(uint64_t deadline);
+void clock_usleep(uint32_t us);
+void clock_nsleep(uint32_t ns);
+
+#endif /* LIB_CLOCK_H */
@@ -1,8 +1,14 @@
+#define DEBUG 0
+
 #include <stdint.h>
 
+#include "arm.h"
 #include "mailbox.h"
 #include "mem.h"
 #include "console.h"
+#if CONFIG_SMP
+#include "mutex.h"
+#endif // CONFIG_SMP
 #include "panic.h"
 
 #include "command.h"
@@ -15,6 +21,30 @@ static size_t cmdq_tail = 0;
 static struct cmd cmdq[CMD_QUEUE_LEN];
 
 static cmd_handler_t *cmd_handler = NULL;
+static cmd_notify_t *cmd_notify = NULL;
+static void *cmd_notify_arg;
+
+#if CONFIG_SMP
+// Commands may arrive on either core (see work.h)
+static uint32_t cmdq_lock = unlocked;
+#endif // CONFIG_SMP
+
+static uint32_t cmdq_lock_acquire()
+{
+    uint32_t irq = int_save_disable();
+#if CONFIG_SMP
+    lock_mutex(&cmdq_lock);
+#endif // CONFIG_SMP
+    return irq;
+}
+
+static void cmdq_lock_release(uint32_t irq)
+{
+#if CONFIG_SMP
+    unlock_mutex(&cmdq_lock);
+#endif // CONFIG_SMP
+    int_restore(irq);
+}
 
 void cmd_handler_register(cmd_handler_t cb)
 {
@@ -26,12 +56,20 @@ void cmd_handler_unregister()
     cmd_handler = NULL;
 }
 
+void cmd_notify_register(cmd_notify_t *cb, void *arg)
+{
+    cmd_notify_arg = arg;
+    cmd_notify = cb;
+}
+
 int cmd_enqueue(struct cmd *cmd)
 {
     size_t i;
 
-    if (cmdq_head + 1 % CMD_QUEUE_LEN == cmdq_tail) {
-        printf("command: enqueue failed: queue full\r\n");
+    uint32_t irq = cmdq_lock_acquire();
+    if ((cmdq_head + 1) % CMD_QUEUE_LEN == cmdq_tail) {
+        cmdq_lock_release(irq);
+        DPRINTF("command: enqueue failed: queue full\r\n");
         return 1;
     }
     cmdq_head = (cmdq_head + 1) % CMD_QUEUE_LEN;
@@ -41,22 +79,28 @@ int cmd_enqueue(struct cmd *cmd)
     cmdq[cmdq_head].len = cmd->len;
     for (i = 0; i < cmd->len; ++i)
         cmdq[cmdq_head].msg[i] = cmd->msg[i];
+    cmdq_lock_release(irq);
 
-    printf("command: enqueue (tail %u head %u): cmd %u arg %u...\r\n",
-           cmdq_tail, cmdq_head,
-           cmdq[cmdq_head].msg[0], cmdq[cmdq_head].msg[CMD_MSG_PAYLOAD_OFFSET]);
+    // from the link's work, which may run on a core that must not print (the
+    // queue indices are printed on dequeue)
+    DPRINTF("command: enqueue: cmd %u arg %u...\r\n",
+            cmd->msg[0], cmd->msg[CMD_MSG_PAYLOAD_OFFSET]);
 
-    // TODO: SEV (to prevent race between queue check and WFE in main loop)
+    if (cmd_notify)
+        cmd_notify(cmd_notify_arg);
 
     return 0;
 }
 
 int cmd_dequeue(struct cmd *cmd)
 {
-    size_t i;
+    size_t i, head, tail;
 
-    if (cmdq_head == cmdq_tail)
+    uint32_t irq = cmdq_lock_acquire();
+    if (cmdq_head == cmdq_tail) {
+        cmdq_lock_release(irq);
         return 1;
+    }
 
     cmdq_tail = (cmdq_tail + 1) % CMD_QUEUE_LEN;
 
@@ -65,9 +109,12 @@ int cmd_dequeue(struct cmd *cmd)
     cmd->len = cmdq[cmdq_tail].len;
     for (i = 0; i < cmd->len; ++i)
         cmd->msg[i] = cmdq[cmdq_tail].msg[i];
+    head = cmdq_head;
+    tail = cmdq_tail;
+    cmdq_lock_release(irq);
+
     printf("command: dequeue (tail %u head %u): cmd %u arg %u...\r\n",
-           cmdq_tail, cmdq_head,
-           cmdq[cmdq_tail].msg[0], cmdq[cmdq_tail].msg[CMD_MSG_PAYLOAD_OFFSET]);
+           tail, head, cmd->msg[0], cmd->msg[CMD_MSG_PAYLOAD_OFFSET]);
     return 0;
 }
 
@@ -16,6 +16,9 @@
 #define CMD_WATCHDOG_TIMEOUT            11
 #define CMD_LIFECYCLE                   13
 #define CMD_ACTION                      14
+#define CMD_BOOT_TRACE                  15
+#define CMD_BUSYLOOP                    16
+#define CMD_IRQ_STATS                   17
 #define CMD_MBOX_LINK_CONNECT           200
 #define CMD_MBOX_LINK_DISCONNECT        201
 #define CMD_MBOX_LINK_PING              202
@@ -51,11 +54,55 @@ struct cmd_mbox_link_connect {
     uint8_t idx_to;
 };
 
+// Request payload: uint8_t index of first phase to return
+// Reply payload: struct cmd_boot_trace
+#define CMD_BOOT_TRACE_NAME_LEN 16
+struct cmd_boot_trace_phase {
+    char name[CMD_BOOT_TRACE_NAME_LEN];
+    uint32_t start_us;
+    uint32_t duration_us; // 0 if the phase has not ended
+};
+#define CMD_BOOT_TRACE_PHASES 2 // per reply
+struct cmd_boot_trace {
+    uint8_t total;  // number of phases in the trace
+    uint8_t first;  // index of phases[0]
+    uint8_t count;  // number of valid entries in phases
+    uint8_t rsvd;
+    struct cmd_boot_trace_phase phases[CMD_BOOT_TRACE_PHASES];
+};
+
+// Request payload: uint8_t whether to re-run the calibration first
+// Reply payload: struct cmd_busyloop
+struct cmd_busyloop {
+    uint32_t factor; // busyloop iterations per ms, used by mdelay
+    int32_t rc;      // non-zero if calibration was requested but unavailable
+};
+
+// Request payload: uint16_t index of the first entry to return (0 also
+// prints the whole table on the console of the server)
+// Reply payload: struct cmd_irq_stats, for the next request: index + 1
+#define CMD_IRQ_STATS_BUCKETS 8
+struct cmd_irq_stats {
+    uint16_t index; // of this entry
+    uint8_t valid;  // 0 if there are no more entries
+    uint8_t core;
+    uint32_t irq;   // as numbered by the interrupt controller
+    uint32_t count;
+    uint32_t max_cycles;
+    uint32_t total_cycles_lo;
+    uint32_t total_cycles_hi;
+    uint32_t hist[CMD_IRQ_STATS_BUCKETS]; // durations, see irq-stats.h
+};
+
 typedef int (cmd_handler_t)(struct cmd *cmd, void *reply, size_t reply_sz);
 
 void cmd_handler_register(cmd_handler_t *cb);
 void cmd_handler_unregister();
 
+// Called on each enqueue (possibly from an ISR), e.g. to wake up a task
+typedef void (cmd_notify_t)(void *arg);
+void cmd_notify_register(cmd_notify_t *cb, void *arg);
+
 void cmd_handle(struct cmd *cmd);
 
 int cmd_enqueue(struct cmd *cmd);
@@ -36,6 +36,7 @@
 
 #include <stdint.h>
 #include "console.h"
+#include "ecc.h"
 
 /* #define DEBUG */
 
@@ -129,20 +130,30 @@ static const char addressbits[256] = {
 	0x0e, 0x0e, 0x0f, 0x0f, 0x0e, 0x0e, 0x0f, 0x0f
 };
 
+/* the loop below consumes the block in chunks of this many bytes */
+#define ECC_CHUNK_SIZE 64
+#define ECC_CHUNK_WORDS (ECC_CHUNK_SIZE / sizeof(uint32_t))
+
+/* padding past the end of the data, fed to the loop instead of a copy */
+static const uint32_t ones[ECC_CHUNK_WORDS] = {
+	~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u,
+	~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u,
+};
+
 /**
- * calculate_ecc - Calculate 3-byte ECC for 256/512-byte
- *			 block
- * @buf:	input buffer with raw data
- * @eccsize:	data bytes per ECC step (256 or 512)
+ * ecc_block - Calculate 3-byte ECC for a 256/512-byte block
+ * @bp:		input data, word aligned, read in place
+ * @nchunks:	number of full ECC_CHUNK_SIZE chunks of data at @bp
+ * @tail:	chunk consumed after the data (partial chunk padded with
+ *		0xff, or ones); the rest of the block is padded with ones
+ * @eccsize_mult: 1 for 256-byte blocks, 2 for 512-byte blocks
  * @code:	output buffer with ECC
  */
-void calculate_ecc(const unsigned char *buf, unsigned int eccsize,
-		       unsigned char *code)
+static void ecc_block(const uint32_t *bp, unsigned int nchunks,
+		      const uint32_t *tail, uint32_t eccsize_mult,
+		      unsigned char *code)
 {
-	int i;
-	const uint32_t *bp = (uint32_t *)buf;
-	/* 256 or 512 bytes/ecc  */
-	uint32_t eccsize_mult;
+	unsigned int i;
 	uint32_t cur;		/* current value in buffer */
 	/* rp0..rp15..rp17 are the various accumulated parities (per byte) */
 	uint32_t rp0, rp1, rp2, rp3, rp4, rp5, rp6, rp7;
@@ -155,25 +166,7 @@ void calculate_ecc(const unsigned char *buf, unsigned int eccsize,
 	uint32_t tmppar;	/* the cumulative parity for this iteration;
 				   for rp12, rp14 and rp16 at the end of the
 				   loop */
-        unsigned char cbuf[512];
-
-        if (eccsize < 256) {
-           for (i = 0; i < eccsize; i++) 
-               cbuf[i] = buf[i];
-           for (;i < 256; i++)
-               cbuf[i] = 0xff;
-           eccsize = 256;
-           bp = (uint32_t *)cbuf;           
-        } else if (eccsize < 512) {
-           for (i = 0; i < eccsize; i++) 
-               cbuf[i] = buf[i];
-           for (;i < 512; i++)
-               cbuf[i] = 0xff;
-           eccsize = 512;
-           bp = (uint32_t *)cbuf;           
-        }
-        eccsize_mult = eccsize >> 8;
- 
+
 	par = 0;
 	rp4 = 0;
 	rp6 = 0;
@@ -194,6 +187,8 @@ void calculate_ecc(const unsigned char *buf, unsigned int eccsize,
 	 * also used as a performance improvement for rp6, rp8 and rp10
 	 */
 	for (i = 0; i < eccsize_mult << 2; i++) {
+		if (i >= nchunks)
+			bp = i == nchunks ? tail : ones;
 		cur = *bp++;
 		tmppar = cur;
 		rp4 ^= cur;
@@ -393,33 +388,74 @@ void calculate_ecc(const unsigned char *buf, unsigned int eccsize,
 		    (invparity[rp16] << 0);
 }
 
+/*
+ * ecc_mult - block size multiplier (in 256 bytes) for a data size
+ *
+ * Data shorter than 256 (or 512) bytes is padded with 0xff up to
+ * 256 (or 512) bytes; note that this makes 256 bytes a 512-byte block.
+ */
+static uint32_t ecc_mult(unsigned int eccsize)
+{
+	if (eccsize < 256)
+		return 1;
+	if (eccsize < 512)
+		return 2;
+	return eccsize >> 8;
+}
+
+/*
+ * pad_chunk - copy a partial chunk into an aligned buffer padded with 0xff
+ */
+static const uint32_t *pad_chunk(uint32_t *cbuf, const unsigned char *buf,
+				 unsigned int len)
+{
+	unsigned char *cp = (unsigned char *)cbuf;
+	unsigned int i;
+
+	if (!len)
+		return ones;
+	for (i = 0; i < len; i++)
+		cp[i] = buf[i];
+	for (; i < ECC_CHUNK_SIZE; i++)
+		cp[i] = 0xff;
+	return cbuf;
+}
+
 /**
- * correct_data - [NAND Interface] Detect and correct bit error(s)
- * @buf:	raw data read from the chip
- * @read_ecc:	ECC from the chip
- * @calc_ecc:	the ECC calculated from raw data
+ * calculate_ecc - Calculate 3-byte ECC for 256/512-byte
+ *			 block
+ * @buf:	input buffer with raw data (word aligned)
  * @eccsize:	data bytes per ECC step (256 or 512)
+ * @code:	output buffer with ECC
  *
- * Detect and correct a 1 bit error for eccsize byte block
+ * Shorter data is padded with 0xff, see ecc_mult. Only a trailing
+ * partial chunk is copied.
  */
-int correct_data(unsigned char *buf,
-			unsigned char *read_ecc, unsigned char *calc_ecc,
-			unsigned int eccsize)
+void calculate_ecc(const unsigned char *buf, unsigned int eccsize,
+		       unsigned char *code)
 {
-	unsigned char b0, b1, b2, bit_addr;
-	unsigned int byte_addr;
-	/* 256 or 512 bytes/ecc  */
-	uint32_t eccsize_mult;
-
-	if (eccsize < 256) eccsize = 256;
-	else if (eccsize < 512) eccsize = 512;
-	eccsize_mult = eccsize >> 8;
-#ifdef DEBUG
-	printf("read_ecc = %02x %02x %02x\r\n",
-		   read_ecc[0], read_ecc[1], read_ecc[2]);
-	printf("calc_ecc = %02x %02x %02x\r\n",
-		   calc_ecc[0], calc_ecc[1], calc_ecc[2]);
-#endif /* DEBUG */
+	uint32_t cbuf[ECC_CHUNK_WORDS];
+	unsigned int nchunks = eccsize / ECC_CHUNK_SIZE;
+	const uint32_t *tail = pad_chunk(cbuf, buf + nchunks * ECC_CHUNK_SIZE,
+					 eccsize % ECC_CHUNK_SIZE);
+
+	ecc_block((const uint32_t *)buf, nchunks, tail, ecc_mult(eccsize),
+		  code);
+}
+
+/*
+ * locate_error - Detect a bit error, without correcting it or printing
+ * @byte_addr, @bit_addr: set to the location of a flipped data bit
+ *
+ * Returns 0 if no error, 1 if a data bit is flipped, 2 if the error
+ * is in the ECC itself (data is good), -1 if uncorrectable.
+ */
+static int locate_error(const unsigned char *read_ecc,
+			const unsigned char *calc_ecc, uint32_t eccsize_mult,
+			unsigned int *byte_addr, unsigned int *bit_addr)
+{
+	unsigned char b0, b1, b2;
+
 	/*
 	 * b0 to b2 indicate which bit is faulty (if any)
 	 * we might need the xor result  more than once,
@@ -462,22 +498,161 @@ int correct_data(unsigned char *buf,
 		 * performance it does not make any difference
 		 */
 		if (eccsize_mult == 1)
-			byte_addr = (addressbits[b1] << 4) + addressbits[b0];
+			*byte_addr = (addressbits[b1] << 4) + addressbits[b0];
 		else
-			byte_addr = (addressbits[b2 & 0x3] << 8) +
+			*byte_addr = (addressbits[b2 & 0x3] << 8) +
 				    (addressbits[b1] << 4) + addressbits[b0];
-		bit_addr = addressbits[b2 >> 2];
-		/* flip the bit */
-		buf[byte_addr] ^= (1 << bit_addr);
-		printf("(%d)-th byte, (%d)-th bit is flipped. Fixed\r\n",
-			   byte_addr, bit_addr);
+		*bit_addr = addressbits[b2 >> 2];
 		return 1;
 
 	}
 	/* count nr of bits; use table lookup, faster than calculating it */
 	if ((bitsperbyte[b0] + bitsperbyte[b1] + bitsperbyte[b2]) == 1)
-		return 1;	/* error in ECC data; no action needed */
+		return 2;	/* error in ECC data; no action needed */
 
-	printf("%s: uncorrectable ECC error\r\n", __func__);
 	return -1;
 }
+
+/**
+ * correct_data - [NAND Interface] Detect and correct bit error(s)
+ * @buf:	raw data read from the chip
+ * @read_ecc:	ECC from the chip
+ * @calc_ecc:	the ECC calculated from raw data
+ * @eccsize:	data bytes per ECC step (256 or 512)
+ *
+ * Detect and correct a 1 bit error for eccsize byte block
+ */
+int correct_data(unsigned char *buf,
+			unsigned char *read_ecc, unsigned char *calc_ecc,
+			unsigned int eccsize)
+{
+	unsigned int byte_addr, bit_addr;
+	int rc;
+
+#ifdef DEBUG
+	printf("read_ecc = %02x %02x %02x\r\n",
+		   read_ecc[0], read_ecc[1], read_ecc[2]);
+	printf("calc_ecc = %02x %02x %02x\r\n",
+		   calc_ecc[0], calc_ecc[1], calc_ecc[2]);
+#endif /* DEBUG */
+	rc = locate_error(read_ecc, calc_ecc, ecc_mult(eccsize),
+			  &byte_addr, &bit_addr);
+	if (rc == 1) {
+		/* flip the bit */
+		buf[byte_addr] ^= (1 << bit_addr);
+		printf("(%d)-th byte, (%d)-th bit is flipped. Fixed\r\n",
+			   byte_addr, bit_addr);
+	} else if (rc == 2)
+		rc = 1;
+	else if (rc < 0)
+		printf("%s: uncorrectable ECC error\r\n", __func__);
+	return rc;
+}
+
+/**
+ * ecc_calculate_region - Calculate ECC for consecutive blocks of a region
+ * @buf:	input region, word aligned
+ * @len:	size of region in bytes
+ * @eccsize:	data bytes per ECC step (256 or 512)
+ * @codes:	output, ECC_512_SIZE bytes per block
+ *
+ * Each block gets the same ECC as calculate_ecc(block, @eccsize) would
+ * give; the last block, if short, is padded with 0xff.
+ */
+void ecc_calculate_region(const void *buf, unsigned int len,
+			  unsigned int eccsize, unsigned char *codes)
+{
+	const uint32_t *bp = buf;
+	uint32_t cbuf[ECC_CHUNK_WORDS];
+	uint32_t mult = ecc_mult(eccsize);
+	unsigned int nchunks;
+	const uint32_t *tail;
+
+	for (; len >= eccsize; len -= eccsize) {
+		ecc_block(bp, eccsize / ECC_CHUNK_SIZE, ones, mult, codes);
+		bp += eccsize / sizeof(uint32_t);
+		codes += ECC_512_SIZE;
+	}
+	if (len) {
+		nchunks = len / ECC_CHUNK_SIZE;
+		tail = pad_chunk(cbuf, (const unsigned char *)bp +
+				 nchunks * ECC_CHUNK_SIZE, len % ECC_CHUNK_SIZE);
+		ecc_block(bp, nchunks, tail, mult, codes);
+	}
+}
+
+/*
+ * check_block - Check and correct one (possibly short) block in place
+ * Returns 0 if good, 1 if corrected, -1 if uncorrectable.
+ */
+static int check_block(uint32_t *bp, unsigned int len, uint32_t mult,
+		       const unsigned char *code)
+{
+	uint32_t cbuf[ECC_CHUNK_WORDS];
+	unsigned char calc[ECC_512_SIZE];
+	unsigned int byte_addr, bit_addr;
+	unsigned int nchunks = len / ECC_CHUNK_SIZE;
+	unsigned int split = nchunks * ECC_CHUNK_SIZE;
+	const uint32_t *tail = pad_chunk(cbuf, (unsigned char *)bp + split,
+					 len % ECC_CHUNK_SIZE);
+	int rc;
+
+	ecc_block(bp, nchunks, tail, mult, calc);
+	/* common case: compare inline, no further work */
+	if (calc[0] == code[0] && calc[1] == code[1] && calc[2] == code[2])
+		return 0;
+
+	rc = locate_error(code, calc, mult, &byte_addr, &bit_addr);
+	if (rc == 2)
+		return 1; /* error in the ECC itself, data is good */
+	if (rc < 0)
+		return -1;
+	if (byte_addr >= len)
+		return -1; /* in the padding, so not a single-bit data error */
+	((unsigned char *)bp)[byte_addr] ^= (1 << bit_addr);
+	return 1;
+}
+
+/**
+ * ecc_check_region - Check and correct consecutive blocks of a region
+ * @buf:	region, word aligned; corrected in place
+ * @len:	size of region in bytes (last block may be short)
+ * @eccsize:	data bytes per ECC step (256 or 512)
+ * @codes:	stored ECC, ECC_512_SIZE bytes per block
+ * @stats:	optional, accumulated (not reset) across calls; errors in
+ *		the stored ECC itself count as corrected
+ *
+ * Does not print: the caller decides how to report. Data is read in
+ * place; only a trailing partial chunk is copied.
+ *
+ * Returns 0 if all blocks are good (possibly after correction), or the
+ * number of blocks with uncorrectable errors.
+ */
+int ecc_check_region(void *buf, unsigned int len, unsigned int eccsize,
+		     const unsigned char *codes, struct ecc_region_stats *stats)
+{
+	uint32_t *bp = buf;
+	uint32_t mult = ecc_mult(eccsize);
+	unsigned int blocks = 0, corrected = 0, uncorrectable = 0;
+	unsigned int blen;
+	int rc;
+
+	while (len) {
+		blen = len < eccsize ? len : eccsize;
+		rc = check_block(bp, blen, mult, codes);
+		if (rc < 0)
+			uncorrectable++;
+		else if (rc > 0)
+			corrected++;
+		bp += eccsize / sizeof(uint32_t);
+		codes += ECC_512_SIZE;
+		len -= blen;
+		blocks++;
+	}
+	if (stats) {
+		stats->blocks += blocks;
+		stats->corrected += corrected;
+		stats->uncorrectable += uncorrectable;
+	}
+	return uncorrectable;
+}
@@ -6,4 +6,17 @@ void calculate_ecc(const unsigned char *buf, unsigned int eccsize,
 int correct_data(unsigned char *buf,
 			unsigned char *read_ecc, unsigned char *calc_ecc,
 			unsigned int eccsize);
+
+struct ecc_region_stats {
+	unsigned int blocks;
+	unsigned int corrected;
+	unsigned int uncorrectable;
+};
+
+/* Batch interface: one call for a whole region of consecutive blocks,
+ * with ECC_512_SIZE bytes of ECC per block stored contiguously. */
+void ecc_calculate_region(const void *buf, unsigned int len,
+			  unsigned int eccsize, unsigned char *codes);
+int ecc_check_region(void *buf, unsigned int len, unsigned int eccsize,
+		     const unsigned char *codes, struct ecc_region_stats *stats);
 #endif
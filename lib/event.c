@@ -9,6 +9,15 @@ void ev_loop_init(struct ev_loop *el, const char *name)
     DPRINTF("EV LOOP %s: init\r\n", name);
     el->name = name;
     el->evq_head = el->evq_tail = 0;
+    el->notify = NULL;
+    el->notify_arg = NULL;
+}
+
+void ev_loop_notify(struct ev_loop *el, ev_notify_t *cb, void *arg)
+{
+    ASSERT(el);
+    el->notify_arg = arg;
+    el->notify = cb;
 }
 
 int ev_loop_process(struct ev_loop *el)
@@ -39,7 +48,8 @@ void ev_post(struct ev_loop *el, struct ev_actor *sender,
     evs->event = event;
     printf("EVENT: posted (tail %u head %u)\r\n", el->evq_tail, el->evq_head);
 
-    /* TODO: SEV (when mail loop moves to WFE instead of WFI) */
+    if (el->notify)
+        el->notify(el->notify_arg);
 }
 
 bool ev_loop_pending(struct ev_loop *el)
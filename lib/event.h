@@ -17,14 +17,19 @@ struct ev_slot {
     void *event;
 };
 
+typedef void (ev_notify_t)(void *arg);
+
 struct ev_loop {
     const char *name;
+    ev_notify_t *notify; /* called on each post, e.g. to wake up a task */
+    void *notify_arg;
     size_t evq_head;
     size_t evq_tail;
     struct ev_slot evq[EV_QUEUE_LEN];
 };
 
 void ev_loop_init(struct ev_loop *el, const char *name);
+void ev_loop_notify(struct ev_loop *el, ev_notify_t *cb, void *arg);
 /* returns non-zero if no events */
 int ev_loop_process(struct ev_loop *el);
 bool ev_loop_pending(struct ev_loop *el);
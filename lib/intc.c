@@ -40,6 +40,33 @@ void intc_disable_all()
     }
 }
 
+void intc_int_set_prio(struct irq *irq, unsigned prio)
+{
+    ASSERT(intc_ops && intc_ops->int_set_prio);
+    ASSERT(prio <= 0xff);
+    intc_ops->int_set_prio(irq, prio);
+}
+
+void intc_set_prio_grouping(unsigned preempt_bits)
+{
+    ASSERT(intc_ops && intc_ops->set_prio_grouping);
+    ASSERT(preempt_bits <= 8);
+    intc_ops->set_prio_grouping(preempt_bits);
+}
+
+unsigned intc_set_prio_mask(unsigned prio)
+{
+    ASSERT(intc_ops && intc_ops->set_prio_mask);
+    ASSERT(prio > 0 && prio <= INTC_PRIO_MASK_NONE);
+    return intc_ops->set_prio_mask(prio);
+}
+
+void intc_int_set_affinity(struct irq *irq, unsigned core)
+{
+    ASSERT(intc_ops && intc_ops->int_set_affinity);
+    intc_ops->int_set_affinity(irq, core);
+}
+
 unsigned intc_int_num(struct irq *irq)
 {
     ASSERT(intc_ops && intc_ops->int_num);
@@ -8,6 +8,25 @@
 // whereas from system-specific code, it is simpler to just use the direct API
 // of the respective interrupt controller.
 
+// Priorities: a lower value is more urgent, and a running ISR is preempted
+// only by an interrupt in a more urgent preemption level. Values are on the
+// 8-bit scale of the hardware, which implements only the upper bits: at least
+// 3 on the NVIC of a Cortex-M4, 5 on the GIC-500. So, the levels below are
+// 0x20 apart, and the upper INTC_PREEMPT_BITS bits make the preemption level.
+#define INTC_PRIO_WDT       0x00
+#define INTC_PRIO_TIMER     0x20
+#define INTC_PRIO_DMA       0x40
+#define INTC_PRIO_MAILBOX   0x60
+#define INTC_PRIO_DEFAULT   0x80 // the rest, e.g. devices in tests
+
+#define INTC_PREEMPT_BITS   3
+
+// For intc_set_prio_mask: do not mask any interrupts by priority
+#define INTC_PRIO_MASK_NONE 0x100
+
+// For intc_int_set_affinity: deliver to any core
+#define INTC_AFFINITY_ANY   (~0u)
+
 struct irq;
 
 struct intc_ops {
@@ -15,6 +34,12 @@ struct intc_ops {
     void (*int_disable)(struct irq *irq);
     void (*disable_all)(void);
 
+    void (*int_set_prio)(struct irq *irq, unsigned prio);
+    void (*set_prio_grouping)(unsigned preempt_bits);
+    unsigned (*set_prio_mask)(unsigned prio);
+
+    void (*int_set_affinity)(struct irq *irq, unsigned core);
+
     // For debugging info purpose
     unsigned (*int_num)(struct irq *irq);
     unsigned (*int_type)(struct irq *irq);
@@ -26,6 +51,22 @@ void intc_int_enable(struct irq *irq);
 void intc_int_disable(struct irq *irq);
 void intc_disable_all();
 
+// Set before enabling the interrupt
+void intc_int_set_prio(struct irq *irq, unsigned prio);
+
+// The upper preempt_bits bits of a priority are its preemption level, the
+// rest only order the pending interrupts within a level
+void intc_set_prio_grouping(unsigned preempt_bits);
+
+// Take only the interrupts more urgent than prio (of a lower value), on the
+// calling core; prio > 0 (to mask all, disable interrupts). Returns the
+// previous mask, to restore it with.
+unsigned intc_set_prio_mask(unsigned prio);
+
+// Deliver the interrupt only to the given core (of the controller's cluster),
+// or to any (INTC_AFFINITY_ANY), which is the default
+void intc_int_set_affinity(struct irq *irq, unsigned core);
+
 // For debugging info purposes, since the object is opaque
 unsigned intc_int_num(struct irq *irq);
 unsigned intc_int_type(struct irq *irq);
@@ -0,0 +1,132 @@
+#define DEBUG 0
+
+#include <stdint.h>
+
+#include "arm.h"
+#include "console.h"
+#include "mem.h"
+#include "panic.h"
+
+#include "irq-stats.h"
+
+struct irq_stats {
+    uint8_t slot_of[IRQ_STATS_MAX_IRQ]; // slot index + 1, or 0 if none yet
+    struct irq_stat slots[IRQ_STATS_SLOTS];
+    unsigned used;
+    uint32_t dropped; // interrupts of IRQs without a slot
+};
+
+static struct irq_stats stats[IRQ_STATS_MAX_CORES];
+
+static struct irq_stats *this_stats()
+{
+#if CONFIG_SMP
+    unsigned core = self_core_id();
+    ASSERT(core < IRQ_STATS_MAX_CORES);
+    return &stats[core];
+#else // !CONFIG_SMP
+    return &stats[0];
+#endif // !CONFIG_SMP
+}
+
+void irq_stats_init()
+{
+    struct irq_stats *st = this_stats();
+    bzero(st, sizeof(*st));
+    cycle_counter_enable();
+}
+
+uint32_t irq_stats_enter()
+{
+    return cycle_counter_read();
+}
+
+// An IRQ is not taken again until its ISR returns, so only the allocation
+// of a slot can race (with a nested ISR of another IRQ)
+static struct irq_stat *slot_get(struct irq_stats *st, unsigned irq)
+{
+    struct irq_stat *s = NULL;
+    uint32_t state = int_save_disable();
+    if (st->slot_of[irq]) {
+        s = &st->slots[st->slot_of[irq] - 1];
+    } else if (st->used < IRQ_STATS_SLOTS) {
+        s = &st->slots[st->used++];
+        s->irq = irq;
+        st->slot_of[irq] = st->used;
+    }
+    int_restore(state);
+    return s;
+}
+
+void irq_stats_exit(unsigned irq, uint32_t start)
+{
+    uint32_t cycles = cycle_counter_read() - start; // modulo wrap-around
+    struct irq_stats *st = this_stats();
+    struct irq_stat *s;
+    uint32_t bound = IRQ_STATS_BUCKET0_CYCLES;
+    unsigned b = 0;
+
+    if (irq >= IRQ_STATS_MAX_IRQ || !(s = slot_get(st, irq))) {
+        st->dropped++;
+        return;
+    }
+
+    s->count++;
+    s->total += cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    while (b < IRQ_STATS_BUCKETS - 1 && cycles >= bound) {
+        bound <<= 2;
+        b++;
+    }
+    s->hist[b]++;
+}
+
+int irq_stats_next(unsigned *index, unsigned *core, struct irq_stat *stat)
+{
+    unsigned c = *index / IRQ_STATS_SLOTS;
+    unsigned i = *index % IRQ_STATS_SLOTS;
+
+    while (c < IRQ_STATS_MAX_CORES && i >= stats[c].used) { // in order
+        c++;
+        i = 0;
+    }
+    if (c >= IRQ_STATS_MAX_CORES)
+        return 1;
+    *index = c * IRQ_STATS_SLOTS + i;
+    *core = c;
+    memcpy(stat, &stats[c].slots[i], sizeof(*stat));
+    return 0;
+}
+
+// total / count, without the 64-bit division helpers from libgcc
+static uint32_t avg(const struct irq_stat *s)
+{
+    if (!s->count)
+        return 0;
+    if (!(s->total >> 32))
+        return (uint32_t)s->total / s->count;
+    return (uint32_t)(s->total >> 16) / s->count << 16;
+}
+
+void irq_stats_print()
+{
+    unsigned index = 0, core, b;
+    struct irq_stat s;
+
+    printf("IRQ STATS: cycles; histogram buckets: <%u, x4 each\r\n",
+           IRQ_STATS_BUCKET0_CYCLES);
+    while (!irq_stats_next(&index, &core, &s)) {
+        printf("core %u irq %3u: count %u max %u avg %u total %u K\r\n\t",
+               core, s.irq, s.count, s.max, avg(&s),
+               (uint32_t)(s.total >> 10));
+        for (b = 0; b < IRQ_STATS_BUCKETS; ++b)
+            printf(" %u", s.hist[b]);
+        printf("\r\n");
+        index++;
+    }
+    for (core = 0; core < IRQ_STATS_MAX_CORES; ++core)
+        if (stats[core].dropped)
+            printf("core %u: %u interrupts not counted: table full\r\n",
+                   core, stats[core].dropped);
+}
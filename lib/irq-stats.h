@@ -0,0 +1,64 @@
+#ifndef LIB_IRQ_STATS_H
+#define LIB_IRQ_STATS_H
+
+#include <stdint.h>
+
+// Per-IRQ statistics, to find out which ISR eats the CPU: the IRQ handler
+// (vectors generated from trch/irqmap on TRCH, irq_handler on RTPS) takes a
+// cycle counter timestamp around each ISR, and reports the duration here.
+// The time of ISRs that preempt an ISR (nested) counts towards both.
+//
+// Each core keeps its own table, in which an IRQ gets a slot the first time
+// that it fires; IRQs that fire after the table is full are only counted.
+// Readers do not lock out the ISRs, so an entry read while its IRQ is being
+// handled may be off by that one sample.
+
+#define IRQ_STATS_MAX_IRQ       256 // IRQ numbers (NVIC) or INTIDs (GIC)
+#define IRQ_STATS_SLOTS         32  // per core
+
+#if CONFIG_SMP
+#define IRQ_STATS_MAX_CORES     2
+#else // !CONFIG_SMP
+#define IRQ_STATS_MAX_CORES     1
+#endif // !CONFIG_SMP
+
+// Histogram of durations: bucket i counts durations shorter than
+// IRQ_STATS_BUCKET0_CYCLES << (2 * i) cycles, the last bucket the rest
+#define IRQ_STATS_BUCKETS       8
+#define IRQ_STATS_BUCKET0_CYCLES 64
+
+struct irq_stat {
+    unsigned irq;
+    uint32_t count;
+    uint32_t max;   // cycles
+    uint64_t total; // cycles
+    uint32_t hist[IRQ_STATS_BUCKETS];
+};
+
+#if CONFIG_IRQ_STATS
+// On each core, before its interrupts are enabled: clears its table, and
+// starts its cycle counter
+void irq_stats_init();
+
+// Around the ISR: irq_stats_exit(irq, irq_stats_enter()). Not inline, since
+// the TRCH vectors generated from trch/irqmap call it from assembly.
+uint32_t irq_stats_enter();
+void irq_stats_exit(unsigned irq, uint32_t start);
+
+// Iterate over the slots in use, of all cores: returns the first at or
+// after *index, and updates *index to it, or returns 1 if there are no more
+int irq_stats_next(unsigned *index, unsigned *core, struct irq_stat *stat);
+void irq_stats_print();
+#else // !CONFIG_IRQ_STATS
+static inline void irq_stats_init() {}
+static inline uint32_t irq_stats_enter() { return 0; }
+static inline void irq_stats_exit(unsigned irq, uint32_t start) {}
+static inline int irq_stats_next(unsigned *index, unsigned *core,
+                                 struct irq_stat *stat)
+{
+    return 1;
+}
+static inline void irq_stats_print() {}
+#endif // !CONFIG_IRQ_STATS
+
+#endif // LIB_IRQ_STATS_H
@@ -0,0 +1,481 @@
+#define DEBUG 0
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arm.h"
+#include "console.h"
+#include "mem.h"
+#include "mutex.h"
+#include "panic.h"
+
+#include "kernel.h"
+
+#define CPSR_MODE_SVC   0x13
+#define CPSR_T          (1 << 5)
+#define CPSR_I          (1 << 7)
+
+/* Saved context of a thread that is not running, from the lowest address,
+ * as laid out by kernel_switch and the IRQ handler in startup.s:
+ *     FPSCR, pad, d0-d31 (with FP), r4-r11, r0-r3, r12, lr, pc, cpsr */
+#ifdef __ARM_FP
+#define FRAME_FP_WORDS  (2 + 2 * 32)
+#else
+#define FRAME_FP_WORDS  0
+#endif
+#define FRAME_WORDS     (FRAME_FP_WORDS + 8 + 6 + 2)
+#define FRAME_R0        (FRAME_FP_WORDS + 8)
+#define FRAME_PC        (FRAME_WORDS - 2)
+#define FRAME_CPSR      (FRAME_WORDS - 1)
+
+/* Per core. Other cores only insert into the ready queues, under the lock;
+ * everything else is touched only by the owner core, with interrupts
+ * disabled. */
+struct runq {
+    uint32_t lock;
+    struct thread *current;
+    struct thread *prev; /* being switched out */
+    uint32_t ready; /* bitmask of non-empty queues, by priority */
+    struct thread *head[KERNEL_PRIOS], *tail[KERNEL_PRIOS];
+    struct thread *sleeping;
+    struct thread idle; /* lower priority than any other thread */
+    uint32_t ticks;
+    unsigned irq_depth; /* ISRs in progress, more than one if nested */
+    volatile bool resched; /* pick again at the next interrupt exit */
+    bool slice_over; /* let threads of equal priority in */
+    volatile bool started;
+};
+
+static struct runq runqs[KERNEL_MAX_CORES];
+static kernel_ipi_fn_t *kernel_ipi;
+
+/* In startup.s: saves the context of rq->prev, and restores rq->current */
+extern void kernel_switch();
+
+static struct runq *this_runq()
+{
+    unsigned core = self_core_id();
+    ASSERT(core < KERNEL_MAX_CORES);
+    return &runqs[core];
+}
+
+static void rq_push(struct runq *rq, struct thread *t)
+{
+    t->next = NULL;
+    if (rq->tail[t->prio])
+        rq->tail[t->prio]->next = t;
+    else
+        rq->head[t->prio] = t;
+    rq->tail[t->prio] = t;
+    rq->ready |= 1u << t->prio;
+}
+
+static struct thread *rq_pop(struct runq *rq)
+{
+    unsigned prio = __builtin_ctz(rq->ready);
+    struct thread *t = rq->head[prio];
+    rq->head[prio] = t->next;
+    if (!t->next) {
+        rq->tail[prio] = NULL;
+        rq->ready &= ~(1u << prio);
+    }
+    t->next = NULL;
+    return t;
+}
+
+/* With the run queue locked: pick the thread to run on this core, returns
+ * whether to switch from rq->prev to it (in rq->current) */
+static bool pick_next(struct runq *rq)
+{
+    struct thread *cur = rq->current;
+    bool rotate = rq->slice_over;
+
+    rq->resched = false;
+    rq->slice_over = false;
+    if (cur->state == THREAD_RUNNING) {
+        if (!rq->ready)
+            return false;
+        unsigned prio = __builtin_ctz(rq->ready);
+        if (prio > cur->prio || (prio == cur->prio && !rotate))
+            return false;
+        cur->state = THREAD_READY;
+        if (cur != &rq->idle)
+            rq_push(rq, cur);
+    }
+
+    struct thread *next = rq->ready ? rq_pop(rq) : &rq->idle;
+    next->state = THREAD_RUNNING;
+    if (next == cur)
+        return false;
+    DPRINTF("KERNEL: core %u: %s -> %s\r\n", next->core, cur->name, next->name);
+    next->switches++;
+    rq->prev = cur;
+    rq->current = next;
+    return true;
+}
+
+/* With interrupts disabled */
+static void reschedule(struct runq *rq)
+{
+    lock_mutex(&rq->lock);
+    bool sw = pick_next(rq);
+    unlock_mutex(&rq->lock);
+    if (sw)
+        kernel_switch();
+}
+
+/* With interrupts disabled, from any core */
+static void make_ready(struct thread *t)
+{
+    struct runq *rq = &runqs[t->core];
+    bool preempt = false;
+
+    lock_mutex(&rq->lock);
+    if (t == rq->current) { // blocking, but not switched away yet
+        t->state = THREAD_RUNNING;
+    } else {
+        t->state = THREAD_READY;
+        rq_push(rq, t);
+        preempt = rq->started && t->prio < rq->current->prio;
+    }
+    unlock_mutex(&rq->lock);
+
+    if (!preempt)
+        return;
+    if (t->core == self_core_id())
+        rq->resched = true;
+    else if (kernel_ipi) // else, it will be picked at the next tick there
+        kernel_ipi(t->core);
+}
+
+/* After making threads ready: switch now if the caller may be preempted,
+ * else at the next interrupt exit. An ISR may run with interrupts enabled,
+ * if nested, but is not preemptible. */
+static void preempt_point(uint32_t cpsr)
+{
+    struct runq *rq = this_runq();
+    if (!(cpsr & CPSR_I) && !rq->irq_depth && rq->started && rq->resched)
+        reschedule(rq);
+}
+
+static struct thread *block_self(uint32_t cpsr)
+{
+    struct runq *rq = this_runq();
+    ASSERT(!(cpsr & CPSR_I) && "blocking with interrupts disabled");
+    ASSERT(!rq->irq_depth && "blocking in an ISR");
+    ASSERT(rq->started && rq->current != &rq->idle);
+    return rq->current;
+}
+
+void kernel_init(kernel_ipi_fn_t *ipi)
+{
+    printf("KERNEL: init: %u cores, tick %u ms\r\n",
+           KERNEL_MAX_CORES, KERNEL_TICK_MS);
+    bzero(runqs, sizeof(runqs));
+    for (unsigned core = 0; core < KERNEL_MAX_CORES; ++core)
+        runqs[core].lock = unlocked;
+    kernel_ipi = ipi;
+}
+
+static void thread_entry(struct thread *t)
+{
+    t->fn(t->arg);
+    thread_exit();
+}
+
+void thread_create(struct thread *t, const char *name, unsigned prio,
+                   unsigned core, void *stack, unsigned stack_size,
+                   thread_fn_t *fn, void *arg)
+{
+    ASSERT(t && fn && stack);
+    ASSERT(prio < KERNEL_PRIOS);
+    ASSERT(core < KERNEL_MAX_CORES);
+    ASSERT(stack_size >= KERNEL_MIN_STACK);
+    printf("KERNEL: create thread %s prio %u core %u\r\n", name, prio, core);
+
+    t->name = name;
+    t->fn = fn;
+    t->arg = arg;
+    t->prio = prio;
+    t->core = core;
+    t->next = NULL;
+    t->switches = 0;
+
+    // the initial context 'returns' into thread_entry(t)
+    uint32_t *sp = (uint32_t *)(((uintptr_t)stack + stack_size) & ~7);
+    uint32_t pc = (uint32_t)thread_entry;
+    sp -= FRAME_WORDS;
+    bzero(sp, FRAME_WORDS * sizeof(*sp));
+    sp[FRAME_R0] = (uint32_t)t;
+    sp[FRAME_PC] = pc & ~1;
+    sp[FRAME_CPSR] = CPSR_MODE_SVC | (pc & 1 ? CPSR_T : 0);
+    t->sp = sp;
+
+    uint32_t cpsr = int_save_disable();
+    make_ready(t);
+    preempt_point(cpsr);
+    int_restore(cpsr);
+}
+
+void kernel_start(kernel_idle_fn_t *idle, void *idle_arg)
+{
+    struct runq *rq = this_runq();
+    struct thread *self = &rq->idle;
+
+    int_disable();
+    self->name = "idle";
+    self->prio = KERNEL_PRIOS;
+    self->core = rq - runqs;
+    self->state = THREAD_RUNNING;
+    lock_mutex(&rq->lock);
+    rq->current = self;
+    rq->started = true;
+    unlock_mutex(&rq->lock);
+    reschedule(rq);
+    int_enable();
+
+    while (1) {
+        int_disable();
+        if (idle)
+            idle(idle_arg);
+        asm("wfi"); // a pending interrupt wakes it up even while masked
+        int_enable(); // take it, and switch on the way out
+    }
+}
+
+void kernel_tick()
+{
+    struct runq *rq = this_runq();
+    if (!rq->started)
+        return;
+
+    uint32_t cpsr = int_save_disable(); // against nested ISRs
+    rq->ticks++;
+    struct thread **pp = &rq->sleeping;
+    while (*pp) {
+        struct thread *t = *pp;
+        if ((int32_t)(rq->ticks - t->wakeup) >= 0) {
+            *pp = t->next;
+            make_ready(t);
+        } else {
+            pp = &t->next;
+        }
+    }
+    rq->slice_over = true;
+    rq->resched = true;
+    int_restore(cpsr);
+}
+
+void kernel_ipi_isr()
+{
+    this_runq()->resched = true;
+}
+
+void kernel_irq_enter()
+{
+    this_runq()->irq_depth++;
+}
+
+bool kernel_irq_exit()
+{
+    struct runq *rq = this_runq();
+    ASSERT(rq->irq_depth);
+    if (--rq->irq_depth) // switch only on the way out to the thread
+        return false;
+    if (!rq->started || !rq->resched)
+        return false;
+    lock_mutex(&rq->lock);
+    bool sw = pick_next(rq);
+    unlock_mutex(&rq->lock);
+    return sw;
+}
+
+uint32_t *kernel_switch_context(uint32_t *sp)
+{
+    struct runq *rq = this_runq();
+    rq->prev->sp = sp;
+    return rq->current->sp;
+}
+
+struct thread *thread_self()
+{
+    return this_runq()->current;
+}
+
+void thread_yield()
+{
+    uint32_t cpsr = int_save_disable();
+    struct runq *rq = this_runq();
+    rq->slice_over = true;
+    reschedule(rq);
+    int_restore(cpsr);
+}
+
+void thread_sleep_ms(unsigned ms)
+{
+    unsigned ticks = (ms + KERNEL_TICK_MS - 1) / KERNEL_TICK_MS;
+    if (!ticks) {
+        thread_yield();
+        return;
+    }
+
+    uint32_t cpsr = int_save_disable();
+    struct thread *self = block_self(cpsr);
+    struct runq *rq = this_runq();
+    self->wakeup = rq->ticks + ticks;
+    self->state = THREAD_BLOCKED;
+    self->next = rq->sleeping;
+    rq->sleeping = self;
+    reschedule(rq);
+    int_restore(cpsr);
+}
+
+void thread_exit()
+{
+    int_disable();
+    struct runq *rq = this_runq();
+    DPRINTF("KERNEL: thread %s exited\r\n", rq->current->name);
+    rq->current->state = THREAD_DONE;
+    reschedule(rq);
+    panic("exited thread resumed");
+}
+
+void sem_init(struct sem *s, int32_t count)
+{
+    ASSERT(s);
+    ASSERT(count >= 0);
+    s->count = count;
+    s->lock = unlocked;
+    s->head = s->tail = NULL;
+}
+
+/* Takes a unit without the lock, if there is one (LDREX/STREX) */
+static bool sem_take(struct sem *s)
+{
+    int32_t c = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+    while (c > 0) {
+        if (__atomic_compare_exchange_n(&s->count, &c, c - 1, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+bool sem_trywait(struct sem *s)
+{
+    return sem_take(s);
+}
+
+void sem_wait(struct sem *s)
+{
+    if (sem_take(s))
+        return;
+
+    uint32_t cpsr = int_save_disable();
+    struct thread *self = block_self(cpsr);
+    lock_mutex(&s->lock);
+    if (sem_take(s)) { // posted in the meantime
+        unlock_mutex(&s->lock);
+        int_restore(cpsr);
+        return;
+    }
+    self->next = NULL;
+    if (s->tail)
+        s->tail->next = self;
+    else
+        s->head = self;
+    s->tail = self;
+    self->state = THREAD_BLOCKED;
+    unlock_mutex(&s->lock);
+
+    reschedule(this_runq()); // sem_post hands the unit over to us
+    int_restore(cpsr);
+}
+
+void sem_post(struct sem *s)
+{
+    uint32_t cpsr = int_save_disable();
+    lock_mutex(&s->lock);
+    struct thread *t = s->head;
+    if (t) {
+        s->head = t->next;
+        if (!s->head)
+            s->tail = NULL;
+    } else {
+        __atomic_fetch_add(&s->count, 1, __ATOMIC_RELEASE);
+    }
+    unlock_mutex(&s->lock);
+
+    if (t) {
+        make_ready(t);
+        preempt_point(cpsr);
+    }
+    int_restore(cpsr);
+}
+
+void queue_init(struct queue *q, void *buf, unsigned item_size, unsigned len)
+{
+    ASSERT(q && buf);
+    ASSERT(item_size && len);
+    q->buf = buf;
+    q->item_size = item_size;
+    q->len = len;
+    q->head = q->tail = 0;
+    q->lock = unlocked;
+    sem_init(&q->items, 0);
+    sem_init(&q->slots, len);
+}
+
+/* With a slot taken: store the item and count it */
+static void queue_push(struct queue *q, const void *item)
+{
+    uint32_t cpsr = int_save_disable();
+    lock_mutex(&q->lock);
+    memcpy(q->buf + q->tail * q->item_size, item, q->item_size);
+    if (++q->tail == q->len)
+        q->tail = 0;
+    unlock_mutex(&q->lock);
+    int_restore(cpsr);
+    sem_post(&q->items);
+}
+
+/* With an item taken: load it and free its slot */
+static void queue_pop(struct queue *q, void *item)
+{
+    uint32_t cpsr = int_save_disable();
+    lock_mutex(&q->lock);
+    memcpy(item, q->buf + q->head * q->item_size, q->item_size);
+    if (++q->head == q->len)
+        q->head = 0;
+    unlock_mutex(&q->lock);
+    int_restore(cpsr);
+    sem_post(&q->slots);
+}
+
+void queue_put(struct queue *q, const void *item)
+{
+    sem_wait(&q->slots);
+    queue_push(q, item);
+}
+
+bool queue_tryput(struct queue *q, const void *item)
+{
+    if (!sem_trywait(&q->slots))
+        return false;
+    queue_push(q, item);
+    return true;
+}
+
+void queue_get(struct queue *q, void *item)
+{
+    sem_wait(&q->items);
+    queue_pop(q, item);
+}
+
+bool queue_tryget(struct queue *q, void *item)
+{
+    if (!sem_trywait(&q->items))
+        return false;
+    queue_pop(q, item);
+    return true;
+}
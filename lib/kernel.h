@@ -0,0 +1,115 @@
+#ifndef LIB_KERNEL_H
+#define LIB_KERNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Preemptive kernel for the Cortex-R52 (AArch32): threads with fixed
+ * priorities, each pinned to a core, with a run queue per core. The highest
+ * priority ready thread runs; threads of equal priority share the core in
+ * time slices of one kernel tick. Switches happen on the way out of an
+ * interrupt (the tick, or an IPI from another core that made a thread
+ * ready) or when a thread blocks, yields or exits. All threads, and the ISRs
+ * on their stacks, run in SVC mode.
+ *
+ * Kernel objects that are shared between cores (threads, semaphores,
+ * queues) must be in memory that the cores see coherently, as must any
+ * other data that the existing SMP code shares. */
+
+#define KERNEL_MAX_CORES    2
+#define KERNEL_PRIOS        32 /* 0 is the highest */
+#define KERNEL_TICK_MS      10 /* also the time slice */
+
+/* Minimum stack size: the saved context plus room for the ISRs, which run
+ * on the stack of the interrupted thread (each saves the FP registers that
+ * C code may clobber) */
+#define KERNEL_MIN_STACK    2048
+
+enum thread_state {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,
+    THREAD_DONE,
+};
+
+typedef void (thread_fn_t)(void *arg);
+
+/* Called with interrupts disabled on a core with no ready thread, before
+ * the WFI */
+typedef void (kernel_idle_fn_t)(void *arg);
+
+/* Interrupts another core, to get it to reschedule: see kernel_ipi_isr */
+typedef void (kernel_ipi_fn_t)(unsigned core);
+
+struct thread {
+    uint32_t *sp; /* saved context, while not running: must be first */
+    const char *name;
+    thread_fn_t *fn;
+    void *arg;
+    unsigned prio;
+    unsigned core;
+    volatile enum thread_state state;
+    struct thread *next; /* in a run queue, a sleep list or a wait list */
+    uint32_t wakeup; /* kernel tick, while sleeping */
+    unsigned switches; /* times switched to */
+};
+
+struct sem {
+    volatile int32_t count;
+    uint32_t lock;
+    struct thread *head, *tail; /* waiters, in FIFO order */
+};
+
+struct queue {
+    uint8_t *buf;
+    unsigned item_size;
+    unsigned len; /* in items */
+    unsigned head, tail;
+    uint32_t lock;
+    struct sem items, slots;
+};
+
+/* Once, before any thread is created */
+void kernel_init(kernel_ipi_fn_t *ipi);
+
+/* Threads may be created for a core before the kernel is started on it */
+void thread_create(struct thread *t, const char *name, unsigned prio,
+                   unsigned core, void *stack, unsigned stack_size,
+                   thread_fn_t *fn, void *arg);
+
+/* Turns the caller into the idle thread of the calling core, and runs the
+ * threads of this core; does not return */
+void kernel_start(kernel_idle_fn_t *idle, void *idle_arg);
+
+/* From the periodic timer ISR of each core that runs the kernel */
+void kernel_tick();
+/* From the ISR of the interrupt sent by the ipi callback */
+void kernel_ipi_isr();
+
+/* Called by the IRQ handler (startup.s), with interrupts disabled, around
+ * the ISR, which may be preempted by more urgent interrupts (nested) with
+ * CONFIG_IRQ_NESTING */
+void kernel_irq_enter();
+bool kernel_irq_exit();
+uint32_t *kernel_switch_context(uint32_t *sp);
+
+struct thread *thread_self();
+void thread_yield();
+void thread_sleep_ms(unsigned ms);
+void thread_exit();
+
+/* Safe to call from ISRs: sem_post, sem_trywait, queue_tryput,
+ * queue_tryget. A thread woken by an ISR, or by a thread that has
+ * interrupts disabled, preempts at the next interrupt exit. */
+void sem_init(struct sem *s, int32_t count);
+void sem_wait(struct sem *s);
+bool sem_trywait(struct sem *s);
+void sem_post(struct sem *s);
+
+void queue_init(struct queue *q, void *buf, unsigned item_size, unsigned len);
+void queue_put(struct queue *q, const void *item); /* blocks while full */
+bool queue_tryput(struct queue *q, const void *item);
+void queue_get(struct queue *q, void *item); /* blocks while empty */
+bool queue_tryget(struct queue *q, void *item);
+
+#endif /* LIB_KERNEL_H */
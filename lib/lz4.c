@@ -0,0 +1,91 @@
+#include <stdint.h>
+
+#include "panic.h"
+#include "bit.h"
+
+#include "lz4.h"
+
+#define MIN_MATCH 4
+
+struct lz4_in {
+    const volatile uint32_t *p;
+    uint32_t word;
+    unsigned avail; // bytes left in word
+    unsigned left;  // bytes left in stream, including those in word
+};
+
+static inline int in_byte(struct lz4_in *in)
+{
+    if (!in->left)
+        return -1;
+    if (!in->avail) {
+        in->word = *in->p++; // little-endian
+        in->avail = sizeof(in->word);
+    }
+    uint8_t b = in->word & 0xff;
+    in->word >>= 8;
+    in->avail--;
+    in->left--;
+    return b;
+}
+
+/* Length field continued by 0xff bytes, as in both literals and matches */
+static inline int in_len(struct lz4_in *in, unsigned len)
+{
+    int b;
+    if (len != 0xf)
+        return len;
+    do {
+        b = in_byte(in);
+        if (b < 0)
+            return -1;
+        len += b;
+    } while (b == 0xff);
+    return len;
+}
+
+int lz4_decompress(uint8_t *dst, unsigned dst_size,
+                   const volatile uint32_t *src, unsigned src_size)
+{
+    struct lz4_in in = { .p = src, .avail = 0, .left = src_size };
+    uint8_t *out = dst;
+    uint8_t *end = dst + dst_size;
+    int token, len, b;
+
+    ASSERT(ALIGNED(src, 2)); /* log2(sizeof(uint32_t)) */
+
+    while ((token = in_byte(&in)) >= 0) {
+        len = in_len(&in, token >> 4);
+        if (len < 0 || len > end - out)
+            return -1;
+        while (len--) {
+            if ((b = in_byte(&in)) < 0)
+                return -1;
+            *out++ = b;
+        }
+
+        if (!in.left) // last sequence has literals only
+            break;
+
+        int lo = in_byte(&in);
+        int hi = in_byte(&in);
+        if (lo < 0 || hi < 0)
+            return -1;
+        unsigned offset = lo | (hi << 8);
+        if (!offset || offset > out - dst)
+            return -1;
+
+        len = in_len(&in, token & 0xf);
+        if (len < 0)
+            return -1;
+        len += MIN_MATCH;
+        if (len > end - out)
+            return -1;
+
+        // byte-wise: the match may overlap the output (e.g. runs, offset 1)
+        const uint8_t *m = out - offset;
+        while (len--)
+            *out++ = *m++;
+    }
+    return out - dst;
+}
@@ -0,0 +1,19 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+
+/* lz4_decompress: decode an LZ4 block (raw block format, no frame) from
+ * (possibly slow) storage directly to its destination in memory
+ *
+ * The source is streamed through once with aligned word reads. Matches are
+ * copied from the already-decoded output, so only @dst must be fast memory.
+ *
+ * @src: must be word aligned
+ * Returns number of bytes written to @dst, or -1 if the block is malformed
+ * or would overflow @dst_size.
+ */
+int lz4_decompress(uint8_t *dst, unsigned dst_size,
+                   const volatile uint32_t *src, unsigned src_size);
+
+#endif // LZ4_H
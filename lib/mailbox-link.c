@@ -1,3 +1,5 @@
+#define DEBUG 0
+
 #include <stdbool.h>
 
 #include "command.h"
@@ -8,6 +10,7 @@
 #include "panic.h"
 #include "console.h"
 #include "sleep.h"
+#include "work.h"
 
 
 #define MAX_LINKS 8
@@ -28,6 +31,7 @@ struct mbox_link {
     struct mbox *mbox_from;
     struct mbox *mbox_to;
     volatile struct cmd_ctx cmd_ctx;
+    struct work rcv_work; /* server: read, ack and enqueue the command */
 };
 
 static struct mbox_link_dev *devs[MBOX_DEV_COUNT] = {0};
@@ -61,12 +65,12 @@ static void handle_ack(void *arg)
 {
     struct link *link = arg;
     struct mbox_link *mlink = link->priv;
-    printf("%s: handle_ack\r\n", link->name);
+    DPRINTF("%s: handle_ack\r\n", link->name);
     mlink->cmd_ctx.tx_acked = true;
     mbox_event_clear_ack(mlink->mbox_to);
 }
 
-static void handle_cmd(void *arg)
+static void handle_cmd_work(void *arg)
 {
     struct link *link = arg;
     struct mbox_link *mlink = link->priv;
@@ -74,20 +78,29 @@ static void handle_cmd(void *arg)
     cmd.link = link;
     ASSERT(sizeof(cmd.msg) == HPSC_MBOX_DATA_SIZE); // o/w zero-fill rest of msg
 
-    printf("%s: handle_cmd\r\n", link->name);
+    DPRINTF("%s: handle_cmd\r\n", link->name);
     // read never fails if sizeof(cmd.msg) > 0
     cmd.len = mbox_read(mlink->mbox_from, cmd.msg, sizeof(cmd.msg));
-    mbox_event_clear_rcv(mlink->mbox_from);
     mbox_event_set_ack(mlink->mbox_from);
     if (cmd_enqueue(&cmd))
         panic("handle_cmd: failed to enqueue command");
 }
 
+// The message stays in the mailbox until we ACK, so the ISR only quiets the
+// interrupt and leaves the copy to deferred work.
+static void handle_cmd(void *arg)
+{
+    struct link *link = arg;
+    struct mbox_link *mlink = link->priv;
+    mbox_event_clear_rcv(mlink->mbox_from);
+    work_queue(&mlink->rcv_work);
+}
+
 static void handle_reply(void *arg)
 {
     struct link *link = arg;
     struct mbox_link *mlink = link->priv;
-    printf("%s: handle_reply\r\n", link->name);
+    DPRINTF("%s: handle_reply\r\n", link->name);
     mlink->cmd_ctx.reply_sz_read = mbox_read(mlink->mbox_from,
                                              mlink->cmd_ctx.reply,
                                              mlink->cmd_ctx.reply_sz);
@@ -99,6 +112,7 @@ static int mbox_link_disconnect(struct link *link) {
     struct mbox_link *mlink = link->priv;
     int rc;
     printf("%s: disconnect\r\n", link->name);
+    work_cancel(&mlink->rcv_work);
     // in case of failure, keep going and fwd code
     rc = mbox_release(mlink->mbox_from);
     rc |= mbox_release(mlink->mbox_to);
@@ -207,6 +221,7 @@ struct link *mbox_link_connect(const char *name, struct mbox_link_dev *ldev,
 
     mlink->idx_from = idx_from;
     mlink->idx_to = idx_to;
+    work_init(&mlink->rcv_work, name, WORK_PRIO_HIGH, handle_cmd_work, link);
 
     union mbox_cb rcv_cb = { .rcv_cb = server ? handle_cmd : handle_reply };
     mlink->mbox_from = mbox_claim(ldev->base, idx_from,
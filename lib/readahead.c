@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "blkdev.h"
+#include "mem.h"
+#include "panic.h"
+
+#include "readahead.h"
+
+static int issue(struct readahead *ra)
+{
+    struct blkdev *dev = ra->dev;
+    uint32_t start = ra->next_block * dev->block_size;
+    uint8_t *buf = ra->dst + (start - ra->offset);
+    int rc;
+
+    if (start < ra->offset || start + dev->block_size > ra->offset + ra->len ||
+        ((uintptr_t)buf & (DMA_MAX_BURST_BYTES - 1))) {
+        buf = ra->bounce[ra->bounce_next];
+        ra->bounce_next ^= 1;
+    }
+    rc = dev->read_start(dev, ra->next_block, buf);
+    if (rc) {
+        printf("READAHEAD: ERROR: %s: failed to start read of block %u\r\n",
+               dev->name, ra->next_block);
+        return rc;
+    }
+    ra->inflight = buf;
+    ra->next_block++;
+    return 0;
+}
+
+int readahead_start(struct readahead *ra, struct blkdev *dev,
+                    uint32_t offset, uint8_t *dst, uint32_t len)
+{
+    ASSERT(ra);
+    ASSERT(dev);
+    ASSERT(dev->block_size <= READAHEAD_MAX_BLOCK_SIZE);
+
+    ra->dev = dev;
+    ra->dst = dst;
+    ra->offset = offset;
+    ra->len = len;
+    ra->done = 0;
+    ra->inflight = NULL;
+    ra->bounce_next = 0;
+    ra->next_block = offset / dev->block_size;
+    ra->end_block = (offset + len + dev->block_size - 1) / dev->block_size;
+    if (ra->end_block > dev->num_blocks) {
+        printf("READAHEAD: ERROR: %s: range 0x%x+0x%x beyond end of device\r\n",
+               dev->name, offset, len);
+        return 1;
+    }
+    if (!len)
+        return 0;
+    return issue(ra);
+}
+
+int readahead_next(struct readahead *ra)
+{
+    ASSERT(ra);
+    ASSERT(ra->inflight);
+    struct blkdev *dev = ra->dev;
+    uint8_t *buf = ra->inflight;
+    uint32_t start = (ra->next_block - 1) * dev->block_size;
+    uint32_t end = start + dev->block_size;
+    int rc;
+
+    ra->inflight = NULL;
+    rc = dev->read_finish(dev);
+    if (rc) {
+        printf("READAHEAD: ERROR: %s: read of block %u failed\r\n",
+               dev->name, ra->next_block - 1);
+        return rc;
+    }
+    if (ra->next_block < ra->end_block) {
+        rc = issue(ra);
+        if (rc)
+            return rc;
+    }
+
+    uint32_t from = start > ra->offset ? start : ra->offset;
+    uint32_t to = end < ra->offset + ra->len ? end : ra->offset + ra->len;
+    uint8_t *dst = ra->dst + (from - ra->offset);
+    if (buf != dst)
+        memcpy(dst, buf + (from - start), to - from);
+    ra->done = to - ra->offset;
+    return 0;
+}
+
+void readahead_cancel(struct readahead *ra)
+{
+    ASSERT(ra);
+    if (ra->inflight) {
+        ra->dev->read_finish(ra->dev);
+        ra->inflight = NULL;
+    }
+}
+
+int readahead_read(struct readahead *ra, struct blkdev *dev,
+                   uint32_t offset, uint8_t *dst, uint32_t len)
+{
+    int rc = readahead_start(ra, dev, offset, dst, len);
+    while (!rc && ra->done < len)
+        rc = readahead_next(ra);
+    return rc;
+}
@@ -0,0 +1,50 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <stdint.h>
+
+#include "dma.h"
+
+struct blkdev;
+
+#define READAHEAD_MAX_BLOCK_SIZE 2048
+
+/* Streams a byte range of a block device into memory, keeping the next
+ * block in flight while the consumer works on the data that has landed.
+ *
+ * Blocks that are wholly inside the range and land at a burst-aligned
+ * address are read straight into the destination; the (at most two) partial
+ * blocks at the ends go through the bounce buffers. Two are enough since the
+ * device has only one read in flight. */
+struct readahead {
+    struct blkdev *dev;
+    uint8_t *dst;
+    uint32_t offset; /* of the range on the device, in bytes */
+    uint32_t len;
+    uint32_t done; /* bytes at the start of dst that have landed */
+    unsigned next_block; /* to issue */
+    unsigned end_block;
+    uint8_t *inflight; /* buffer of the block in flight, NULL if none */
+    unsigned bounce_next;
+    uint8_t bounce[2][READAHEAD_MAX_BLOCK_SIZE]
+        __attribute__((aligned(DMA_MAX_BURST_BYTES)));
+};
+
+/* readahead_start: issue the read of the first block of the range */
+int readahead_start(struct readahead *ra, struct blkdev *dev,
+                    uint32_t offset, uint8_t *dst, uint32_t len);
+
+/* readahead_next: wait for the block in flight, issue the next one, and
+ * only then copy out of the bounce buffer (if any); ra->done advances to the
+ * end of the landed block. Returns 0 on success. On error, nothing is left
+ * in flight. */
+int readahead_next(struct readahead *ra);
+
+/* readahead_cancel: wait for the block in flight, if any, and drop it */
+void readahead_cancel(struct readahead *ra);
+
+/* readahead_read: start and run to completion */
+int readahead_read(struct readahead *ra, struct blkdev *dev,
+                   uint32_t offset, uint8_t *dst, uint32_t len);
+
+#endif // READAHEAD_H
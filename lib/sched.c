@@ -0,0 +1,84 @@
+#define DEBUG 0
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arm.h"
+#include "console.h"
+#include "panic.h"
+
+#include "sched.h"
+
+static struct sched_task *tasks[SCHED_MAX_TASKS];
+static volatile uint32_t ready; /* bitmask, by priority */
+
+void sched_init()
+{
+    for (unsigned i = 0; i < SCHED_MAX_TASKS; ++i)
+        tasks[i] = NULL;
+    ready = 0;
+}
+
+void sched_add(struct sched_task *task, const char *name, unsigned prio,
+               sched_task_fn_t *fn, void *arg)
+{
+    ASSERT(task && fn);
+    ASSERT(prio < SCHED_MAX_TASKS);
+    ASSERT(!tasks[prio] && "priority taken");
+    printf("SCHED: add task %s prio %u\r\n", name, prio);
+    task->name = name;
+    task->fn = fn;
+    task->arg = arg;
+    task->prio = prio;
+    task->runs = 0;
+    tasks[prio] = task;
+}
+
+void sched_ready(struct sched_task *task)
+{
+    ASSERT(task);
+    if (!task->fn) // not added yet, e.g. a tick early during boot
+        return;
+    // exclusive access, rather than masking interrupts, since ISRs call this
+    __atomic_fetch_or(&ready, 1u << task->prio, __ATOMIC_SEQ_CST);
+}
+
+void sched_ready_cb(void *task)
+{
+    sched_ready(task);
+}
+
+bool sched_run_one()
+{
+    uint32_t r = ready;
+    if (!r)
+        return false;
+    unsigned prio = __builtin_ctz(r);
+    struct sched_task *task = tasks[prio];
+    ASSERT(task);
+
+    // cleared before the run, so that events during the run are not lost
+    __atomic_fetch_and(&ready, ~(1u << prio), __ATOMIC_SEQ_CST);
+    DPRINTF("SCHED: run %s\r\n", task->name);
+    task->runs++;
+    if (task->fn(task->arg))
+        sched_ready(task);
+    return true;
+}
+
+void sched_loop(sched_idle_fn_t *idle, void *idle_arg)
+{
+    while (1) {
+        if (sched_run_one())
+            continue;
+
+        int_disable(); // the check and the WFI must be atomic
+        if (!ready) {
+            if (idle)
+                idle(idle_arg);
+            if (!ready)
+                asm("wfi"); // ignores PRIMASK set by int_disable
+        }
+        int_enable();
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef LIB_SCHED_H
+#define LIB_SCHED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Cooperative scheduler: tasks run to completion, highest priority first,
+ * whenever they are ready. Readiness is a flag, which may be set from ISRs;
+ * a task that is made ready while it runs is run again. Between two tasks,
+ * the ready set is re-evaluated, so a long task should do its work in steps
+ * and return, to let higher priority tasks in. */
+
+#define SCHED_MAX_TASKS 32 /* also the number of priorities */
+
+/* Returns whether there is more work, to be run again without a new event */
+typedef bool (sched_task_fn_t)(void *arg);
+
+/* Called with interrupts disabled when no task is ready, before the WFI */
+typedef void (sched_idle_fn_t)(void *arg);
+
+struct sched_task {
+    const char *name;
+    sched_task_fn_t *fn;
+    void *arg;
+    unsigned prio; /* 0 is the highest, one task per priority */
+    unsigned runs;
+};
+
+void sched_init();
+void sched_add(struct sched_task *task, const char *name, unsigned prio,
+               sched_task_fn_t *fn, void *arg);
+
+/* Safe to call from ISRs */
+void sched_ready(struct sched_task *task);
+void sched_ready_cb(void *task); /* sched_ready, as a notification callback */
+
+/* Run the highest priority ready task, returns false if none was ready */
+bool sched_run_one();
+
+/* Run tasks and sleep when none is ready, forever */
+void sched_loop(sched_idle_fn_t *idle, void *idle_arg);
+
+#endif /* LIB_SCHED_H */
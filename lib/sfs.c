@@ -1,17 +1,39 @@
 #include <stdlib.h>
+#include <stddef.h>
 
 #include "panic.h"
 #include "str.h"
 #include "dma.h"
 #include "bit.h"
+#include "blkdev.h"
+#include "ecc.h"
+#include "mem.h"
 #include "object.h"
+#include "lz4.h"
+#include "readahead.h"
+#include "sha256.h"
 
 #include "sfs.h"
 
 #define FILE_NAME_LENGTH 200
-#define ECC_512_SIZE	3
 #define PAGE_SIZE (1 << 14) // 16KB (used for progress display only)
 
+#define ECC_BLOCK_SIZE 256 /* descriptor is one block, excluding ecc field */
+
+/* file_descriptor.valid is a set of flags */
+#define SFS_FD_VALID    0x1
+#define SFS_FD_LZ4      0x2 /* data is an lz4_header followed by an LZ4 block */
+#define SFS_FD_MERKLE   0x4 /* data is a merkle_header, digests, then image */
+
+#define SFS_LZ4_MAGIC   0x345a4653 /* "SFZ4" */
+#define SFS_MERKLE_MAGIC 0x4d534653 /* "SFSM" */
+
+#define MERKLE_BATCH 16 /* chunk digests read at a time, on a block device */
+
+#define MAX_FILES 32
+#define HASH_BUCKETS 64 // power of 2
+#define NO_FILE -1
+
 typedef struct {
     uint32_t valid;
     uint32_t offset;	/* offset in memory */
@@ -20,7 +42,7 @@ typedef struct {
     uint32_t load_addr_high;	/* high 32bit of 64 bit load address in DRAM at run-time */
     char  name[FILE_NAME_LENGTH];
     uint32_t entry_offset;	/* the offset of the entry point in the image */
-    uint8_t chcksum[32];		/* SHA-256 checksum */
+    uint8_t chcksum[SFS_CHECKSUM_SIZE];		/* SHA-256 checksum */
     uint8_t ecc[ECC_512_SIZE];	/* ecc of the struct */
 } file_descriptor;
 
@@ -32,14 +54,172 @@ typedef struct {
     uint8_t ecc[ECC_512_SIZE];   /* ecc of the struct */
 } global_table;
 
+typedef struct {
+    uint32_t magic;
+    uint32_t raw_size;  /* size after decompression */
+} lz4_header;
+
+/* Hash-tree manifest: the image is split into chunks, with one SHA-256 digest
+ * per chunk stored after this header. The checksum in the file descriptor is
+ * the root: the SHA-256 over all the chunk digests. */
+typedef struct {
+    uint32_t magic;
+    uint32_t chunk_size;  /* bytes of image per digest, power of 2 */
+    uint32_t n_chunks;
+    uint32_t data_offset; /* of the image, from start of file data */
+} merkle_header;
+
+enum manifest_state {
+    MANIFEST_NONE = 0,
+    MANIFEST_UNCHECKED, /* root not checked yet */
+    MANIFEST_OK,
+    MANIFEST_BAD,
+};
+
+struct sfs_file {
+    struct sfs *fs;
+    file_descriptor fd; /* validated (and possibly corrected) copy */
+    uint32_t load_size; /* size in memory after loading (fd.size is stored size) */
+    uint32_t data_offset; /* of image within file data (after manifest) */
+    uint32_t chunk_size; /* of manifest, if any */
+    uint32_t n_chunks;
+    enum manifest_state manifest;
+    uint32_t hash;
+    int next; /* index of next file in the same hash bucket */
+};
+
 struct sfs {
-    uint8_t *base;
+    struct object obj;
+    uint8_t *base; // NULL if on a block device
+    struct blkdev *dev;
+    uint32_t dev_offset; /* of the file system on the block device */
     struct dma *dmac; // optional, for loading files via DMA
+    unsigned n_files;
+    struct sfs_file files[MAX_FILES];
+    int buckets[HASH_BUCKETS]; /* index of first file in bucket */
+    struct readahead ra; /* on a block device, all reads go through this */
 };
 
 #define MAX_SFS 2
 static struct sfs sfss[MAX_SFS];
 
+/* FNV-1a */
+uint32_t sfs_name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Copy from storage, at an offset from the start of the file system */
+static int read_bytes(struct sfs *fs, uint32_t offset, void *dst, unsigned len)
+{
+    if (fs->base) {
+        mem_vcpy(dst, fs->base + offset, len);
+        return 0;
+    }
+    return readahead_read(&fs->ra, fs->dev, fs->dev_offset + offset, dst, len);
+}
+
+/* Check and correct the ECC over the bytes of a struct that precede its
+ * ecc field. Returns 0 if the data is good (possibly after correction). */
+static int check_ecc(const char *what, uint8_t *buf, unsigned len,
+                     uint8_t *ecc)
+{
+    struct ecc_region_stats stats = {0};
+
+    ASSERT(len <= ECC_BLOCK_SIZE);
+    if (ecc_check_region(buf, len, ECC_BLOCK_SIZE, ecc, &stats)) {
+        printf("SFS: ERROR: %s: uncorrectable ECC error\r\n", what);
+        return 1;
+    }
+    if (stats.corrected)
+        printf("SFS: WARN: %s: corrected ECC error\r\n", what);
+    return 0;
+}
+
+static int parse_manifest(struct sfs_file *f, struct sfs *fs)
+{
+    file_descriptor *fd = &f->fd;
+    merkle_header hdr;
+
+    if (read_bytes(fs, fd->offset, &hdr, sizeof(hdr)))
+        return 1;
+    if (hdr.magic != SFS_MERKLE_MAGIC || (fd->valid & SFS_FD_LZ4) ||
+        !hdr.chunk_size || (hdr.chunk_size & (hdr.chunk_size - 1)) ||
+        hdr.chunk_size < DMA_MAX_BURST_BYTES || (hdr.data_offset & 0x3) ||
+        hdr.data_offset < sizeof(hdr) + hdr.n_chunks * SFS_CHECKSUM_SIZE ||
+        hdr.data_offset > fd->size ||
+        hdr.n_chunks != (fd->size - hdr.data_offset + hdr.chunk_size - 1) /
+                        hdr.chunk_size) {
+        printf("SFS: ERROR: %s: bad manifest\r\n", fd->name);
+        return 1;
+    }
+    f->data_offset = hdr.data_offset;
+    f->load_size = fd->size - hdr.data_offset;
+    f->chunk_size = hdr.chunk_size;
+    f->n_chunks = hdr.n_chunks;
+    f->manifest = MANIFEST_UNCHECKED;
+    return 0;
+}
+
+static void index_files(struct sfs *fs, unsigned n_files)
+{
+    unsigned i;
+    uint32_t fd_offset = sizeof(global_table);
+
+    for (i = 0; i < HASH_BUCKETS; ++i)
+        fs->buckets[i] = NO_FILE;
+    fs->n_files = 0;
+
+    for (i = 0; i < n_files; ++i, fd_offset += sizeof(file_descriptor)) {
+        struct sfs_file *f = &fs->files[fs->n_files];
+        file_descriptor *fd = &f->fd;
+
+        if (read_bytes(fs, fd_offset, fd, sizeof(*fd)))
+            continue;
+        if (check_ecc("file descriptor", (uint8_t *)fd,
+                      offsetof(file_descriptor, ecc), fd->ecc))
+            continue;
+        if (!(fd->valid & SFS_FD_VALID))
+            continue;
+        fd->name[FILE_NAME_LENGTH - 1] = '\0';
+
+        f->load_size = fd->size;
+        f->data_offset = 0;
+        f->manifest = MANIFEST_NONE;
+        if ((fd->valid & SFS_FD_MERKLE) && parse_manifest(f, fs))
+            continue;
+        if (fd->valid & SFS_FD_LZ4) {
+            lz4_header hdr;
+            if (!fs->base) { // decompressor needs the whole block in memory
+                printf("SFS: ERROR: %s: compressed files are not supported "
+                       "on a block device\r\n", fd->name);
+                continue;
+            }
+            mem_vcpy(&hdr, fs->base + fd->offset, sizeof(hdr));
+            if (hdr.magic != SFS_LZ4_MAGIC || fd->size < sizeof(hdr)) {
+                printf("SFS: ERROR: %s: bad compressed file header\r\n",
+                       fd->name);
+                continue;
+            }
+            f->load_size = hdr.raw_size;
+        }
+
+        f->fs = fs;
+        f->hash = sfs_name_hash(fd->name);
+        unsigned b = f->hash & (HASH_BUCKETS - 1);
+        f->next = fs->buckets[b];
+        fs->buckets[b] = fs->n_files++;
+
+        DPRINTF("SFS: file #%u: %s: offset 0x%x size %u load 0x%x\r\n",
+                i, fd->name, fd->offset, fd->size, fd->load_addr);
+    }
+}
+
 static int load_dma(uint32_t *sram_addr, uint32_t *load_addr, unsigned size,
                     struct dma *dmac)
 {
@@ -93,72 +273,400 @@ static int load_memcpy(uint32_t *mem_addr, uint32_t *load_addr, unsigned size)
     return 0;
 }
 
-struct sfs *sfs_mount(uint8_t *base, struct dma *dmac)
+static int load_lz4(uint32_t *mem_addr, uint32_t *load_addr, unsigned size,
+                    unsigned raw_size)
+{
+    DPRINTF("SFS: decompressing %u -> %u bytes\r\n", size, raw_size);
+    int n = lz4_decompress((uint8_t *)load_addr, raw_size,
+                           mem_addr + sizeof(lz4_header) / sizeof(uint32_t),
+                           size - sizeof(lz4_header));
+    if (n != raw_size) {
+        printf("SFS: ERROR: decompression failed: rc %d (expected %u)\r\n",
+               n, raw_size);
+        return 1;
+    }
+    return 0;
+}
+
+/* Offset of the digest of a chunk, from the start of the file system */
+static uint32_t chunk_digest(struct sfs_file *f, unsigned chunk)
+{
+    return f->fd.offset + sizeof(merkle_header) + chunk * SFS_CHECKSUM_SIZE;
+}
+
+static unsigned chunk_len(struct sfs_file *f, unsigned chunk)
+{
+    unsigned off = chunk * f->chunk_size;
+    return f->load_size - off < f->chunk_size ? f->load_size - off
+                                              : f->chunk_size;
+}
+
+/* The digests are checked against the root (which is ECC-protected in the
+ * descriptor) on first use, rather than at mount for all files. */
+static int check_manifest(struct sfs_file *f)
+{
+    struct sfs *fs = f->fs;
+    uint8_t root[SFS_CHECKSUM_SIZE];
+    int rc = 0;
+
+    if (f->manifest == MANIFEST_UNCHECKED) {
+        if (fs->base) {
+            mbedtls_sha256_ret(fs->base + chunk_digest(f, 0),
+                               f->n_chunks * SFS_CHECKSUM_SIZE, root, 0);
+        } else {
+            uint8_t digests[MERKLE_BATCH * SFS_CHECKSUM_SIZE];
+            mbedtls_sha256_context ctx;
+            mbedtls_sha256_init(&ctx);
+            mbedtls_sha256_starts_ret(&ctx, 0);
+            for (unsigned i = 0; !rc && i < f->n_chunks; i += MERKLE_BATCH) {
+                unsigned n = f->n_chunks - i < MERKLE_BATCH ?
+                                f->n_chunks - i : MERKLE_BATCH;
+                rc = read_bytes(fs, chunk_digest(f, i), digests,
+                                n * SFS_CHECKSUM_SIZE);
+                mbedtls_sha256_update_ret(&ctx, digests, n * SFS_CHECKSUM_SIZE);
+            }
+            mbedtls_sha256_finish_ret(&ctx, root);
+            if (rc)
+                return 1; // not known to be bad, may check again later
+        }
+        f->manifest = memcmp(root, f->fd.chcksum, SFS_CHECKSUM_SIZE) ?
+                        MANIFEST_BAD : MANIFEST_OK;
+        if (f->manifest == MANIFEST_BAD)
+            printf("SFS: ERROR: %s: manifest does not match root\r\n",
+                   f->fd.name);
+    }
+    return f->manifest == MANIFEST_OK ? 0 : 1;
+}
+
+/* Load the image chunk by chunk, checking each one as soon as it lands. With
+ * DMA, the next chunk is in flight while the current one is checked. */
+static int load_merkle(struct sfs_file *f, uint32_t *mem_addr,
+                       uint32_t *load_addr)
+{
+    struct dma *dmac = f->fs->dmac;
+    struct dma_tx *dtx = NULL;
+    unsigned words = f->chunk_size / sizeof(uint32_t);
+    int rc = 0;
+
+    if (check_manifest(f))
+        return 1;
+    if (dmac)
+        dtx = dma_transfer(dmac, /* chan */ 0, mem_addr, load_addr,
+                ALIGN(chunk_len(f, 0), DMA_MAX_BURST_BITS), NULL, NULL);
+    for (unsigned i = 0; i < f->n_chunks; ++i) {
+        if (dmac) {
+            rc = dtx ? dma_wait(dtx) : 1;
+            dtx = NULL;
+            if (rc) {
+                printf("SFS: ERROR: %s: DMA of chunk %u failed\r\n",
+                       f->fd.name, i);
+                break;
+            }
+            if (i + 1 < f->n_chunks)
+                dtx = dma_transfer(dmac, /* chan */ 0,
+                        mem_addr + (i + 1) * words, load_addr + (i + 1) * words,
+                        ALIGN(chunk_len(f, i + 1), DMA_MAX_BURST_BITS),
+                        NULL, NULL);
+        } else {
+            load_memcpy(mem_addr + i * words, load_addr + i * words,
+                        chunk_len(f, i));
+        }
+        rc = sfs_verify_chunk(f, i);
+        if (rc) {
+            printf("SFS: ERROR: %s: chunk %u corrupted\r\n", f->fd.name, i);
+            break;
+        }
+    }
+    if (dtx)
+        dma_wait(dtx);
+    return rc;
+}
+
+static int verify_chunk(struct sfs_file *f, unsigned chunk,
+                        const uint8_t *expected)
+{
+    uint8_t digest[SFS_CHECKSUM_SIZE];
+
+    mbedtls_sha256_ret((const unsigned char *)f->fd.load_addr +
+                       chunk * f->chunk_size, chunk_len(f, chunk), digest, 0);
+    return memcmp(digest, expected, SFS_CHECKSUM_SIZE) ? 1 : 0;
+}
+
+/* On a block device, the image streams into memory through the read-ahead
+ * window, and, with a manifest, each chunk is checked as soon as all of it
+ * has landed, while the next block is in flight. The digests are read a
+ * batch at a time, between streams, since the device can't serve them while
+ * a block is in flight. */
+static int load_blk(struct sfs_file *f, uint8_t *load_addr)
+{
+    struct sfs *fs = f->fs;
+    struct readahead *ra = &fs->ra;
+    uint32_t data = fs->dev_offset + f->fd.offset + f->data_offset;
+    uint8_t digests[MERKLE_BATCH * SFS_CHECKSUM_SIZE];
+    int rc;
+
+    if (f->manifest == MANIFEST_NONE)
+        return readahead_read(ra, fs->dev, data, load_addr, f->load_size);
+    if (check_manifest(f))
+        return 1;
+
+    for (unsigned first = 0; first < f->n_chunks; first += MERKLE_BATCH) {
+        unsigned n = f->n_chunks - first < MERKLE_BATCH ?
+                        f->n_chunks - first : MERKLE_BATCH;
+        uint32_t off = first * f->chunk_size;
+        uint32_t len = (n - 1) * f->chunk_size + chunk_len(f, first + n - 1);
+        unsigned i = 0;
+
+        rc = read_bytes(fs, chunk_digest(f, first), digests,
+                        n * SFS_CHECKSUM_SIZE);
+        if (rc)
+            return rc;
+        rc = readahead_start(ra, fs->dev, data + off, load_addr + off, len);
+        while (!rc && i < n) {
+            rc = readahead_next(ra);
+            for (; !rc && i < n &&
+                   i * f->chunk_size + chunk_len(f, first + i) <= ra->done;
+                 ++i) {
+                rc = verify_chunk(f, first + i,
+                                  &digests[i * SFS_CHECKSUM_SIZE]);
+                if (rc)
+                    printf("SFS: ERROR: %s: chunk %u corrupted\r\n",
+                           f->fd.name, first + i);
+            }
+        }
+        if (rc) {
+            readahead_cancel(ra);
+            return rc;
+        }
+    }
+    return 0;
+}
+
+static struct sfs *mount(uint8_t *base, struct blkdev *dev, uint32_t offset,
+                         struct dma *dmac)
 {
     struct sfs *fs;
+    global_table gt;
+
     fs = OBJECT_ALLOC(sfss);
+    if (!fs)
+        return NULL;
     fs->base = base;
+    fs->dev = dev;
+    fs->dev_offset = offset;
     fs->dmac = dmac;
-    DPRINTF("SFS: mounting at 0x%x\r\n", fs->base);
-    // could load the file table here
+
+    if (read_bytes(fs, 0, &gt, sizeof(gt)) ||
+        check_ecc("global table", (uint8_t *)&gt,
+                  offsetof(global_table, ecc), gt.ecc))
+        goto fail;
+    DPRINTF("SFS: #files : %u, low_mark_data(0x%lx), high_mark_fd(0x%x)\r\n",
+           gt.n_files, gt.low_mark_data, gt.high_mark_fd);
+    if (gt.n_files > MAX_FILES) {
+        printf("SFS: ERROR: too many files: %u > %u\r\n",
+               gt.n_files, MAX_FILES);
+        goto fail;
+    }
+    index_files(fs, gt.n_files);
+    return fs;
+fail:
+    OBJECT_FREE(fs);
+    return NULL;
+}
+
+struct sfs *sfs_mount(uint8_t *base, struct dma *dmac)
+{
+    DPRINTF("SFS: mounting at 0x%x\r\n", base);
+    struct sfs *fs = mount(base, NULL, 0, dmac);
+    if (fs)
+        printf("SFS: mounted at %p: %u files\r\n", fs->base, fs->n_files);
+    return fs;
+}
+
+struct sfs *sfs_mount_blk(struct blkdev *dev, uint32_t offset)
+{
+    ASSERT(dev);
+    DPRINTF("SFS: mounting on %s at 0x%x\r\n", dev->name, offset);
+    struct sfs *fs = mount(NULL, dev, offset, NULL);
+    if (fs)
+        printf("SFS: mounted on %s at 0x%x: %u files\r\n",
+               dev->name, offset, fs->n_files);
     return fs;
 }
 
 void sfs_unmount(struct sfs *fs)
 {
     ASSERT(fs);
-    fs->base = 0;
-    fs->dmac = NULL;
     OBJECT_FREE(fs);
 }
 
-int sfs_load(struct sfs *fs, const char *fname,
-               uint32_t **addr, uint32_t **ep)
+struct sfs_file *sfs_open(struct sfs *fs, const char *fname)
 {
-    global_table gt;
-    unsigned i;
-    uint32_t * load_addr_32;
-    uint32_t * mem_addr_32;
-    file_descriptor * fd_buf;
-    unsigned char * mem_start_addr = (unsigned char *)fs->base;
-    unsigned char * ptr = (unsigned char *) &gt;
-    int rc;
-
-    for(i = 0; i < sizeof(global_table); i++) {
-        ptr[i] = * (mem_start_addr + i);
+    ASSERT(fs);
+    uint32_t hash = sfs_name_hash(fname);
+    int i = fs->buckets[hash & (HASH_BUCKETS - 1)];
+    while (i != NO_FILE) {
+        struct sfs_file *f = &fs->files[i];
+        if (f->hash == hash && !strcmp(f->fd.name, fname))
+            return f;
+        i = f->next;
     }
-    DPRINTF("SFS: #files : %u, low_mark_data(0x%lx), high_mark_fd(0x%x)\r\n",
-           gt.n_files, gt.low_mark_data, gt.high_mark_fd);
+    DPRINTF("SFS: ERROR: file not found: %s\r\n", fname);
+    return NULL;
+}
 
-    for (i = 0; i < gt.n_files ; i++) {
-        fd_buf = (file_descriptor *)(mem_start_addr + sizeof(gt) + sizeof(file_descriptor)*i);
-        if (!fd_buf->valid)
-            continue;
-        if (!strcmp(fd_buf->name, fname))
-            break;
+struct sfs_file *sfs_open_hash(struct sfs *fs, uint32_t hash)
+{
+    ASSERT(fs);
+    struct sfs_file *found = NULL;
+    int i = fs->buckets[hash & (HASH_BUCKETS - 1)];
+    while (i != NO_FILE) {
+        struct sfs_file *f = &fs->files[i];
+        if (f->hash == hash) {
+            if (found) {
+                printf("SFS: ERROR: name hash %08x is ambiguous: %s, %s\r\n",
+                       hash, found->fd.name, f->fd.name);
+                return NULL;
+            }
+            found = f;
+        }
+        i = f->next;
     }
-    if (i == gt.n_files) {
-        DPRINTF("SFS: ERROR: file not found: %s\r\n", fname);
-        return 1;
+    if (!found) {
+        DPRINTF("SFS: ERROR: file not found: #%08x\r\n", hash);
     }
+    return found;
+}
 
-    uint32_t offset = fd_buf->offset;
+const char *sfs_name(struct sfs_file *f)
+{
+    ASSERT(f);
+    return f->fd.name;
+}
+
+int sfs_stat(struct sfs_file *f, struct sfs_stat *st)
+{
+    ASSERT(f);
+    ASSERT(st);
+    st->size = f->load_size;
+    st->load_addr = f->fd.load_addr;
+    st->load_addr_high = f->fd.load_addr_high;
+    st->entry_offset = f->fd.entry_offset;
+    st->chunk_size = f->chunk_size;
+    st->n_chunks = f->manifest != MANIFEST_NONE ? f->n_chunks : 0;
+    for (unsigned i = 0; i < SFS_CHECKSUM_SIZE; ++i)
+        st->chcksum[i] = f->fd.chcksum[i];
+    return 0;
+}
+
+int sfs_read(struct sfs_file *f, uint32_t **addr, uint32_t **ep)
+{
+    ASSERT(f);
+    struct sfs *fs = f->fs;
+    file_descriptor *fd = &f->fd;
+    int rc;
 
     DPRINTF("SFS: loading file #%u: %s: 0x%0x -> 0x%x (%u KB)\r\n",
-           i, fd_buf->name, mem_start_addr + offset,
-           fd_buf->load_addr, fd_buf->size / 1024);
+           f - fs->files, fd->name, fs->base + fd->offset,
+           fd->load_addr, fd->size / 1024);
 
-    mem_addr_32 = (uint32_t *) (mem_start_addr + offset);
-    load_addr_32 = (uint32_t *)fd_buf->load_addr;
+    uint32_t *mem_addr_32 = (uint32_t *)(fs->base + fd->offset + f->data_offset);
+    uint32_t *load_addr_32 = (uint32_t *)fd->load_addr;
 
-    if (fs->dmac)
-        rc = load_dma(mem_addr_32, load_addr_32, fd_buf->size, fs->dmac);
+    if (fs->dev)
+        rc = load_blk(f, (uint8_t *)load_addr_32);
+    else if (fd->valid & SFS_FD_LZ4)
+        rc = load_lz4(mem_addr_32, load_addr_32, fd->size, f->load_size);
+    else if (f->manifest != MANIFEST_NONE)
+        rc = load_merkle(f, mem_addr_32, load_addr_32);
+    else if (fs->dmac)
+        rc = load_dma(mem_addr_32, load_addr_32, fd->size, fs->dmac);
     else
-        rc = load_memcpy(mem_addr_32, load_addr_32, fd_buf->size);
+        rc = load_memcpy(mem_addr_32, load_addr_32, fd->size);
 
     if (addr)
         *addr = load_addr_32;
     if (ep)
-        *ep = (uint32_t *)(fd_buf->load_addr + fd_buf->entry_offset);
+        *ep = (uint32_t *)(fd->load_addr + fd->entry_offset);
     return rc;
 }
+
+int sfs_read_async(struct sfs_file *f, unsigned chan, sfs_cb_t cb, void *arg)
+{
+    ASSERT(f);
+    ASSERT(cb);
+    struct sfs *fs = f->fs;
+    file_descriptor *fd = &f->fd;
+    int rc;
+
+    DPRINTF("SFS: loading file #%u: %s: 0x%0x -> 0x%x (%u KB) on chan %u\r\n",
+           f - fs->files, fd->name, fs->base + fd->offset,
+           fd->load_addr, fd->size / 1024, chan);
+
+    uint32_t *mem_addr_32 = (uint32_t *)(fs->base + fd->offset + f->data_offset);
+    uint32_t *load_addr_32 = (uint32_t *)fd->load_addr;
+
+    if (fs->dev) { // the device driver does the DMA, block by block
+        rc = load_blk(f, (uint8_t *)load_addr_32);
+        cb(arg, rc);
+        return 0;
+    }
+    if (fd->valid & SFS_FD_LZ4) { // decompressed by the CPU, not DMA
+        rc = load_lz4(mem_addr_32, load_addr_32, fd->size, f->load_size);
+        cb(arg, rc);
+        return 0;
+    }
+    if (!fs->dmac) {
+        if (f->manifest != MANIFEST_NONE)
+            rc = load_merkle(f, mem_addr_32, load_addr_32);
+        else
+            rc = load_memcpy(mem_addr_32, load_addr_32, f->load_size);
+        cb(arg, rc);
+        return 0;
+    }
+
+    // Not verified here even with a manifest: hashing the file in @cb's work
+    // would hold up the other work, so the caller checks it (see sfs.h)
+    struct dma_tx *dtx = dma_transfer(fs->dmac, chan,
+        mem_addr_32, load_addr_32, ALIGN(f->load_size, DMA_MAX_BURST_BITS),
+        cb, arg);
+    if (!dtx) {
+        printf("SFS: ERROR: failed to start DMA transfer: %s\r\n", fd->name);
+        return 1;
+    }
+    return 0;
+}
+
+int sfs_load(struct sfs *fs, const char *fname,
+               uint32_t **addr, uint32_t **ep)
+{
+    struct sfs_file *f = sfs_open(fs, fname);
+    if (!f)
+        return 1;
+    return sfs_read(f, addr, ep);
+}
+
+int sfs_verify_chunk(struct sfs_file *f, unsigned chunk)
+{
+    ASSERT(f);
+    ASSERT(chunk < f->n_chunks);
+    uint8_t expected[SFS_CHECKSUM_SIZE];
+
+    if (check_manifest(f) ||
+        read_bytes(f->fs, chunk_digest(f, chunk), expected, sizeof(expected)))
+        return 1;
+    return verify_chunk(f, chunk, expected);
+}
+
+int sfs_read_chunk(struct sfs_file *f, unsigned chunk)
+{
+    ASSERT(f);
+    ASSERT(chunk < f->n_chunks);
+    unsigned off = chunk * f->chunk_size;
+    if (f->fs->dev)
+        return read_bytes(f->fs, f->fd.offset + f->data_offset + off,
+                          (uint8_t *)f->fd.load_addr + off, chunk_len(f, chunk));
+    return load_memcpy((uint32_t *)(f->fs->base + f->fd.offset +
+                                    f->data_offset + off),
+                       (uint32_t *)(f->fd.load_addr + off), chunk_len(f, chunk));
+}
@@ -1,14 +1,96 @@
+#ifndef SFS_H
+#define SFS_H
+
 #include <stdint.h>
 
+#define SFS_CHECKSUM_SIZE 32 /* SHA-256 */
+
+struct blkdev;
 struct dma;
+struct sfs;
+struct sfs_file;
+
+typedef void (*sfs_cb_t)(void *arg, int rc);
 
+struct sfs_stat {
+    uint32_t size;
+    uint32_t load_addr;
+    uint32_t load_addr_high;
+    uint32_t entry_offset;
+    uint32_t chunk_size; /* of hash-tree manifest */
+    uint32_t n_chunks; /* 0 if the file has no manifest */
+    uint8_t chcksum[SFS_CHECKSUM_SIZE]; /* manifest root, if n_chunks > 0 */
+};
+
+/* sfs_mount: parse and validate (ECC) the file table and build name index
+ *
+ * The file table is read from storage only once, here. Descriptors that fail
+ * the ECC check are not indexed (i.e. can't be opened).
+ */
 struct sfs *sfs_mount(uint8_t *base, struct dma *dmac);
+
+/* sfs_mount_blk: same, for a file system on a block device (e.g. NAND)
+ *
+ * @offset: of the file system on the device, in bytes
+ *
+ * Files are loaded by streaming blocks from the device (see readahead.h);
+ * compressed (LZ4) files are not supported.
+ */
+struct sfs *sfs_mount_blk(struct blkdev *dev, uint32_t offset);
 void sfs_unmount(struct sfs *fs);
 
-/* sfs_load: load a blob from file system into memory
+/* sfs_open: look up a file by name in the index built at mount time
+ *
+ * Returns a handle valid until the file system is unmounted, or NULL if
+ * the file does not exist. Does not access storage.
+ */
+struct sfs_file *sfs_open(struct sfs *fs, const char *fname);
+
+/* sfs_open_hash: look up a file by the hash of its name (see sfs_name_hash)
+ *
+ * For callers that have the hash precomputed, e.g. from a config record.
+ * Returns NULL if no file has this hash, or if more than one does.
+ */
+struct sfs_file *sfs_open_hash(struct sfs *fs, uint32_t hash);
+uint32_t sfs_name_hash(const char *name);
+const char *sfs_name(struct sfs_file *f);
+int sfs_stat(struct sfs_file *f, struct sfs_stat *st);
+
+/* sfs_read: load an opened file from storage to its load address
+ *
+ * Files with a hash-tree manifest are verified chunk by chunk as they land,
+ * and loading stops at the first corrupted chunk.
  *
  * @addr: if not null, will be set to the load addr found in the image
  * @ep: if not null, will be set to address of entry point found in the image
 */
+int sfs_read(struct sfs_file *f, uint32_t **addr, uint32_t **ep);
+
+/* sfs_read_async: start loading an opened file, without waiting for it
+ *
+ * The transfer is issued on the given DMA channel and @cb is called (as
+ * deferred work, see work.h) when it completes. The caller owns the channel
+ * until then. The whole file is one transfer, so a file with a manifest is
+ * not verified: the caller must check it with sfs_verify_chunk after @cb.
+ * Without a DMA controller, or on a block device, the file is copied (and
+ * verified, as by sfs_read) synchronously, and @cb is called before this
+ * function returns.
+ */
+int sfs_read_async(struct sfs_file *f, unsigned chan, sfs_cb_t cb, void *arg);
+
+/* sfs_verify_chunk: check one chunk of a loaded file against its manifest
+ *
+ * For files with a manifest only (see sfs_stat). Reads the loaded copy at
+ * the load address, so can be called for any subset of chunks, e.g. to check
+ * a resident copy, or to split the work. Returns 0 if the chunk is intact.
+ */
+int sfs_verify_chunk(struct sfs_file *f, unsigned chunk);
+
+/* sfs_read_chunk: load one chunk of a file with a manifest (by the CPU) */
+int sfs_read_chunk(struct sfs_file *f, unsigned chunk);
+
+/* sfs_load: load a blob from file system into memory (open + read) */
 int sfs_load(struct sfs *fs, const char *fname,
                uint32_t **addr, uint32_t **ep);
+
+#endif // SFS_H
@@ -44,6 +44,20 @@ do {                                                    \
 } while( 0 )
 #endif
 
+/*
+ * Word load of big-endian data from a word-aligned address: a single LDR
+ * followed by REV on the (little-endian) Cortex-M4 and Cortex-R52.
+ */
+typedef uint32_t __attribute__((may_alias)) word_t; /* aliases bytes */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LOAD_UINT32_BE(b,i) __builtin_bswap32( *(const word_t *) &(b)[(i)] )
+#else
+#define LOAD_UINT32_BE(b,i) ( *(const word_t *) &(b)[(i)] )
+#endif
+
+#define IS_WORD_ALIGNED(p) ( ( (uintptr_t) (p) & 0x3 ) == 0 )
+
 #ifndef PUT_UINT32_BE
 #define PUT_UINT32_BE(n,b,i)                            \
 do {                                                    \
@@ -63,10 +77,15 @@ static void l_memset( void *dest, int c, size_t size ) {
 }
 
 static void l_memcpy( void *dest, const void *input, size_t size ) {
-    int i;
+    size_t i = 0;
     unsigned char *ptr = ( unsigned char * )dest;
     unsigned char *iptr = ( unsigned char * )input;
-    for ( i = 0; i < size ; i++ ) {
+    if ( IS_WORD_ALIGNED( ptr ) && IS_WORD_ALIGNED( iptr ) ) {
+        for ( ; i + 4 <= size; i += 4 ) {
+            *( word_t * )&ptr[i] = *( const word_t * )&iptr[i];
+        }
+    }
+    for ( ; i < size ; i++ ) {
         ptr[i] = iptr[i];
     }
 
@@ -192,6 +211,7 @@ static const uint32_t K[] =
 }
 
 
+#if defined(MBEDTLS_SHA256_SMALLER)
 int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
                                 const unsigned char data[64] )
 {
@@ -202,7 +222,6 @@ int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
     for( i = 0; i < 8; i++ )
         A[i] = ctx->state[i];
 
-#if defined(MBEDTLS_SHA256_SMALLER)
     for( i = 0; i < 64; i++ )
     {
         if( i < 16 )
@@ -215,40 +234,100 @@ int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
         temp1 = A[7]; A[7] = A[6]; A[6] = A[5]; A[5] = A[4]; A[4] = A[3];
         A[3] = A[2]; A[2] = A[1]; A[1] = A[0]; A[0] = temp1;
     }
+
+    for( i = 0; i < 8; i++ )
+        ctx->state[i] += A[i];
+
+    return( 0 );
+}
 #else /* MBEDTLS_SHA256_SMALLER */
-    for( i = 0; i < 16; i++ )
-        GET_UINT32_BE( W[i], data, 4 * i );
+/*
+ * Fully unrolled: the working variables stay in registers (no array, no
+ * rotation) and the message schedule is kept in a 16-word circular buffer,
+ * with every index a compile-time constant.
+ */
+#define WC(t) W[(t) & 15]
+
+#define RC(t)                                           \
+(                                                       \
+    WC(t) += S1(WC((t) -  2)) + WC((t) -  7) +          \
+             S0(WC((t) - 15))                           \
+)
+
+#define P8(i,X)                                                 \
+{                                                               \
+    P( a, b, c, d, e, f, g, h, X((i)+0), K[(i)+0] );            \
+    P( h, a, b, c, d, e, f, g, X((i)+1), K[(i)+1] );            \
+    P( g, h, a, b, c, d, e, f, X((i)+2), K[(i)+2] );            \
+    P( f, g, h, a, b, c, d, e, X((i)+3), K[(i)+3] );            \
+    P( e, f, g, h, a, b, c, d, X((i)+4), K[(i)+4] );            \
+    P( d, e, f, g, h, a, b, c, X((i)+5), K[(i)+5] );            \
+    P( c, d, e, f, g, h, a, b, X((i)+6), K[(i)+6] );            \
+    P( b, c, d, e, f, g, h, a, X((i)+7), K[(i)+7] );            \
+}
+
+int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
+                                const unsigned char data[64] )
+{
+    uint32_t temp1, temp2, W[16];
+    uint32_t a, b, c, d, e, f, g, h;
+    unsigned int i;
 
-    for( i = 0; i < 16; i += 8 )
+    if( IS_WORD_ALIGNED( data ) )
     {
-        P( A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[i+0], K[i+0] );
-        P( A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[i+1], K[i+1] );
-        P( A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[i+2], K[i+2] );
-        P( A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[i+3], K[i+3] );
-        P( A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[i+4], K[i+4] );
-        P( A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[i+5], K[i+5] );
-        P( A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[i+6], K[i+6] );
-        P( A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[i+7], K[i+7] );
+        W[ 0] = LOAD_UINT32_BE( data,  0 );
+        W[ 1] = LOAD_UINT32_BE( data,  4 );
+        W[ 2] = LOAD_UINT32_BE( data,  8 );
+        W[ 3] = LOAD_UINT32_BE( data, 12 );
+        W[ 4] = LOAD_UINT32_BE( data, 16 );
+        W[ 5] = LOAD_UINT32_BE( data, 20 );
+        W[ 6] = LOAD_UINT32_BE( data, 24 );
+        W[ 7] = LOAD_UINT32_BE( data, 28 );
+        W[ 8] = LOAD_UINT32_BE( data, 32 );
+        W[ 9] = LOAD_UINT32_BE( data, 36 );
+        W[10] = LOAD_UINT32_BE( data, 40 );
+        W[11] = LOAD_UINT32_BE( data, 44 );
+        W[12] = LOAD_UINT32_BE( data, 48 );
+        W[13] = LOAD_UINT32_BE( data, 52 );
+        W[14] = LOAD_UINT32_BE( data, 56 );
+        W[15] = LOAD_UINT32_BE( data, 60 );
     }
-
-    for( i = 16; i < 64; i += 8 )
+    else
     {
-        P( A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], R(i+0), K[i+0] );
-        P( A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], R(i+1), K[i+1] );
-        P( A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], R(i+2), K[i+2] );
-        P( A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], R(i+3), K[i+3] );
-        P( A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], R(i+4), K[i+4] );
-        P( A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], R(i+5), K[i+5] );
-        P( A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], R(i+6), K[i+6] );
-        P( A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], R(i+7), K[i+7] );
+        for( i = 0; i < 16; i++ )
+            GET_UINT32_BE( W[i], data, 4 * i );
     }
-#endif /* MBEDTLS_SHA256_SMALLER */
 
-    for( i = 0; i < 8; i++ )
-        ctx->state[i] += A[i];
+    a = ctx->state[0];
+    b = ctx->state[1];
+    c = ctx->state[2];
+    d = ctx->state[3];
+    e = ctx->state[4];
+    f = ctx->state[5];
+    g = ctx->state[6];
+    h = ctx->state[7];
+
+    P8(  0, WC );
+    P8(  8, WC );
+    P8( 16, RC );
+    P8( 24, RC );
+    P8( 32, RC );
+    P8( 40, RC );
+    P8( 48, RC );
+    P8( 56, RC );
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
 
     return( 0 );
 }
+#endif /* MBEDTLS_SHA256_SMALLER */
 
 #if !defined(MBEDTLS_DEPRECATED_REMOVED)
 void mbedtls_sha256_process( mbedtls_sha256_context *ctx,
@@ -1,7 +1,18 @@
 #define DEBUG 0
 
+#include <stdbool.h>
+
 #include "console.h"
 #include "panic.h"
+#if CONFIG_TICKLESS || CONFIG_CLOCK
+#include "arm.h"
+#endif // CONFIG_TICKLESS || CONFIG_CLOCK
+#if CONFIG_CLOCK
+#include "clock.h"
+#endif // CONFIG_CLOCK
+#if CONFIG_TICKLESS
+#include "tickless.h"
+#endif // CONFIG_TICKLESS
 
 #include "sleep.h"
 
@@ -12,6 +23,8 @@ static volatile unsigned busyloop_factor = 0;
 #if CONFIG_SLEEP_TIMER
 static volatile unsigned time = 0; // cycles @ clk Hz
 static volatile unsigned clk = 0;
+static volatile unsigned wakeup; // valid while sleeping
+static volatile bool sleeping;
 #endif // CONFIG_SLEEP_TIMER
 
 void sleep_set_busyloop_factor(unsigned f)
@@ -33,34 +46,50 @@ void sleep_tick(unsigned delta_cycles)
     time += delta_cycles;
     DPRINTF("SLEEP: time += %u -> %u\r\n", delta_cycles, time);
 }
+
+unsigned sleep_until()
+{
+    if (!sleeping)
+        return ~0;
+    unsigned left = wakeup - time; // % MAX_TIME implicitly
+    return left <= MAX_TIME / 2 ? left : 0; // else, wakeup has passed
+}
+
 void msleep(unsigned ms)
 {
     ASSERT(clk && "sleep clk not set");
 
     unsigned c = ms * (clk / 1000); // msec to cycles
 
-    unsigned wakeup = time + c; // % MAX_TIME implicitly
+    wakeup = time + c; // % MAX_TIME implicitly
+    sleeping = true;
     DPRINTF("time %u, wakeup %u\r\n", time, wakeup);
     int remaining = wakeup >= time ? wakeup - time : (MAX_TIME - time) + wakeup;
     unsigned last_tick = time;
     while (remaining > 0) {
 	DPRINTF("SLEEP: sleeping for %u cycles...\r\n", remaining);
+#if CONFIG_TICKLESS
+        int_disable(); // the timer must be set for the wakeup before WFI
+        tickless_update();
+        asm("wfi"); // ignores PRIMASK set by int_disable
+        int_enable();
+#else // !CONFIG_TICKLESS
         asm("wfi"); // TODO: change to WFE and add SEV to sleep_tick
+#endif // !CONFIG_TICKLESS
 
 	unsigned elapsed = time >= last_tick ? time - last_tick : (MAX_TIME - last_tick) + time;
         last_tick = time;
         remaining -= elapsed;
     }
+    sleeping = false;
     DPRINTF("SLEEP: awake\r\n");
 }
 #endif // CONFIG_SLEEP_TIMER
 
-void mdelay(unsigned ms)
+// Not inlined, so that the loop (and its label) exists once and takes the
+// same time for every caller, which is what the calibration measures.
+static void __attribute__((noinline)) busyloop(unsigned iters)
 {
-    // WARNING: don't add any printf statements into this functions, they
-    // interfere with the timing, despite being outside of the busyloop itself.
-    unsigned iters = ms * busyloop_factor;
-
     if (iters == 0)
         return;
 
@@ -68,11 +97,69 @@ void mdelay(unsigned ms)
     // compiler optimizations. This asm is portable across armv7 and
     // aarch32, but won't necessary take the same time, so each CPU will
     // need its own calibration factor anyway (see above).
-    asm (
-     "delayloop:\n"
+    asm volatile (
+     "1:\n"
      "  nop\n"
      "  sub %0, #1\n"
      "  cmp %0, #0\n"
-     "  bne delayloop\n"
-     : : "r" (iters) :);
+     "  bne 1b\n"
+     : "+r" (iters) : : "cc");
+}
+
+void mdelay(unsigned ms)
+{
+    // WARNING: don't add any printf statements into this functions, they
+    // interfere with the timing, despite being outside of the busyloop itself.
+    busyloop(ms * busyloop_factor);
+}
+
+unsigned sleep_get_busyloop_factor()
+{
+    return busyloop_factor;
+}
+
+#if CONFIG_CLOCK
+// Time the loop for long enough that the overhead of the call and of reading
+// the clock is negligible; keep the fastest run of a few, since interrupts
+// and cache misses only ever make it slower.
+#define CALIB_MIN_US    10000
+#define CALIB_RUNS      3
+
+// in us
+static uint32_t time_busyloop(unsigned iters)
+{
+    uint32_t ticks_per_us = (uint32_t)clock_us(1);
+    int_disable();
+    uint64_t start = clock_now();
+    busyloop(iters);
+    uint64_t ticks = clock_now() - start;
+    int_enable();
+    if (ticks >> 32) // minutes: can only be a broken clock
+        panic("SLEEP: busyloop calibration: clock overflow");
+    return (uint32_t)ticks / ticks_per_us;
+}
+
+unsigned sleep_calibrate_busyloop()
+{
+    unsigned iters = 1024;
+    uint32_t us;
+
+    ASSERT(clock_initialized() && "clock not initialized");
+    while ((us = time_busyloop(iters)) < CALIB_MIN_US) {
+        iters <<= 1;
+        if (!iters)
+            panic("SLEEP: busyloop calibration: clock not running");
+    }
+    for (unsigned run = 1; run < CALIB_RUNS; ++run) {
+        uint32_t t = time_busyloop(iters);
+        if (t < us)
+            us = t;
+    }
+
+    // iters per ms, in 32-bit parts since there is no 64-bit division
+    unsigned factor = iters / us * 1000 + (iters % us) * 1000 / us;
+    printf("SLEEP: busyloop calibration: %u iters in %u us\r\n", iters, us);
+    sleep_set_busyloop_factor(factor);
+    return factor;
 }
+#endif // CONFIG_CLOCK
@@ -3,6 +3,12 @@
 
 void mdelay(unsigned ms); // busyloop
 void sleep_set_busyloop_factor(unsigned f);
+unsigned sleep_get_busyloop_factor();
+
+#if CONFIG_CLOCK
+// Measure the busyloop against the clock (see clock.h), and set the factor
+unsigned sleep_calibrate_busyloop();
+#endif // CONFIG_CLOCK
 
 #if CONFIG_SLEEP_TIMER
 void sleep_set_clock(unsigned t);
@@ -10,6 +16,9 @@ void msleep(unsigned ms);
 
 // Call this from a timer ISR
 void sleep_tick(unsigned delta);
+
+// Cycles until msleep wakes up, or ~0 if not sleeping (see tickless.h)
+unsigned sleep_until();
 #else // !CONFIG_SLEEP_TIMER
 #define msleep(t) mdelay(t)
 #endif // !CONFIG_SLEEP_TIMER
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "console.h"
 #include "list.h"
@@ -11,12 +12,167 @@
 
 #include "swtimer.h"
 
+/* Hierarchical timing wheel: each level has WHEEL_SLOTS slots, and a slot at
+ * level L spans WHEEL_SLOTS^L wheel ticks. A timer goes into the lowest
+ * level whose span covers its distance from now; whenever level 0 wraps
+ * around, the slot for the coming window at the next level up is cascaded,
+ * i.e. its timers are re-inserted, so that they land in level 0 by the time
+ * they are due. Insert and cancel are O(1), and running the wheel touches
+ * only the timers that expire (plus the cascaded ones, each at most once per
+ * level); empty slots are skipped with a bitmap per level.
+ *
+ * A wheel tick is a power of 2 cycles of the clock, of at most 1 ms.
+ * Deadlines are kept in 64-bit cycles, so they never wrap. Timers farther out
+ * than the whole wheel (hours at least) are parked in its farthest slot and
+ * re-inserted from there. */
+#define WHEEL_LEVELS        4
+#define WHEEL_SLOT_BITS     6
+#define WHEEL_SLOTS         (1 << WHEEL_SLOT_BITS)
+#define WHEEL_SLOT_MASK     (WHEEL_SLOTS - 1)
+
 static uint32_t clk; /* Hz */
-static uint32_t time; /* cycles @ clk Hz */
+static volatile uint64_t time; /* cycles @ clk Hz */
+
+static unsigned tick_shift; /* cycles per wheel tick = 1 << tick_shift */
+static uint64_t wheel_now; /* wheel ticks before this one have been run */
+static struct lnode wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint32_t occupied[WHEEL_LEVELS][WHEEL_SLOTS / 32]; /* bitmaps */
+static unsigned num_pending;
+
+/* x >> s for s < 32, without the 64-bit shift helpers from libgcc */
+static uint64_t shr64(uint64_t x, unsigned s)
+{
+    uint32_t lo = (uint32_t)x;
+    uint32_t hi = (uint32_t)(x >> 32);
+    if (!s)
+        return x;
+    return ((uint64_t)(hi >> s) << 32) | (lo >> s) | (hi << (32 - s));
+}
+
+/* x << s for s < 32 */
+static uint64_t shl64(uint64_t x, unsigned s)
+{
+    uint32_t lo = (uint32_t)x;
+    uint32_t hi = (uint32_t)(x >> 32);
+    if (!s)
+        return x;
+    return ((uint64_t)((hi << s) | (lo >> (32 - s))) << 32) | (lo << s);
+}
 
-/* Sorted by next event time */
-/* for efficiency, could be a min-heap; for simplicity: sorted linked list */
-static struct lnode timers;
+/* Updated by the tick ISR: read until two reads agree, so as not to tear */
+static uint64_t now()
+{
+    uint64_t t;
+    do {
+        t = time;
+    } while (t != time);
+    return t;
+}
+
+/* Wheel tick in which a timer fires: rounded up, so that it never fires
+ * before its deadline */
+static uint64_t timer_tick(struct sw_timer *tmr)
+{
+    return shr64(tmr->deadline + (1 << tick_shift) - 1, tick_shift);
+}
+
+static void wheel_insert(struct sw_timer *tmr)
+{
+    uint64_t t = timer_tick(tmr);
+    uint32_t span = WHEEL_SLOTS;
+    unsigned level = 0;
+
+    if (t < wheel_now)
+        t = wheel_now;
+    while (level < WHEEL_LEVELS - 1 && t - wheel_now >= span) {
+        level++;
+        span <<= WHEEL_SLOT_BITS;
+    }
+    if (t - wheel_now >= span)
+        t = wheel_now + span - 1;
+
+    tmr->level = level;
+    tmr->slot = (uint32_t)shr64(t, level * WHEEL_SLOT_BITS) & WHEEL_SLOT_MASK;
+    list_insert(&tmr->node, &wheel[level][tmr->slot]);
+    occupied[level][tmr->slot / 32] |= 1 << (tmr->slot % 32);
+    tmr->pending = true;
+    num_pending++;
+}
+
+/* Move the timers in a slot onto a list of their own, which stays valid if
+ * a callback cancels any of them */
+static void wheel_detach(unsigned level, unsigned slot, struct lnode *list)
+{
+    struct lnode *head = &wheel[level][slot];
+    list->prev = NULL;
+    list->next = head->next;
+    if (list->next)
+        list->next->prev = list;
+    head->next = NULL;
+    occupied[level][slot / 32] &= ~(1 << (slot % 32));
+}
+
+static struct sw_timer *list_pop(struct lnode *list)
+{
+    struct lnode *node = list->next;
+    if (!node)
+        return NULL;
+    list_remove(node);
+    struct sw_timer *tmr = container_of(struct sw_timer, node, node);
+    tmr->pending = false;
+    num_pending--;
+    return tmr;
+}
+
+/* At the start of a level 0 window: pull down the timers due within it */
+static void wheel_cascade()
+{
+    for (unsigned level = 1; level < WHEEL_LEVELS; ++level) {
+        unsigned slot = (uint32_t)shr64(wheel_now, level * WHEEL_SLOT_BITS) &
+                            WHEEL_SLOT_MASK;
+        struct lnode list;
+        struct sw_timer *tmr;
+        wheel_detach(level, slot, &list);
+        while ((tmr = list_pop(&list)))
+            wheel_insert(tmr);
+        if (slot) // the level above wraps only when this one does
+            break;
+    }
+}
+
+/* First occupied slot in [from, to] at a level, or -1 */
+static int wheel_next_slot(unsigned level, unsigned from, unsigned to)
+{
+    for (unsigned w = from / 32; w <= to / 32; ++w) {
+        uint32_t bits = occupied[level][w];
+        if (w == from / 32)
+            bits &= ~0u << (from % 32);
+        if (w == to / 32 && to % 32 != 31)
+            bits &= (1u << (to % 32 + 1)) - 1;
+        if (bits)
+            return w * 32 + __builtin_ctz(bits);
+    }
+    return -1;
+}
+
+static void wheel_expire(unsigned slot, uint64_t t_now)
+{
+    struct lnode list;
+    struct sw_timer *tmr;
+
+    wheel_detach(0, slot, &list);
+    wheel_now++; // timers rescheduled by callbacks go after this tick
+    while ((tmr = list_pop(&list))) {
+        DPRINTF("SW TMR: expired @%p\r\n", tmr);
+        if (tmr->periodic) { // before the callback, so that it may cancel
+            tmr->deadline += tmr->interval;
+            if (tmr->deadline <= t_now) // fell behind: skip missed periods
+                tmr->deadline = t_now + tmr->interval;
+            wheel_insert(tmr);
+        }
+        tmr->cb(tmr->arg);
+    }
+}
 
 void sw_timer_schedule(struct sw_timer *tmr, uint32_t interval_ms,
                        enum sw_timer_type type, sw_timer_cb_t *cb, void *arg)
@@ -24,49 +180,122 @@ void sw_timer_schedule(struct sw_timer *tmr, uint32_t interval_ms,
     ASSERT(tmr);
     ASSERT(cb);
 
+    if (tmr->pending)
+        sw_timer_cancel(tmr);
     tmr->cb = cb;
     tmr->arg = arg;
     tmr->periodic = (type == SW_TIMER_PERIODIC);
-    tmr->interval = interval_ms * (clk / 1000);
-    tmr->next = time + tmr->interval;
-    printf("SW TMR: sched @%p interval %u periodic %u: next %u\r\n",
-           tmr, tmr->interval, tmr->periodic, tmr->next);
-    list_insert(&tmr->node, &timers);
+    tmr->interval = (uint64_t)interval_ms * (clk / 1000);
+    tmr->deadline = now() + tmr->interval;
+    wheel_insert(tmr);
+    DPRINTF("SW TMR: sched @%p interval %u periodic %u: level %u slot %u\r\n",
+            tmr, (uint32_t)tmr->interval, tmr->periodic, tmr->level, tmr->slot);
 }
 
 void sw_timer_cancel(struct sw_timer *tmr)
 {
-    printf("SW TMR: cancel @%p\r\n", tmr);
+    ASSERT(tmr);
+    DPRINTF("SW TMR: cancel @%p\r\n", tmr);
+    if (!tmr->pending)
+        return;
     list_remove(&tmr->node);
+    tmr->pending = false;
+    num_pending--;
+    if (!wheel[tmr->level][tmr->slot].next)
+        occupied[tmr->level][tmr->slot / 32] &= ~(1 << (tmr->slot % 32));
 }
 
 void sw_timer_init(uint32_t freq)
 {
     printf("SW TMR: init clk freq %u\r\n", freq);
-    bzero(&timers, sizeof(timers));
+    bzero(wheel, sizeof(wheel));
+    bzero(occupied, sizeof(occupied));
+    num_pending = 0;
     clk = freq;
     time = 0;
+    wheel_now = 0;
+    tick_shift = 0;
+    while ((2u << tick_shift) <= freq / 1000)
+        tick_shift++;
 }
 
 void sw_timer_tick(uint32_t delta_cycles)
 {
     time += delta_cycles;
-    DPRINTF("SW TMR: tick: time += %u -> %u\r\n", delta_cycles, time);
+    DPRINTF("SW TMR: tick: time += %u -> %u\r\n", delta_cycles, (uint32_t)time);
 }
 
 void sw_timer_run()
 {
-    struct lnode *node = &timers;
-    while ((node = node->next)) {
-        struct sw_timer *tmr = container_of(struct sw_timer, node, node);
-        ASSERT(tmr);
-        if (tmr->next <= time) {
-            DPRINTF("SW TMR: expired @%p\r\n", tmr);
-            tmr->cb(tmr->arg);
-            if (tmr->periodic)
-                tmr->next = time + tmr->interval;
-            else
-                sw_timer_cancel(tmr);
+    uint64_t t_now = now();
+    uint64_t target = shr64(t_now, tick_shift); // run ticks up to this one
+
+    while (wheel_now <= target) {
+        if (!num_pending) {
+            wheel_now = target + 1;
+            break;
+        }
+        unsigned idx = (uint32_t)wheel_now & WHEEL_SLOT_MASK;
+        if (!idx)
+            wheel_cascade();
+        unsigned last = (wheel_now | WHEEL_SLOT_MASK) <= target ?
+                            WHEEL_SLOT_MASK : (uint32_t)target & WHEEL_SLOT_MASK;
+        int slot = wheel_next_slot(0, idx, last);
+        if (slot < 0) {
+            wheel_now += last - idx + 1;
+            continue;
         }
+        wheel_now += slot - idx;
+        wheel_expire(slot, t_now);
     }
 }
+
+/* First occupied slot at a level, in the order in which slots come due,
+ * starting from @from; or -1 */
+static int wheel_first_slot(unsigned level, unsigned from)
+{
+    int slot = wheel_next_slot(level, from, WHEEL_SLOT_MASK);
+    if (slot < 0 && from)
+        slot = wheel_next_slot(level, 0, from - 1);
+    return slot;
+}
+
+uint64_t sw_timer_until()
+{
+    uint64_t t = ~0ull; // earliest wheel tick that a timer fires in
+    unsigned idx = (uint32_t)wheel_now & WHEEL_SLOT_MASK;
+    int slot;
+
+    // timers in a level 0 slot all fire in the same tick
+    slot = wheel_first_slot(0, idx);
+    if (slot >= 0)
+        t = wheel_now + ((slot - idx) & WHEEL_SLOT_MASK);
+
+    // a slot at a higher level spans many ticks, but the first one that
+    // comes due holds the earliest timers at that level, except that the
+    // current slot may hold timers that are due (if not cascaded yet)
+    for (unsigned level = 1; level < WHEEL_LEVELS; ++level) {
+        unsigned cur = (uint32_t)shr64(wheel_now, level * WHEEL_SLOT_BITS) &
+                            WHEEL_SLOT_MASK;
+        int slots[2] = {
+            cur, wheel_first_slot(level, (cur + 1) & WHEEL_SLOT_MASK)
+        };
+        for (unsigned i = 0; i < 2; ++i) {
+            if (slots[i] < 0)
+                continue;
+            struct lnode *node = &wheel[level][slots[i]];
+            while ((node = node->next)) {
+                struct sw_timer *tmr = container_of(struct sw_timer, node, node);
+                uint64_t tt = timer_tick(tmr);
+                if (tt < t)
+                    t = tt;
+            }
+        }
+    }
+    if (t == ~0ull)
+        return ~0ull;
+
+    uint64_t deadline = shl64(t, tick_shift);
+    uint64_t t_now = now();
+    return deadline > t_now ? deadline - t_now : 0;
+}
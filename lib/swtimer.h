@@ -17,8 +17,11 @@ struct sw_timer {
     sw_timer_cb_t *cb;
     void *arg;
     bool periodic;
-    uint32_t interval; /* cycles @ clk */
-    uint32_t next;
+    bool pending; /* in the wheel */
+    uint8_t level; /* of the wheel, and slot within it, while pending */
+    uint8_t slot;
+    uint64_t interval; /* cycles @ clk */
+    uint64_t deadline; /* cycles @ clk, since sw_timer_init */
     struct lnode node;
 };
 
@@ -26,8 +29,13 @@ void sw_timer_init(uint32_t freq);
 void sw_timer_tick(uint32_t delta_cycles);
 void sw_timer_run(); /* call this periodically from main loop */
 
+/* Safe to call from timer callbacks, including on the timer being run */
 void sw_timer_schedule(struct sw_timer *tmr, uint32_t interval_ms,
                        enum sw_timer_type type, sw_timer_cb_t *cb, void *arg);
 void sw_timer_cancel(struct sw_timer *tmr);
 
+/* sw_timer_until: cycles from the current time to when the earliest pending
+ * timer will fire, 0 if it is due, or ~0 if no timer is pending */
+uint64_t sw_timer_until();
+
 #endif /* LIB_SWTIMER_H */
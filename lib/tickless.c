@@ -0,0 +1,49 @@
+#define DEBUG 0
+
+#include <stdint.h>
+
+#include "console.h"
+#include "panic.h"
+#include "sleep.h"
+#include "swtimer.h"
+
+#include "tickless.h"
+
+static tickless_retarget_t *retarget;
+static uint32_t min_interval; /* cycles */
+static uint32_t max_interval;
+
+static void advance(uint32_t cycles)
+{
+    sleep_tick(cycles);
+    sw_timer_tick(cycles);
+}
+
+void tickless_init(tickless_retarget_t *retarget_fn, uint32_t min, uint32_t max)
+{
+    printf("TICKLESS: interval %u..%u cycles\r\n", min, max);
+    retarget = retarget_fn;
+    min_interval = min;
+    max_interval = max;
+}
+
+void tickless_update()
+{
+    ASSERT(retarget);
+    uint64_t until = sw_timer_until();
+    uint32_t sleep = sleep_until();
+    if (sleep < until)
+        until = sleep;
+    if (until > max_interval)
+        until = max_interval;
+    uint32_t elapsed = retarget((uint32_t)until, min_interval);
+    DPRINTF("TICKLESS: next in %u cycles (%u elapsed)\r\n",
+            (uint32_t)until, elapsed);
+    advance(elapsed);
+}
+
+void tickless_tick(uint32_t expired)
+{
+    advance(expired);
+    tickless_update();
+}
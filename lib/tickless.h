@@ -0,0 +1,30 @@
+#ifndef TICKLESS_H
+#define TICKLESS_H
+
+#include <stdint.h>
+
+/* Tickless idle: instead of interrupting at a fixed interval, the tick timer
+ * is programmed for the earliest deadline of msleep and of the sw timers,
+ * bounded by a maximum interval (e.g. to kick a watchdog from the tick).
+ *
+ * Time is accounted in intervals: the sleep and sw timer clocks are always
+ * up to date as of the start of the current interval of the tick timer. */
+
+/* Reprogram the tick timer for its interrupt to come @until cycles after the
+ * start of the current interval, but no sooner than @min cycles from now.
+ * Returns the cycles elapsed since the start of the current interval, which
+ * are accounted by the caller; the new interval starts now. Called with
+ * interrupts disabled. */
+typedef uint32_t (tickless_retarget_t)(uint32_t until, uint32_t min);
+
+void tickless_init(tickless_retarget_t *retarget, uint32_t min, uint32_t max);
+
+/* Call from the tick timer ISR: @expired is the length of the interval that
+ * just ended, if the timer does not count it in the next retarget call */
+void tickless_tick(uint32_t expired);
+
+/* Reprogram the timer for the earliest deadline. Call with interrupts
+ * disabled, right before waiting for an interrupt. */
+void tickless_update();
+
+#endif // TICKLESS_H
@@ -0,0 +1,154 @@
+#define DEBUG 0
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arm.h"
+#include "console.h"
+#if CONFIG_SMP
+#include "mutex.h"
+#endif // CONFIG_SMP
+#include "panic.h"
+
+#include "work.h"
+
+struct work_queue {
+    struct work *head[WORK_PRIOS], *tail[WORK_PRIOS];
+    work_notify_t *notify;
+    void *notify_arg;
+};
+
+static struct work_queue queues[WORK_MAX_CORES];
+
+#if CONFIG_SMP
+// One lock for all cores, since an item may be cancelled from another core
+static uint32_t work_lock = unlocked;
+#endif // CONFIG_SMP
+
+static struct work_queue *this_queue()
+{
+#if CONFIG_SMP
+    unsigned core = self_core_id();
+    ASSERT(core < WORK_MAX_CORES);
+    return &queues[core];
+#else // !CONFIG_SMP
+    return &queues[0];
+#endif // !CONFIG_SMP
+}
+
+static uint32_t work_lock_acquire()
+{
+    uint32_t irq = int_save_disable();
+#if CONFIG_SMP
+    lock_mutex(&work_lock);
+#endif // CONFIG_SMP
+    return irq;
+}
+
+static void work_lock_release(uint32_t irq)
+{
+#if CONFIG_SMP
+    unlock_mutex(&work_lock);
+#endif // CONFIG_SMP
+    int_restore(irq);
+}
+
+void work_init(struct work *w, const char *name, enum work_prio prio,
+               work_fn_t *fn, void *arg)
+{
+    ASSERT(w && fn);
+    ASSERT(prio < WORK_PRIOS);
+    w->name = name;
+    w->fn = fn;
+    w->arg = arg;
+    w->prio = prio;
+    w->pending = false;
+    w->next = NULL;
+}
+
+void work_notify_register(work_notify_t *cb, void *arg)
+{
+    struct work_queue *q = this_queue();
+    q->notify_arg = arg;
+    q->notify = cb;
+}
+
+bool work_queue(struct work *w)
+{
+    ASSERT(w && w->fn);
+    struct work_queue *q = this_queue();
+    uint32_t irq = work_lock_acquire();
+    if (w->pending) {
+        work_lock_release(irq);
+        return false;
+    }
+    w->pending = true;
+    w->core = q - queues;
+    w->next = NULL;
+    if (q->tail[w->prio])
+        q->tail[w->prio]->next = w;
+    else
+        q->head[w->prio] = w;
+    q->tail[w->prio] = w;
+    work_lock_release(irq);
+
+    DPRINTF("WORK: queued %s prio %u\r\n", w->name, w->prio);
+    if (q->notify)
+        q->notify(q->notify_arg);
+    return true;
+}
+
+void work_cancel(struct work *w)
+{
+    ASSERT(w);
+    uint32_t irq = work_lock_acquire();
+    if (w->pending) {
+        struct work_queue *q = &queues[w->core];
+        struct work *prev = NULL, *cur = q->head[w->prio];
+        while (cur != w) {
+            prev = cur;
+            cur = cur->next;
+        }
+        if (prev)
+            prev->next = w->next;
+        else
+            q->head[w->prio] = w->next;
+        if (q->tail[w->prio] == w)
+            q->tail[w->prio] = prev;
+        w->pending = false;
+    }
+    work_lock_release(irq);
+}
+
+bool work_run_one()
+{
+    struct work_queue *q = this_queue();
+    struct work *w = NULL;
+    uint32_t irq = work_lock_acquire();
+    for (unsigned prio = 0; prio < WORK_PRIOS; ++prio) {
+        w = q->head[prio];
+        if (w) {
+            q->head[prio] = w->next;
+            if (!q->head[prio])
+                q->tail[prio] = NULL;
+            w->pending = false; // before it runs, so that it may be re-queued
+            break;
+        }
+    }
+    work_lock_release(irq);
+    if (!w)
+        return false;
+
+    DPRINTF("WORK: run %s\r\n", w->name);
+    w->fn(w->arg);
+    return true;
+}
+
+bool work_pending()
+{
+    struct work_queue *q = this_queue();
+    for (unsigned prio = 0; prio < WORK_PRIOS; ++prio)
+        if (q->head[prio])
+            return true;
+    return false;
+}
@@ -0,0 +1,62 @@
+#ifndef LIB_WORK_H
+#define LIB_WORK_H
+
+#include <stdbool.h>
+
+/* Deferred work: an ISR does the minimum to quiet its interrupt source,
+ * queues a work item, and returns; the rest runs later from the main loop
+ * (or a thread), with interrupts enabled. There is one FIFO queue per
+ * priority, and the most urgent non-empty queue is served first. An item
+ * is queued at most once: queueing a pending item is a no-op, so items
+ * that stand for a condition (e.g. 'a mailbox has a message') coalesce.
+ *
+ * With CONFIG_SMP, each core has its own queues: an item is queued on the
+ * core that queues it (i.e. that took the interrupt), and runs there, so
+ * that the work follows the interrupt. Without it, the queues are protected
+ * only by masking interrupts. */
+
+#if CONFIG_SMP
+#define WORK_MAX_CORES 2
+#else // !CONFIG_SMP
+#define WORK_MAX_CORES 1
+#endif // !CONFIG_SMP
+
+enum work_prio {
+    WORK_PRIO_HIGH = 0, /* e.g. incoming messages */
+    WORK_PRIO_NORMAL,
+    WORK_PRIO_LOW,
+    WORK_PRIOS,
+};
+
+typedef void (work_fn_t)(void *arg);
+typedef void (work_notify_t)(void *arg);
+
+struct work {
+    const char *name;
+    work_fn_t *fn;
+    void *arg;
+    enum work_prio prio;
+    volatile bool pending;
+    unsigned core; /* whose queue it is on, while pending */
+    struct work *next;
+};
+
+/* Not on a pending item (work_cancel it first): it would corrupt the queue */
+void work_init(struct work *w, const char *name, enum work_prio prio,
+               work_fn_t *fn, void *arg);
+
+/* Safe to call from ISRs. Returns false if the item was already pending.
+ * An item may be re-queued from its own function. */
+bool work_queue(struct work *w);
+/* Dequeue the item, if pending, e.g. before freeing what it works on */
+void work_cancel(struct work *w);
+
+/* Called on every queueing, e.g. to wake up the task that runs the work;
+ * for the queues of the calling core, as are the functions below */
+void work_notify_register(work_notify_t *cb, void *arg);
+
+/* Run the oldest item of the most urgent queue: returns false if none */
+bool work_run_one();
+bool work_pending();
+
+#endif /* LIB_WORK_H */
@@ -19,6 +19,39 @@ static const struct smc_mem_chip_cfg lsio_smc_chip_sram_zebu = {
     .t_tr = 1,
 };
 
+/* Candidates for auto-tuning (smc_tune) of the above, fastest first. The
+ * first ones use page mode reads (8 beats), which only pass tuning if the
+ * chip supports it. Tuning checks only reads, so the write timings (t_wc,
+ * t_wp) are those of the default config. */
+static const struct smc_mem_chip_cfg lsio_smc_chip_sram_zebu_tune[] = {
+    {
+        .width = 32, .sync = false, .adv = false, .rd_bl = 8,
+        .t_rc = 6, .t_wc = 12, .t_ceoe = 2, .t_wp = 6, .t_pc = 2, .t_tr = 1,
+    },
+    {
+        .width = 32, .sync = false, .adv = false, .rd_bl = 8,
+        .t_rc = 8, .t_wc = 12, .t_ceoe = 2, .t_wp = 6, .t_pc = 3, .t_tr = 1,
+    },
+    {
+        .width = 32, .sync = false, .adv = false,
+        .t_rc = 6, .t_wc = 12, .t_ceoe = 2, .t_wp = 6, .t_pc = 4, .t_tr = 1,
+    },
+    {
+        .width = 32, .sync = false, .adv = false,
+        .t_rc = 8, .t_wc = 12, .t_ceoe = 2, .t_wp = 6, .t_pc = 4, .t_tr = 1,
+    },
+    {
+        .width = 32, .sync = false, .adv = false,
+        .t_rc = 10, .t_wc = 12, .t_ceoe = 3, .t_wp = 6, .t_pc = 4, .t_tr = 1,
+    },
+};
+
+static const struct smc_mem_chip_profiles lsio_smc_chip_sram_zebu_profiles = {
+    .count = sizeof(lsio_smc_chip_sram_zebu_tune) /
+             sizeof(lsio_smc_chip_sram_zebu_tune[0]),
+    .cfgs = lsio_smc_chip_sram_zebu_tune,
+};
+
 const struct smc_mem_cfg lsio_smc_mem_cfg = {
     .iface = {
         [SMC_IFACE_SRAM] = {
@@ -32,9 +65,24 @@ const struct smc_mem_cfg lsio_smc_mem_cfg = {
                 &lsio_smc_chip_sram_zebu, /* TODO: should be an MRAM chip */
                 &lsio_smc_chip_sram_zebu, /* TODO: should be an MRAM chip */
             },
+            .profiles = {
+                &lsio_smc_chip_sram_zebu_profiles,
+                &lsio_smc_chip_sram_zebu_profiles,
+                &lsio_smc_chip_sram_zebu_profiles,
+                &lsio_smc_chip_sram_zebu_profiles,
+            },
         },
         [SMC_IFACE_NAND] = {
             .chips = 0, /* nothing connected */
         },
     }
 };
+
+/* 1 Gb x8 chip (e.g. MT29F1G08) */
+const struct smc_nand_cfg lsio_smc_nand_cfg = {
+    .page_size = 2048,
+    .oob_size = 64,
+    .pages_per_block = 64,
+    .blocks = 1024,
+    .row_cycles = 2,
+};
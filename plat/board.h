@@ -2,6 +2,7 @@
 #define BOARD_H
 
 #include "smc.h"
+#include "smc-nand.h"
 
 #define SMC_MEM_RANK_NOR_START      0
 #define SMC_MEM_RANK_NOR_COUNT      2
@@ -9,5 +10,6 @@
 #define SMC_MEM_RANK_MRAM_COUNT     2
 
 const struct smc_mem_cfg lsio_smc_mem_cfg;
+const struct smc_nand_cfg lsio_smc_nand_cfg;
 
 #endif // BOARD_H
@@ -9,6 +9,7 @@
 
 #define RTPS_GIC_BASE   0x30e00000
 #define TRCH_SCS_BASE   0xe000e000
+#define TRCH_DWT_BASE   0xe0001000
 
 #define RTPS_TRCH_TO_HPPS_SMMU_BASE   0x31100000
 #define RTPS_SMMU_BASE                0x31000000
@@ -65,6 +66,7 @@
 #define HSIO_SIZE               0x15000000
 
 #define SMC_LSIO_CSR_BASE           0x30006000
+#define ECC_ENG_BASE                0x30006500
 #define SMC_LSIO_SRAM_BASE0         0x28000000
 #define SMC_LSIO_SRAM_SIZE0         0x01000000
 #define SMC_LSIO_SRAM_BASE1         0x29000000
@@ -97,6 +99,7 @@
 
 // When timing is implemented by a busyloop instead of by a HW timer,
 // we need to convert seconds to interations (empirically calibrated).
+// With CONFIG_CLOCK, these only apply until the calibration at boot.
 #define RTPS_R52_BUSYLOOP_FACTOR       1000000
 #define TRCH_M4_BUSYLOOP_FACTOR		800000
 
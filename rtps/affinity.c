@@ -0,0 +1,21 @@
+#include "intc.h"
+#include "panic.h"
+
+#include "affinity.h"
+
+#if CONFIG_IRQ_AFFINITY
+static const unsigned affinity[AFFINITY_CLASSES] = {
+    [AFFINITY_TRCH_LINK] = 0,
+    [AFFINITY_HPPS_LINK] = 1,
+};
+#endif // CONFIG_IRQ_AFFINITY
+
+unsigned affinity_core(enum affinity_class cls)
+{
+    ASSERT(cls < AFFINITY_CLASSES);
+#if CONFIG_IRQ_AFFINITY
+    return affinity[cls];
+#else // !CONFIG_IRQ_AFFINITY
+    return INTC_AFFINITY_ANY;
+#endif // !CONFIG_IRQ_AFFINITY
+}
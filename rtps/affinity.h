@@ -0,0 +1,21 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+// Which core handles the interrupts of each workload. In SMP mode, the GIC
+// delivers an SPI to any participating core, which in practice is core 0.
+// With CONFIG_IRQ_AFFINITY, workloads are pinned to cores instead, so that
+// the cores serve them in parallel: the work deferred from an ISR runs on the
+// core that took the interrupt (see work.h). For a link, that is receiving
+// and acking the message: the commands are still handled by the one command
+// thread, on core 0. Only core 0 may use the console, so the code that runs
+// on core 1 does not print (DPRINTF only).
+enum affinity_class {
+    AFFINITY_TRCH_LINK, // incl. PSCI, used to bring up the secondary core
+    AFFINITY_HPPS_LINK,
+    AFFINITY_CLASSES,
+};
+
+// The core to route the interrupts of a workload to, or INTC_AFFINITY_ANY
+unsigned affinity_core(enum affinity_class cls);
+
+#endif // AFFINITY_H
@@ -1,5 +1,7 @@
+#include "affinity.h"
 #include "arm.h"
 #include "gic.h"
+#include "intc.h"
 #include "hwinfo.h"
 #include "mailbox-link.h"
 #include "mailbox-map.h"
@@ -39,7 +41,8 @@ void links_init()
 
 #if CONFIG_SMP
     /* Note that in SMP mode, the app uses one mailbox; synchronization
-     * among the cores is up to the software (we only run stuff on primary). */
+     * among the cores is up to the software (commands are handled on the
+     * primary, but see affinity.h for which core takes the interrupts). */
     self_owner = OWNER(SW_SUBSYS_RTPS_R52_SMP, self_sw);
     trch_mbox_ev[0] = LSIO_MBOX0_INT_EVT0__RTPS_R52_SMP_SSW;
     trch_mbox_ev[1] = LSIO_MBOX0_INT_EVT1__RTPS_R52_SMP_SSW;
@@ -104,6 +107,12 @@ void links_init()
     mldev_trch.ack_irq = gic_request(RTPS_IRQ__TR_MBOX_0 + trch_mbox_ev[1],
             GIC_IRQ_TYPE_SPI, GIC_IRQ_CFG_LEVEL);
     mldev_trch.ack_int_idx = trch_mbox_ev[1];
+    intc_int_set_prio(mldev_trch.rcv_irq, INTC_PRIO_MAILBOX);
+    intc_int_set_prio(mldev_trch.ack_irq, INTC_PRIO_MAILBOX);
+#if CONFIG_SMP
+    intc_int_set_affinity(mldev_trch.rcv_irq, affinity_core(AFFINITY_TRCH_LINK));
+    intc_int_set_affinity(mldev_trch.ack_irq, affinity_core(AFFINITY_TRCH_LINK));
+#endif /* CONFIG_SMP */
 #endif /* CONFIG_MBOX_DEV_LSIO */
 
 #if CONFIG_RTPS_TRCH_MAILBOX
@@ -121,6 +130,12 @@ void links_init()
     mldev_hpps.ack_irq = gic_request(RTPS_IRQ__HR_MBOX_0 + hpps_mbox_ev[1],
             GIC_IRQ_TYPE_SPI, GIC_IRQ_CFG_LEVEL);
     mldev_hpps.ack_int_idx = hpps_mbox_ev[1];
+    intc_int_set_prio(mldev_hpps.rcv_irq, INTC_PRIO_MAILBOX);
+    intc_int_set_prio(mldev_hpps.ack_irq, INTC_PRIO_MAILBOX);
+#if CONFIG_SMP
+    intc_int_set_affinity(mldev_hpps.rcv_irq, affinity_core(AFFINITY_HPPS_LINK));
+    intc_int_set_affinity(mldev_hpps.ack_irq, affinity_core(AFFINITY_HPPS_LINK));
+#endif /* CONFIG_SMP */
     mbox_link_dev_add(MBOX_DEV_HPPS, &mldev_hpps);
 #endif /* CONFIG_MBOX_DEV_HPPS */
 
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "arm.h"
+#include "clock.h"
 #include "command.h"
 #include "console.h"
 #include "dma.h"
@@ -12,6 +13,10 @@
 #include "gtimer.h"
 #include "hwinfo.h"
 #include "intc.h"
+#include "irq-stats.h"
+#if CONFIG_KERNEL
+#include "kernel.h"
+#endif // CONFIG_KERNEL
 #include "links.h"
 #include "mailbox.h"
 #include "mailbox-map.h"
@@ -20,18 +25,36 @@
 #include "rti-timer.h"
 #include "server.h"
 #include "sleep.h"
+#include "swtimer.h"
 #include "test.h"
+#if TEST_BUSYLOOP
+#include "test-busyloop.h"
+#endif // TEST_BUSYLOOP
+#if TEST_KERNEL
+#include "test-kernel.h"
+#endif // TEST_KERNEL
+#if CONFIG_TICKLESS
+#include "tickless.h"
+#endif // CONFIG_TICKLESS
 #include "watchdog.h"
+#include "work.h"
 #include "mutex.h"
 #include "psci.h"
 
 extern void enable_caches(void);
 
+#if CONFIG_KERNEL
+#define SYS_TICK_INTERVAL_MS KERNEL_TICK_MS
+#else // !CONFIG_KERNEL
 #define SYS_TICK_INTERVAL_MS 500
+#endif // !CONFIG_KERNEL
 #define MAIN_LOOP_SILENT_ITERS 16
 
 static enum gtimer sys_timer = GTIMER_PHYS;
 static uint32_t sys_timer_interval; // in cycles
+#if CONFIG_TICKLESS
+static uint64_t sys_tick_start; // of the current interval, in counter cycles
+#endif // CONFIG_TICKLESS
 
 // Main is the owner of these pointers because the ISR accesses them
 static struct rti_timer *rti_timer; // only one since this BM code is not SMP
@@ -42,6 +65,35 @@ static struct dma *rtps_dma;
 static struct wdt *wdt;
 #endif // {CONFIG,TEST}_WDT
 
+#if CONFIG_KERNEL
+#define KERNEL_SGI 0 // the SGI that the startup code enables
+#define THREAD_STACK_SIZE 4096
+
+// Thread priorities (0 is the highest)
+#define PRIO_TEST   2
+#define PRIO_WORK   3 // work deferred from ISRs
+#define PRIO_TIMERS 4
+#define PRIO_CMDS   8
+
+// One work thread per core that has work queues (see work.h)
+static struct sem work_sem[WORK_MAX_CORES];
+static struct thread work_thread[WORK_MAX_CORES];
+static uint8_t work_stack[WORK_MAX_CORES][THREAD_STACK_SIZE]
+    __attribute__((aligned(8)));
+static struct sem cmds_sem;
+static struct thread cmds_thread;
+static uint8_t cmds_stack[THREAD_STACK_SIZE] __attribute__((aligned(8)));
+#if CONFIG_SLEEP_TIMER
+static struct sem timers_sem;
+static struct thread timers_thread;
+static uint8_t timers_stack[THREAD_STACK_SIZE] __attribute__((aligned(8)));
+#endif // CONFIG_SLEEP_TIMER
+#if TEST_KERNEL
+static struct thread test_thread;
+static uint8_t test_stack[THREAD_STACK_SIZE] __attribute__((aligned(8)));
+#endif // TEST_KERNEL
+#endif // CONFIG_KERNEL
+
 void enable_interrupts (void)
 {
 	unsigned long temp;
@@ -61,17 +113,137 @@ void soft_reset (void)
 }
 
 #if CONFIG_GTIMER
+#if CONFIG_TICKLESS
+static uint32_t sys_timer_retarget(uint32_t until, uint32_t min)
+{
+    uint64_t now = gtimer_get_pct(sys_timer);
+    uint32_t elapsed = (uint32_t)(now - sys_tick_start); // < 2^32 by max
+    uint32_t interval = until > elapsed && until - elapsed > min ?
+                            until - elapsed : min;
+    gtimer_set_cval(sys_timer, now + interval);
+    sys_tick_start = now;
+    return elapsed;
+}
+#endif // CONFIG_TICKLESS
+
+#if CONFIG_CLOCK
+// The clock reads the physical count, and the alarm is the virtual timer,
+// since the physical one is the system tick.
+static uint64_t gtimer_clock_read(void *arg)
+{
+    return gtimer_get_pct(GTIMER_PHYS);
+}
+
+static void gtimer_clock_alarm(void *arg, uint64_t deadline)
+{
+    // physical count first, so that the offset errs towards a late alarm
+    uint64_t pct = gtimer_get_pct(GTIMER_PHYS);
+    uint64_t offset = gtimer_get_pct(GTIMER_VIRT) - pct;
+    gtimer_set_cval(GTIMER_VIRT, deadline + offset);
+}
+
+static void gtimer_clock_event(void *arg)
+{
+    gtimer_set_cval(GTIMER_VIRT, ~0ull); // deassert the level interrupt
+    clock_alarm_isr();
+}
+#endif // CONFIG_CLOCK
+
 static void sys_tick(void *arg)
 {
+#if CONFIG_KERNEL && CONFIG_SMP
+    if (self_core_id() != 0) { // the other cores tick only for the kernel
+        gtimer_set_tval(sys_timer, sys_timer_interval);
+        kernel_tick();
+        return;
+    }
+#endif // CONFIG_KERNEL && CONFIG_SMP
+#if CONFIG_TICKLESS
+    tickless_tick(0); // the interval is accounted for by the retarget
+#else // !CONFIG_TICKLESS
     int32_t tval = gtimer_get_tval(sys_timer); // negative value, time since last tick
     gtimer_set_tval(sys_timer, sys_timer_interval); // schedule the next tick
 
 #if CONFIG_SLEEP_TIMER
     sleep_tick(sys_timer_interval + (-tval));
+    sw_timer_tick(sys_timer_interval + (-tval));
+#endif // CONFIG_SLEEP_TIMER
+#endif // !CONFIG_TICKLESS
+
+#if CONFIG_KERNEL
+    kernel_tick();
+#if CONFIG_SLEEP_TIMER
+    sem_post(&timers_sem);
 #endif // CONFIG_SLEEP_TIMER
+#endif // CONFIG_KERNEL
 }
 #endif // CONFIG_GTIMER
 
+#if CONFIG_KERNEL
+static void kernel_ipi(unsigned core)
+{
+    gic_sgi_send(KERNEL_SGI, core);
+}
+
+static void work_notify(void *arg)
+{
+    sem_post(arg);
+}
+
+static void work_thread_run(void *arg)
+{
+    struct sem *sem = arg;
+    work_notify_register(work_notify, sem); // for the queues of this core
+    while (1) {
+        while (work_run_one());
+        sem_wait(sem);
+    }
+}
+
+static void cmds_notify(void *arg)
+{
+    sem_post(&cmds_sem);
+}
+
+static void cmds_run(void *arg)
+{
+    struct cmd cmd;
+    while (1) {
+        while (!cmd_dequeue(&cmd))
+            cmd_handle(&cmd);
+        sem_wait(&cmds_sem);
+    }
+}
+
+#if CONFIG_SLEEP_TIMER
+static void timers_run(void *arg)
+{
+    while (1) {
+        sem_wait(&timers_sem);
+        sw_timer_run();
+    }
+}
+#endif // CONFIG_SLEEP_TIMER
+
+#if TEST_KERNEL
+static void test_run(void *arg)
+{
+    if (test_kernel(thread_self()->core))
+        panic("kernel test");
+}
+#endif // TEST_KERNEL
+
+// Called with interrupts disabled, when no thread is ready on the core
+static void main_idle(void *arg)
+{
+#if CONFIG_WDT
+    // Kicked only when the threads leave the core idle, so a thread that
+    // hogs the core is caught (see the comment in the main loop below).
+    watchdog_kick();
+#endif // CONFIG_WDT
+}
+#endif // CONFIG_KERNEL
+
 #if CONFIG_SMP
 static unsigned int smp_core1_awake = 0;
 static uint32_t smp_mutex = unlocked; /* TODO: necessary? */
@@ -105,12 +277,30 @@ static int main_secondary(void)
 {
     /* Don't use UART (printf/panic/etc) from here because conflicts Core 0 */
 
+    irq_stats_init(); /* this core's table, and cycle counter */
+
+    /* The CPU interface is per core (see main_primary) */
+    gic_set_prio_grouping(INTC_PREEMPT_BITS);
+    gic_set_prio_mask(INTC_PRIO_MASK_NONE);
+
+#if CONFIG_KERNEL
+    /* Core 0 is quiet until we are awake, so this may print */
+    gic_int_set_prio(KERNEL_SGI, GIC_IRQ_TYPE_SGI, INTC_PRIO_TIMER);
+    gtimer_set_tval(sys_timer, sys_timer_interval);
+    gic_int_set_prio(PPI_IRQ__TIMER_PHYS, GIC_IRQ_TYPE_PPI, INTC_PRIO_TIMER);
+    gic_int_enable(PPI_IRQ__TIMER_PHYS, GIC_IRQ_TYPE_PPI, GIC_IRQ_CFG_LEVEL);
+    gtimer_start(sys_timer);
+#endif // CONFIG_KERNEL
+
     /* RTPS-1 is up and about to wake up RTPS-0 */
     lock_mutex(&smp_mutex); /* TODO: necessary/ */
     smp_core1_awake = 1;
     asm volatile ("dmb "); /* TODO: necessary? */
     unlock_mutex(&smp_mutex);
 
+#if CONFIG_KERNEL
+    kernel_start(NULL, NULL); /* run the threads created for this core */
+#endif // CONFIG_KERNEL
     while(1) {
         asm volatile ("wfi");
     };
@@ -131,6 +321,21 @@ static int main_primary(void)
 
     /* Not clear what happens to GIC interface to core 1 in lockstep mode */
     gic_init(RTPS_GIC_BASE, RTPS_R52_NUM_CORES);
+    // The startup code masks priorities of 0x80 and above
+    intc_set_prio_grouping(INTC_PREEMPT_BITS);
+    intc_set_prio_mask(INTC_PRIO_MASK_NONE);
+    irq_stats_init();
+
+#if CONFIG_KERNEL
+    kernel_init(kernel_ipi);
+    gic_int_set_prio(KERNEL_SGI, GIC_IRQ_TYPE_SGI, INTC_PRIO_TIMER);
+    for (unsigned c = 0; c < WORK_MAX_CORES; ++c)
+        sem_init(&work_sem[c], 0);
+    sem_init(&cmds_sem, 0);
+#if CONFIG_SLEEP_TIMER
+    sem_init(&timers_sem, 0);
+#endif // CONFIG_SLEEP_TIMER
+#endif // CONFIG_KERNEL
 
     sleep_set_busyloop_factor(RTPS_R52_BUSYLOOP_FACTOR);
 
@@ -144,14 +349,37 @@ static int main_primary(void)
     if (sys_timer_clk == 0)
         panic("system counter freq register was not initialized by bootloader");
     sys_timer_interval = SYS_TICK_INTERVAL_MS * (sys_timer_clk / 1000);
+#if CONFIG_TICKLESS
+    sys_tick_start = gtimer_get_pct(sys_timer);
+#endif // CONFIG_TICKLESS
     gtimer_set_tval(sys_timer, sys_timer_interval);
     gtimer_subscribe(sys_timer, sys_tick, NULL);
+    gic_int_set_prio(PPI_IRQ__TIMER_PHYS, GIC_IRQ_TYPE_PPI, INTC_PRIO_TIMER);
     gic_int_enable(PPI_IRQ__TIMER_PHYS, GIC_IRQ_TYPE_PPI, GIC_IRQ_CFG_LEVEL);
     gtimer_start(sys_timer);
 
 #if CONFIG_SLEEP_TIMER
     sleep_set_clock(sys_timer_clk);
+    sw_timer_init(sys_timer_clk);
 #endif // CONFIG_SLEEP_TIMER
+#if CONFIG_CLOCK
+    gtimer_set_cval(GTIMER_VIRT, ~0ull);
+    gtimer_subscribe(GTIMER_VIRT, gtimer_clock_event, NULL);
+    gic_int_set_prio(PPI_IRQ__TIMER_VIRT, GIC_IRQ_TYPE_PPI, INTC_PRIO_TIMER);
+    gic_int_enable(PPI_IRQ__TIMER_VIRT, GIC_IRQ_TYPE_PPI, GIC_IRQ_CFG_LEVEL);
+    gtimer_start(GTIMER_VIRT);
+    clock_init(gtimer_clock_read, gtimer_clock_alarm, NULL, sys_timer_clk);
+    sleep_calibrate_busyloop();
+#endif // CONFIG_CLOCK
+#if TEST_BUSYLOOP
+    if (test_busyloop())
+        panic("busyloop test");
+#endif // TEST_BUSYLOOP
+#if CONFIG_TICKLESS
+    // The watchdog is kicked from the main loop, so wake up often enough
+    tickless_init(sys_timer_retarget, sys_timer_clk / 10000,
+                  CONFIG_WDT ? sys_timer_interval : 0x7fffffff);
+#endif // CONFIG_TICKLESS
 #endif // CONFIG_GTIMER
 
 #if CONFIG_TESTS
@@ -207,6 +435,30 @@ static int main_primary(void)
         panic("failed to bring up secondary cores");
 #endif /* CONFIG_SMP */
 
+#if CONFIG_KERNEL
+    thread_create(&work_thread[0], "work", PRIO_WORK, core,
+                  work_stack[0], sizeof(work_stack[0]), work_thread_run,
+                  &work_sem[0]);
+#if CONFIG_SMP
+    // for the interrupts routed to core 1 (see affinity.h)
+    thread_create(&work_thread[1], "work", PRIO_WORK, /* core */ 1,
+                  work_stack[1], sizeof(work_stack[1]), work_thread_run,
+                  &work_sem[1]);
+#endif // CONFIG_SMP
+    cmd_notify_register(cmds_notify, NULL);
+    thread_create(&cmds_thread, "cmds", PRIO_CMDS, core,
+                  cmds_stack, sizeof(cmds_stack), cmds_run, NULL);
+#if CONFIG_SLEEP_TIMER
+    thread_create(&timers_thread, "timers", PRIO_TIMERS, core,
+                  timers_stack, sizeof(timers_stack), timers_run, NULL);
+#endif // CONFIG_SLEEP_TIMER
+#if TEST_KERNEL
+    thread_create(&test_thread, "test", PRIO_TEST, core,
+                  test_stack, sizeof(test_stack), test_run, NULL);
+#endif // TEST_KERNEL
+    kernel_start(main_idle, NULL); // does not return
+#endif // CONFIG_KERNEL
+
     unsigned iter = 0;
     while (1) {
         bool verbose = iter++ % MAIN_LOOP_SILENT_ITERS == 0;
@@ -230,6 +482,13 @@ static int main_primary(void)
         watchdog_kick();
 #endif // CONFIG_WDT
 
+#if CONFIG_SLEEP_TIMER
+        sw_timer_run();
+#endif // CONFIG_SLEEP_TIMER
+
+        while (work_run_one())
+            verbose = true;
+
         struct cmd cmd;
         while (!cmd_dequeue(&cmd)) {
             cmd_handle(&cmd);
@@ -237,9 +496,12 @@ static int main_primary(void)
         }
 
         int_disable(); // the check and the WFI must be atomic
-        if (!cmd_pending()) {
+        if (!cmd_pending() && !work_pending()) {
             if (verbose)
                 printf("[%u] Waiting for interrupt...\r\n", iter);
+#if CONFIG_TICKLESS
+            tickless_update();
+#endif // CONFIG_TICKLESS
             asm("wfi"); // ignores PRIMASK set by int_disable
         }
         int_enable();
@@ -258,10 +520,18 @@ int main(void)
 }
 
 void irq_handler(unsigned intid) {
+#if CONFIG_IRQ_STATS
+    uint32_t stats_start = irq_stats_enter();
+#endif // CONFIG_IRQ_STATS
     DPRINTF("INTID #%u\r\n", intid);
     if (intid < GIC_NR_SGIS) { // SGI
         unsigned sgi = intid;
         switch (sgi) {
+#if CONFIG_KERNEL
+            case KERNEL_SGI:
+                kernel_ipi_isr();
+                break;
+#endif // CONFIG_KERNEL
             default:
                 printf("WARN: no ISR for SGI IRQ #%u\r\n", sgi);
         }
@@ -392,4 +662,7 @@ void irq_handler(unsigned intid) {
                 printf("WARN: no ISR for IRQ #%u\r\n", irq);
         }
     }
+#if CONFIG_IRQ_STATS
+    irq_stats_exit(intid, stats_start);
+#endif // CONFIG_IRQ_STATS
 }
@@ -2,9 +2,12 @@
 #include <unistd.h>
 
 #include "command.h"
+#include "irq-stats.h"
 #include "panic.h"
 #include "console.h"
+#include "mem.h"
 #include "server.h"
+#include "sleep.h"
 
 int server_process(struct cmd *cmd, void *reply, size_t reply_sz)
 {
@@ -26,6 +29,61 @@ int server_process(struct cmd *cmd, void *reply, size_t reply_sz)
         case CMD_PONG:
             printf("PONG ...\r\n");
             return 0;
+        case CMD_BUSYLOOP: {
+            uint8_t calibrate = cmd->msg[CMD_MSG_PAYLOAD_OFFSET];
+            struct cmd_busyloop *pl =
+                (struct cmd_busyloop *)(&reply_u8[CMD_MSG_PAYLOAD_OFFSET]);
+            printf("BUSYLOOP ...\r\n");
+            printf("\tcalibrate = %u\r\n", calibrate);
+            ASSERT(CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl) <= reply_sz);
+
+            reply_u8[0] = CMD_BUSYLOOP;
+            for (i = 1; i < CMD_MSG_PAYLOAD_OFFSET; i++)
+                reply_u8[i] = 0;
+            pl->rc = 0;
+            if (calibrate) {
+#if CONFIG_CLOCK
+                sleep_calibrate_busyloop();
+#else // !CONFIG_CLOCK
+                pl->rc = -1;
+#endif // !CONFIG_CLOCK
+            }
+            pl->factor = sleep_get_busyloop_factor();
+            return CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl);
+        }
+        case CMD_IRQ_STATS: {
+            unsigned index =
+                *(uint16_t *)(&cmd->msg[CMD_MSG_PAYLOAD_OFFSET]);
+            unsigned core;
+            struct irq_stat st;
+            struct cmd_irq_stats *pl =
+                (struct cmd_irq_stats *)(&reply_u8[CMD_MSG_PAYLOAD_OFFSET]);
+            printf("IRQ_STATS ...\r\n");
+            printf("\tindex = %u\r\n", index);
+            ASSERT(CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl) <= reply_sz);
+            ASSERT(IRQ_STATS_BUCKETS == CMD_IRQ_STATS_BUCKETS);
+
+            if (!index)
+                irq_stats_print();
+
+            reply_u8[0] = CMD_IRQ_STATS;
+            for (i = 1; i < CMD_MSG_PAYLOAD_OFFSET; i++)
+                reply_u8[i] = 0;
+            bzero(pl, sizeof(*pl));
+            if (!irq_stats_next(&index, &core, &st)) {
+                pl->index = index;
+                pl->valid = 1;
+                pl->core = core;
+                pl->irq = st.irq;
+                pl->count = st.count;
+                pl->max_cycles = st.max;
+                pl->total_cycles_lo = (uint32_t)st.total;
+                pl->total_cycles_hi = (uint32_t)(st.total >> 32);
+                for (i = 0; i < CMD_IRQ_STATS_BUCKETS; i++)
+                    pl->hist[i] = st.hist[i];
+            }
+            return CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl);
+        }
         default:
             printf("ERROR: unknown cmd: %x\r\n", cmd->msg[0]);
             return -1;
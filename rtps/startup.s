@@ -212,6 +212,52 @@ EL1_Reserved:
         B   EL1_Reserved
 .type EL1_IRQ_Handler, "function"
 EL1_IRQ_Handler:
+#if CONFIG_KERNEL
+        // The ISR runs on the stack of the interrupted thread, in SVC mode,
+        // and the context is saved there in the layout of kernel_switch, so
+        // that the kernel may switch to another thread on the way out.
+        SUB lr, #4  // undo auto offset to get preferred ret address (ARMv8-A/R Reference, Table B1-7, IRQ/FIQ row)
+        SRSDB sp!, #Mode_SVC // pc, cpsr
+        CPS #Mode_SVC
+        PUSH {r0-r3, r12, lr} // the rest of what the C code may clobber
+        AND r1, sp, #4 // align the stack to 8 bytes, as C requires
+        SUB sp, sp, r1
+#ifdef __ARM_FP
+        // The FP registers that the C code may clobber belong to the thread
+        VMRS r2, FPSCR
+        PUSH {r2, r3}
+        VPUSH {d16-d31}
+        VPUSH {d0-d7}
+#endif
+        MRC p15, 0, r0, c12, c12, 0 // r0 <- IRCC_IAR1 (INTID)
+        PUSH {r0, r1} // save INTID and the alignment adjustment
+        BL kernel_irq_enter
+        LDR r0, [sp] // restore INTID
+#if CONFIG_IRQ_NESTING
+        // Until the EOI, the GIC signals only interrupts in a more urgent
+        // preemption level than this one, and those may preempt the ISR:
+        // they enter here again, on the same stack, on top of this frame.
+        CPSIE i
+#endif /* CONFIG_IRQ_NESTING */
+        BL irq_handler // arg passed in r0 (IRQ #)
+#if CONFIG_IRQ_NESTING
+        CPSID i
+#endif /* CONFIG_IRQ_NESTING */
+        LDR r0, [sp] // restore INTID
+        MCR p15, 0, r0, c12, c12, 1 // ICC_EOIR1 <- r0 (INTID)
+        BL kernel_irq_exit // r0 <- whether to switch threads
+        POP {r1, r2}
+#ifdef __ARM_FP
+        VPOP {d0-d7}
+        VPOP {d16-d31}
+        POP {r1, r3}
+        VMSR FPSCR, r1
+#endif
+        ADD sp, sp, r2
+        CMP r0, #0
+        BNE kernel_switch_irq
+        B kernel_restore
+#else /* !CONFIG_KERNEL */
         SUB lr, #4  // undo auto offset to get preferred ret address (ARMv8-A/R Reference, Table B1-7, IRQ/FIQ row)
         SRSDB sp!, #Mode_IRQ
         PUSH {r0} // save, because we are going to use
@@ -222,10 +268,54 @@ EL1_IRQ_Handler:
         MCR p15, 0, r0, c12, c12, 1 // ICC_EOIR1 <- r0 (INTID)	// coproc, #opcode1, Rt, CRn, CRm{, #opcode2}
         POP {r0} // restore the registers we used
         RFEIA sp!
+#endif /* !CONFIG_KERNEL */
 .type EL1_FIQ_Handler, "function"
 EL1_FIQ_Handler:
         B   EL1_FIQ_Handler
 
+#if CONFIG_KERNEL
+//----------------------------------------------------------------
+// Thread context switch (see lib/kernel.c): saves the context of the
+// current thread on its stack, and restores the one of the next thread.
+// Called from C in SVC mode with interrupts disabled, or entered from the
+// IRQ handler with the caller-saved registers already pushed. The saved
+// context, from the lowest address:
+//     FPSCR, pad, d0-d31 (with FP), r4-r11, r0-r3, r12, lr, pc, cpsr
+// (the build uses VFPv3 with all 32 D registers, see CPU_FLAGS in Makefile)
+//----------------------------------------------------------------
+    .global kernel_switch
+.type kernel_switch, "function"
+kernel_switch:
+        MRS r12, cpsr
+        ADR r1, kernel_switch_resume
+        PUSH {r1, r12} // pc, cpsr: resume below, in ARM state
+        PUSH {r0-r3, r12, lr}
+kernel_switch_irq:
+        PUSH {r4-r11}
+#ifdef __ARM_FP
+        VPUSH {d16-d31}
+        VPUSH {d0-d15}
+        VMRS r1, FPSCR
+        PUSH {r1, r2}
+#endif
+        MOV r0, sp
+        BIC sp, sp, #7 // align the stack to 8 bytes, as C requires
+        BL kernel_switch_context // r0 <- saved context of the next thread
+        MOV sp, r0
+#ifdef __ARM_FP
+        POP {r1, r2}
+        VMSR FPSCR, r1
+        VPOP {d0-d15}
+        VPOP {d16-d31}
+#endif
+        POP {r4-r11}
+kernel_restore:
+        POP {r0-r3, r12, lr}
+        RFEIA sp!
+kernel_switch_resume:
+        BX lr
+#endif /* CONFIG_KERNEL */
+
 //----------------------------------------------------------------
 // EL2 Reset Handler
 //----------------------------------------------------------------
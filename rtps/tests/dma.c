@@ -7,7 +7,9 @@
 #include "hwinfo.h"
 #include "mem-map.h"
 #include "gic.h"
+#include "intc.h"
 #include "test.h"
+#include "work.h"
 
 #define RTPS_DMA_WORDS (RTPS_DMA_SIZE / sizeof(uint32_t))
 
@@ -47,7 +49,8 @@ static int do_copy(struct dma *d, uint32_t *src, uint32_t *dst, unsigned sz)
 
     printf("Waiting for DMA tx to complete\r\n");
 #if TEST_RTPS_DMA_CB
-    while (!dma_done);
+    while (!dma_done)
+        work_run_one(); // the callback is deferred from the ISR
 #else
     int rc = dma_wait(dma_tx);
     if (rc)
@@ -63,6 +66,8 @@ int test_rtps_dma(struct dma **rtps_dma_ptr)
     struct dma *rtps_dma;
     int rc = 0;
 
+    gic_int_set_prio(RTPS_IRQ__RTPS_DMA_ABORT, GIC_IRQ_TYPE_SPI, INTC_PRIO_DMA);
+    gic_int_set_prio(RTPS_IRQ__RTPS_DMA_EV0, GIC_IRQ_TYPE_SPI, INTC_PRIO_DMA);
     gic_int_enable(RTPS_IRQ__RTPS_DMA_ABORT, GIC_IRQ_TYPE_SPI, GIC_IRQ_CFG_EDGE);
     gic_int_enable(RTPS_IRQ__RTPS_DMA_EV0, GIC_IRQ_TYPE_SPI, GIC_IRQ_CFG_EDGE);
 
@@ -1,4 +1,5 @@
 #include "test.h"
+#include "test-sha256.h"
 
 /* Run tests whose only dependency is at most the system timer */
 int test_standalone()
@@ -25,5 +26,10 @@ int test_standalone()
     if (rc) return rc;
 #endif /* TEST_RT_MMU */
 
+#if TEST_SHA256
+    rc = test_sha256();
+    if (rc) return rc;
+#endif /* TEST_SHA256 */
+
     return 0;
 }
@@ -3,6 +3,7 @@
 #include "console.h"
 #include "panic.h"
 #include "gic.h"
+#include "intc.h"
 #include "hwinfo.h"
 #include "arm.h"
 #include "subsys.h"
@@ -38,6 +39,7 @@ int watchdog_init(struct wdt **wdt_ptr)
 
     wdt_enable(wdt);
 
+    gic_int_set_prio(PPI_IRQ__WDT, GIC_IRQ_TYPE_PPI, INTC_PRIO_WDT);
     gic_int_enable(PPI_IRQ__WDT, GIC_IRQ_TYPE_PPI, GIC_IRQ_CFG_LEVEL);
     return 0;
 }
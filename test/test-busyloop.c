@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "arm.h"
+#include "clock.h"
+#include "console.h"
+#include "sleep.h"
+
+#include "test-busyloop.h"
+
+#define TOLERANCE_PCT   5   // of mdelay, either way
+#define USLEEP_SLACK_US 50  // clock_usleep may overshoot by this much
+
+static const unsigned delays_ms[] = { 1, 5, 20 };
+static const unsigned sleeps_us[] = { 5, 100, 2000 };
+
+static uint32_t elapsed_us(uint64_t start)
+{
+    return (uint32_t)(clock_now() - start) / (uint32_t)clock_us(1);
+}
+
+int test_busyloop()
+{
+    unsigned i;
+    int rc = 0;
+
+    printf("TEST: busyloop: factor %u\r\n", sleep_get_busyloop_factor());
+
+    for (i = 0; i < sizeof(delays_ms) / sizeof(delays_ms[0]); ++i) {
+        uint32_t expected = delays_ms[i] * 1000;
+        uint32_t slack = expected * TOLERANCE_PCT / 100;
+        int_disable();
+        uint64_t start = clock_now();
+        mdelay(delays_ms[i]);
+        uint32_t us = elapsed_us(start);
+        int_enable();
+        printf("TEST: busyloop: mdelay(%u): %u us\r\n", delays_ms[i], us);
+        if (us < expected - slack || us > expected + slack) {
+            printf("TEST: busyloop: ERROR: off by more than %u%%\r\n",
+                   TOLERANCE_PCT);
+            rc = 1;
+        }
+    }
+
+    for (i = 0; i < sizeof(sleeps_us) / sizeof(sleeps_us[0]); ++i) {
+        uint64_t start = clock_now();
+        clock_usleep(sleeps_us[i]);
+        uint32_t us = elapsed_us(start);
+        printf("TEST: busyloop: clock_usleep(%u): %u us\r\n", sleeps_us[i], us);
+        if (us < sleeps_us[i] || us > sleeps_us[i] + USLEEP_SLACK_US) {
+            printf("TEST: busyloop: ERROR: not within [%u, %u] us\r\n",
+                   sleeps_us[i], sleeps_us[i] + USLEEP_SLACK_US);
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,8 @@
+#ifndef TEST_BUSYLOOP_H
+#define TEST_BUSYLOOP_H
+
+// Checks mdelay (with the calibrated factor) and clock_usleep against the
+// clock. Requires the clock to be initialized and the busyloop calibrated.
+int test_busyloop();
+
+#endif // TEST_BUSYLOOP_H
@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "console.h"
+#include "kernel.h"
+
+#include "test-kernel.h"
+
+#define STACK_SIZE      4096
+#define PRIO_HIGH       0 // above the caller
+#define PRIO_ECHO       0
+#define PRIO_SPIN       20 // below the caller
+#define ECHO_ITEMS      64
+#define QUEUE_LEN       4
+#define SLICE_TEST_MS   (10 * KERNEL_TICK_MS)
+
+static struct thread high_thread, echo_thread, spin_threads[2];
+static uint8_t high_stack[STACK_SIZE] __attribute__((aligned(8)));
+static uint8_t echo_stack[STACK_SIZE] __attribute__((aligned(8)));
+static uint8_t spin_stacks[2][STACK_SIZE] __attribute__((aligned(8)));
+
+static struct sem high_sem, done_sem;
+static volatile bool high_ran;
+
+static struct queue q_in, q_out;
+static uint32_t q_in_buf[QUEUE_LEN], q_out_buf[QUEUE_LEN];
+
+static volatile bool spin_stop;
+static volatile uint32_t spin_count[2];
+
+static void high_run(void *arg)
+{
+    sem_wait(&high_sem);
+    high_ran = true;
+    sem_post(&done_sem);
+}
+
+static void echo_run(void *arg)
+{
+    for (unsigned i = 0; i < ECHO_ITEMS; ++i) {
+        uint32_t v;
+        queue_get(&q_in, &v);
+        v++;
+        queue_put(&q_out, &v);
+    }
+}
+
+static void spin_run(void *arg)
+{
+    volatile uint32_t *count = arg;
+    while (!spin_stop)
+        (*count)++;
+    sem_post(&done_sem);
+}
+
+static int test_preempt(unsigned core)
+{
+    sem_init(&high_sem, 0);
+    sem_init(&done_sem, 0);
+    high_ran = false;
+    thread_create(&high_thread, "test-high", PRIO_HIGH, core,
+                  high_stack, sizeof(high_stack), high_run, NULL);
+    // it ran until it blocked, and runs again as soon as it is posted
+    sem_post(&high_sem);
+    bool ran = high_ran;
+    sem_wait(&done_sem);
+    printf("TEST: kernel: preempt: %s\r\n", ran ? "ok" : "ERROR: not run");
+    return ran ? 0 : 1;
+}
+
+static int test_queue(unsigned core)
+{
+    queue_init(&q_in, q_in_buf, sizeof(q_in_buf[0]), QUEUE_LEN);
+    queue_init(&q_out, q_out_buf, sizeof(q_out_buf[0]), QUEUE_LEN);
+    thread_create(&echo_thread, "test-echo", PRIO_ECHO, core,
+                  echo_stack, sizeof(echo_stack), echo_run, NULL);
+
+    // keep the queue full on the way in, to block on both ends
+    unsigned sent = 0, recvd = 0;
+    int rc = 0;
+    while (recvd < ECHO_ITEMS) {
+        uint32_t v = sent;
+        if (sent < ECHO_ITEMS && queue_tryput(&q_in, &v)) {
+            sent++;
+            continue;
+        }
+        queue_get(&q_out, &v);
+        if (v != recvd + 1) {
+            printf("TEST: kernel: queue: ERROR: item %u: %u != %u\r\n",
+                   recvd, v, recvd + 1);
+            rc = 1;
+        }
+        recvd++;
+    }
+    printf("TEST: kernel: queue: %u items via core %u: %s\r\n",
+           recvd, core, rc ? "ERROR" : "ok");
+    return rc;
+}
+
+static int test_slice(unsigned core)
+{
+    spin_stop = false;
+    for (unsigned i = 0; i < 2; ++i) {
+        spin_count[i] = 0;
+        thread_create(&spin_threads[i], "test-spin", PRIO_SPIN, core,
+                      spin_stacks[i], sizeof(spin_stacks[i]), spin_run,
+                      (void *)&spin_count[i]);
+    }
+    thread_sleep_ms(SLICE_TEST_MS);
+    spin_stop = true;
+    sem_wait(&done_sem);
+    sem_wait(&done_sem);
+
+    bool ok = spin_count[0] && spin_count[1];
+    printf("TEST: kernel: slice: counts %u %u (switches %u %u): %s\r\n",
+           spin_count[0], spin_count[1],
+           spin_threads[0].switches, spin_threads[1].switches,
+           ok ? "ok" : "ERROR: starved");
+    return ok ? 0 : 1;
+}
+
+int test_kernel(unsigned core)
+{
+#if CONFIG_SMP
+    unsigned other = core ^ 1;
+#else // !CONFIG_SMP
+    unsigned other = core;
+#endif // !CONFIG_SMP
+    int rc = 0;
+
+    rc |= test_preempt(core);
+    rc |= test_queue(other);
+    rc |= test_slice(core);
+    return rc;
+}
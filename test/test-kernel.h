@@ -0,0 +1,9 @@
+#ifndef TEST_KERNEL_H
+#define TEST_KERNEL_H
+
+// Checks preemption by priority, time slicing, and semaphores and queues
+// between threads (across cores, with SMP). Must be called from a thread
+// with a priority between 1 and 19, on the given core.
+int test_kernel(unsigned core);
+
+#endif // TEST_KERNEL_H
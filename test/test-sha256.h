@@ -0,0 +1,8 @@
+#ifndef TEST_SHA256_H
+#define TEST_SHA256_H
+
+// Checks digests (aligned, unaligned, split updates) and prints throughput
+// measured with the CPU cycle counter.
+int test_sha256();
+
+#endif // TEST_SHA256_H
@@ -0,0 +1,285 @@
+// Benchmark of the ECC decode paths on the host, with the engine replaced
+// by a register model that encodes and decodes in software and counts
+// register accesses. On the target each register access is a bus
+// transaction, so accesses per word is the figure that carries over; host
+// time per word does not.
+//
+// The model's code is private to this file, as the engine's is to the
+// hardware: the driver has to learn it through the encoder (ecc_eng_learn),
+// and the checks below fail if the software decoder disagrees with it.
+// "ecc-bench test" runs only the checks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ecc-eng.h"
+
+#define NWORDS (1 << 20)
+
+#define REG__DECODE_INPUT0      0x00
+#define REG__DECODE_INPUT1      0x04
+#define REG__DECODE_OUTPUT      0x08
+#define REG__ENCODE_INPUT       0x10
+#define REG__ENCODE_OUTPUT0     0x14
+#define REG__ENCODE_OUTPUT1     0x18
+#define REG__DECODE_STATUS      0x20
+
+// The model's code: a (39,32) SEC-DED Hamming code. Data bit d sits at
+// codeword position p(d) = the d-th position that is not a power of 2 (3,
+// 5, 6, 7, 9, ...), and check bit i covers the positions with bit i set.
+// Check bits 0-5 are the Hamming parities, bit 6 the overall parity, and
+// bit 7 is inverted, so that the zero word does not have a zero check.
+#define HAMMING_BITS 6
+static const uint32_t hamming_masks[HAMMING_BITS] = {
+    0x56aaad5b, 0x9b33366d, 0xe3c3c78e, 0x03fc07f0, 0x03fff800, 0xfc000000,
+};
+#define MODEL_CHECK0 0x80
+
+static unsigned parity32(uint32_t x)
+{
+    return __builtin_parity(x);
+}
+
+static unsigned hamming(uint32_t d)
+{
+    unsigned h = 0;
+    for (unsigned i = 0; i < HAMMING_BITS; ++i)
+        h |= parity32(d & hamming_masks[i]) << i;
+    return h;
+}
+
+static uint8_t model_encode(uint32_t data)
+{
+    unsigned h = hamming(data);
+    return (h | (parity32(data) ^ parity32(h)) << HAMMING_BITS) ^ MODEL_CHECK0;
+}
+
+static void model_decode(uint32_t *data, uint8_t check)
+{
+    unsigned h = (check ^ MODEL_CHECK0) & ((1 << HAMMING_BITS) - 1);
+    unsigned syn = hamming(*data) ^ h;
+    unsigned odd = parity32(*data) ^ parity32(h) ^
+                   (((check ^ MODEL_CHECK0) >> HAMMING_BITS) & 1);
+
+    if (!syn || !odd || !(syn & (syn - 1))) // ok, double, or check bit
+        return;
+    // syn is the position of the flipped data bit; skip the check bits
+    // (powers of 2) at and below it, and position 0
+    unsigned bit = syn - (31 - __builtin_clz(syn)) - 2;
+    if (bit < 32)
+        *data ^= 1u << bit;
+}
+
+static struct {
+    uint32_t input0, input1, output, status;
+    uint32_t enc_input, enc_output0, enc_output1;
+    int dead;       // registers read as 0 and writes are ignored
+    unsigned alias; // if nonzero, data bit 31 encodes like this bit
+    unsigned long reads, writes;
+} model;
+
+uint32_t ecc_eng_model_read(unsigned reg)
+{
+    model.reads++;
+    if (model.dead)
+        return 0;
+    switch (reg) {
+        case REG__DECODE_INPUT0: return model.input0;
+        case REG__DECODE_INPUT1: return model.input1;
+        case REG__DECODE_OUTPUT: return model.output;
+        case REG__DECODE_STATUS: return model.status;
+        case REG__ENCODE_INPUT: return model.enc_input;
+        case REG__ENCODE_OUTPUT0: return model.enc_output0;
+        case REG__ENCODE_OUTPUT1: return model.enc_output1;
+        default: return 0;
+    }
+}
+
+void ecc_eng_model_write(unsigned reg, uint32_t val)
+{
+    model.writes++;
+    if (model.dead)
+        return;
+    switch (reg) {
+        case REG__DECODE_INPUT0:
+            model.input0 = val;
+            break;
+        case REG__DECODE_INPUT1: // triggers decode
+            model.input1 = val;
+            model.output = model.input0;
+            model_decode(&model.output, val & 0xff);
+            model.status++;
+            break;
+        case REG__ENCODE_INPUT: // triggers encode
+            model.enc_input = val;
+            model.enc_output0 = val;
+            if (model.alias && (val >> 31))
+                val ^= (1u << 31) | (1u << model.alias);
+            model.enc_output1 = model_encode(val);
+            break;
+    }
+}
+
+// The loop BL0 had before the driver: serialized, with a status read before
+// each word and a debug re-read of input and output registers after it.
+static void legacy_decode(uint32_t *dst, const uint32_t *src, unsigned nwords)
+{
+    for (unsigned w = 0; w < nwords; ++w) {
+        unsigned g = w / ECC_GROUP_DATA_WORDS, i = w % ECC_GROUP_DATA_WORDS;
+        uint32_t d = src[g * ECC_GROUP_WORDS + i];
+        uint32_t c = (src[g * ECC_GROUP_WORDS + ECC_GROUP_DATA_WORDS] >> (8 * i)) & 0xff;
+        uint32_t t_status = ecc_eng_model_read(REG__DECODE_STATUS);
+        ecc_eng_model_write(REG__DECODE_INPUT0, d);
+        ecc_eng_model_write(REG__DECODE_INPUT1, c);
+        while (ecc_eng_model_read(REG__DECODE_STATUS) != t_status + 1)
+            ;
+        t_status = ecc_eng_model_read(REG__DECODE_STATUS);
+        dst[w] = ecc_eng_model_read(REG__DECODE_OUTPUT);
+        // debug re-read of the input and output registers
+        (void)ecc_eng_model_read(REG__DECODE_INPUT0);
+        (void)ecc_eng_model_read(REG__DECODE_OUTPUT);
+    }
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, double ns, const uint32_t *dst,
+                   const uint32_t *ref, struct ecc_stats *st)
+{
+    printf("%-8s %6.2f ns/word  %5.2f reads/word  %5.2f writes/word  "
+           "corrected %u uncorrectable %u  %s\n",
+           name, ns / NWORDS, (double)model.reads / NWORDS,
+           (double)model.writes / NWORDS, st->corrected, st->uncorrectable,
+           memcmp(dst, ref, NWORDS * sizeof(*dst)) ? "MISMATCH" : "ok");
+}
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok)
+        failures++;
+}
+
+// The software decoder works from the learned code, so it must agree with
+// the engine's encoder on every word, and correct and detect the same errors
+static void test(uint32_t *src, const uint32_t *ref, uint32_t *dst)
+{
+    struct ecc_code code;
+    struct ecc_stats st;
+    unsigned w, mismatches = 0;
+    int rc;
+
+    memset(&model, 0, sizeof(model));
+    check(!ecc_eng_learn(0, &code) && code.learned, "learn the engine's code");
+    for (w = 0; w < NWORDS; ++w)
+        if (ecc_sw_encode(&code, ref[w]) != model_encode(ref[w]))
+            mismatches++;
+    check(!mismatches, "software encode matches the engine on random words");
+    for (w = 0; w < 32; ++w) {
+        uint32_t d = ref[w] ^ (1u << w);
+        if (ecc_sw_decode_word(&code, &d, model_encode(ref[w])) != 1 ||
+            d != ref[w])
+            mismatches++;
+    }
+    for (w = 0; w < ECC_CHECK_BITS; ++w) {
+        uint32_t d = ref[w];
+        if (ecc_sw_decode_word(&code, &d, model_encode(d) ^ (1u << w)) != 1 ||
+            d != ref[w])
+            mismatches++;
+    }
+    check(!mismatches, "software decode corrects each single-bit error");
+
+    // a double-bit error must be detected, not miscorrected, on both paths
+    src[2] ^= 0x11;
+    memset(&st, 0, sizeof(st));
+    rc = ecc_sw_decode(&code, dst, src, ECC_GROUP_DATA_WORDS, &st);
+    check(rc < 0 && st.uncorrectable == 1, "software: double-bit error detected");
+    memset(&st, 0, sizeof(st));
+    rc = ecc_eng_decode(0, &code, dst, src, ECC_GROUP_DATA_WORDS, &st);
+    check(rc < 0 && st.uncorrectable == 1, "engine: double-bit error detected");
+    memset(&st, 0, sizeof(st));
+    rc = ecc_eng_decode(0, NULL, dst, src, ECC_GROUP_DATA_WORDS, &st);
+    check(!rc && !st.uncorrectable,
+          "engine, no code: double-bit error not detected (as documented)");
+    src[2] ^= 0x11;
+
+    memset(&model, 0, sizeof(model));
+    model.alias = 5;
+    check(ecc_eng_learn(0, &code) < 0 && !code.learned,
+          "learn rejects a code that cannot correct all single errors");
+    memset(&model, 0, sizeof(model));
+    model.dead = 1;
+    check(ecc_eng_learn(0, &code) == ECC_ENG_TIMEOUT && !code.learned,
+          "learn times out on a dead engine");
+    rc = ecc_eng_decode(0, NULL, dst, src, ECC_GROUP_DATA_WORDS, &st);
+    check(rc == ECC_ENG_TIMEOUT, "decode times out on a dead engine");
+}
+
+int main(int argc, char *argv[])
+{
+    int test_only = argc > 1 && !strcmp(argv[1], "test");
+    unsigned ngroups = NWORDS / ECC_GROUP_DATA_WORDS;
+    uint32_t *ref = malloc(NWORDS * sizeof(uint32_t));
+    uint32_t *dst = malloc(NWORDS * sizeof(uint32_t));
+    uint32_t *src = malloc(ngroups * ECC_GROUP_WORDS * sizeof(uint32_t));
+    struct ecc_code code;
+    struct ecc_stats st;
+    double t;
+
+    srand(1);
+    for (unsigned w = 0; w < NWORDS; ++w)
+        ref[w] = ((uint32_t)rand() << 16) ^ rand();
+    for (unsigned g = 0; g < ngroups; ++g) {
+        uint32_t checks = 0;
+        for (unsigned i = 0; i < ECC_GROUP_DATA_WORDS; ++i) {
+            uint32_t d = ref[g * ECC_GROUP_DATA_WORDS + i];
+            src[g * ECC_GROUP_WORDS + i] = d;
+            checks |= (uint32_t)model_encode(d) << (8 * i);
+        }
+        src[g * ECC_GROUP_WORDS + ECC_GROUP_DATA_WORDS] = checks;
+    }
+    // one single-bit error in every 1024th data word
+    for (unsigned g = 0; g < ngroups; g += 256)
+        src[g * ECC_GROUP_WORDS + 1] ^= 1u << (g % 32);
+
+    test(src, ref, dst);
+    if (test_only)
+        return !!failures;
+
+    memset(&model, 0, sizeof(model));
+    ecc_eng_learn(0, &code);
+
+    memset(&model, 0, sizeof(model));
+    t = now_ns();
+    legacy_decode(dst, src, NWORDS);
+    memset(&st, 0, sizeof(st));
+    report("legacy", now_ns() - t, dst, ref, &st);
+
+    memset(&model, 0, sizeof(model));
+    memset(&st, 0, sizeof(st));
+    t = now_ns();
+    ecc_eng_decode(0, NULL, dst, src, NWORDS, &st);
+    report("engine", now_ns() - t, dst, ref, &st);
+
+    memset(&model, 0, sizeof(model));
+    memset(&st, 0, sizeof(st));
+    t = now_ns();
+    ecc_eng_decode(0, &code, dst, src, NWORDS, &st);
+    report("engine+", now_ns() - t, dst, ref, &st);
+
+    memset(&model, 0, sizeof(model));
+    memset(&st, 0, sizeof(st));
+    t = now_ns();
+    ecc_sw_decode(&code, dst, src, NWORDS, &st);
+    report("software", now_ns() - t, dst, ref, &st);
+    return !!failures;
+}
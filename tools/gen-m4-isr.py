@@ -28,6 +28,7 @@ def expand_macros(defs, s):
 
 def parse_irqmap(fname, defs, incpaths):
     d = {}
+    prio = {}
     ifdef = [True] # stack, each bool element indicates if enabled
     linenum = 0
     for line in open(fname):
@@ -86,12 +87,16 @@ def parse_irqmap(fname, defs, incpaths):
 
         line = expand_macros(defs, line)
         p = line
-        if ':' in p: # explicitly named C ISR
+        if ':' in p: # explicitly named C ISR, optionally with a priority
             kv = [s.strip() for s in p.split(':')]
             irq = int(eval(kv[0]))
             if irq in d:
                 raise Exception("line %u: IRQ %u redefined" % (linenum, irq))
             d[irq] = kv[1]
+            if len(kv) > 2:
+                prio[irq] = int(eval(kv[2]))
+                if prio[irq] < 0 or prio[irq] > 0xff:
+                    raise Exception("line %u: invalid priority" % linenum)
         else: # create an ISR stub
             if '-' in p:
                 r = map(int, p.split('-'))
@@ -100,7 +105,7 @@ def parse_irqmap(fname, defs, incpaths):
                 irq_nums = [int(p)]
             for n in irq_nums:
                 d[n] = None
-    return d
+    return d, prio
 
 def dict_entry(s):
     m = re.match(r'([^=]*)(=(.*))?', s)
@@ -136,11 +141,12 @@ args = parser.parse_args()
 defs = {}
 for d in args.define:
         defs.update(d)
-irqmap = parse_irqmap(args.irqmap, defs, args.include_dir)
+irqmap, irqprio = parse_irqmap(args.irqmap, defs, args.include_dir)
 
 if args.verbose:
     for irq in irqmap:
-        print("%4u: %s" % (irq, irqmap[irq]))
+        print("%4u: %s%s" % (irq, irqmap[irq],
+            " (prio 0x%02x)" % irqprio[irq] if irq in irqprio else ""))
 
 if irqmap is None:
         irqmap = range(0, 240)
@@ -257,6 +263,23 @@ exc%u:
     b exc%u
 """) % (irq, irq))
 
+# With CONFIG_IRQ_STATS, time the ISR with the cycle counter (see irq-stats.h):
+# the timestamp is kept in r4, which is callee-saved, so the stub saves it
+irq_stats = defs.get('CONFIG_IRQ_STATS', '0') not in ['', '0']
+if irq_stats:
+    stub_push = "push {r4, lr}"
+    stub_pop = "pop {r4, pc}"
+    stub_call = """bl irq_stats_enter
+    mov r4, r0
+    bl %s
+    mov r0, #%u
+    mov r1, r4
+    bl irq_stats_exit"""
+else:
+    stub_push = "push {r0, r1, lr}"
+    stub_pop = "pop {r0, r1, pc}"
+    stub_call = "bl %s"
+
 for irq in irqmap:
     nvic_icpr_addr = NVIC_BASE + NVIC_ICPR + (irq // 32) * 4
     nvic_icpr_shift = irq % 32
@@ -264,17 +287,18 @@ for irq in irqmap:
         isr = irqmap[irq]
     else:
         isr = "c_isr%u" % irq
+    call = stub_call % ((isr, irq) if irq_stats else isr)
 
     f.write(("""
 .thumb_func
 isr%u:
-    push {r0, r1, lr}
+    %s
 
     mov r1, #%u
     ldr r0, isr%u_fmt_str_addr
     bl printf
 
-    bl %s
+    %s
 
     /* Clear Pending flag */
     ldr r0, isr%u_icpr_addr
@@ -282,14 +306,15 @@ isr%u:
     lsl r1, #%u
     str r1, [r0]
 
-    pop {r0, r1, pc}
+    %s
 
     .align 2
 isr%u_icpr_addr:
     .word 0x%08x
 isr%u_fmt_str_addr:
     .word isr_fmt_str
-""") % (irq, irq, irq, isr, irq, nvic_icpr_shift, irq, nvic_icpr_addr, irq))
+""") % (irq, stub_push, irq, irq, call, irq, nvic_icpr_shift, stub_pop,
+        irq, nvic_icpr_addr, irq))
 
 if len(irqmap) > 0:
     f.write("""
@@ -313,7 +338,17 @@ f.write(
 f.write(
 """
 #include "printf.h"
+#include "nvic.h"
+""")
+
+# Set the priorities given in the map: call after nvic_init, before enabling
+f.write(
+"""
+void irqmap_prio_init(void) {
 """)
+for irq in irqprio:
+    f.write("    nvic_int_set_prio(%u, 0x%02x);\n" % (irq, irqprio[irq]))
+f.write("}\n")
 
 # Create stub ISRs for IRQs for which no ISR func was named
 for irq in irqmap:
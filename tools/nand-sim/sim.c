@@ -0,0 +1,279 @@
+// Test of the SMC NAND driver (drivers/smc-nand.c) and of the read-ahead
+// layer (lib/readahead.c) on the host, against a model of the controller
+// and of a small NAND chip with bad blocks and bit errors. DMA is modeled
+// as an immediate copy from the data port.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blkdev.h"
+#include "dma.h"
+#include "ecc.h"
+#include "readahead.h"
+#include "smc-nand.h"
+
+#define CSR_BASE        0x100000
+#define NAND_BASE       0x4000000
+#define IFACE           1
+
+#define PAGE_SIZE       2048
+#define OOB_SIZE        64
+#define PAGES_PER_BLOCK 8
+#define BLOCKS          32
+#define PAGES           (BLOCKS * PAGES_PER_BLOCK)
+
+static const unsigned bad_blocks[] = { 0, 5, 6, 17 };
+#define NUM_BAD (sizeof(bad_blocks) / sizeof(bad_blocks[0]))
+#define GOOD_PAGES ((BLOCKS - NUM_BAD) * PAGES_PER_BLOCK)
+
+static struct {
+    uint8_t page[PAGES][PAGE_SIZE + OOB_SIZE];
+    uint8_t reg[PAGE_SIZE + OOB_SIZE]; // page register of the chip
+    unsigned column;
+    bool ready;
+    bool ecc_valid;
+    uint32_t ecc_value[4];
+    bool hw_ecc_broken; // controller computes codes that never match
+    unsigned pending_row; // address words still expected
+    unsigned row;
+    unsigned loads, port_reads, dma_reads;
+} m;
+
+static void model_load(unsigned row, unsigned column)
+{
+    memcpy(m.reg, m.page[row], sizeof(m.reg));
+    m.column = column;
+    m.ready = true;
+    m.ecc_valid = false;
+    for (unsigned i = 0; i < PAGE_SIZE / SMC_NAND_ECC_STEP; ++i) {
+        uint8_t code[ECC_512_SIZE];
+        calculate_ecc(m.reg + i * SMC_NAND_ECC_STEP, SMC_NAND_ECC_STEP, code);
+        m.ecc_value[i] = code[0] | (code[1] << 8) | (code[2] << 16) |
+                         (m.hw_ecc_broken ? 0x1 : 0);
+    }
+    m.loads++;
+}
+
+uint32_t smc_nand_model_read(uintptr_t addr)
+{
+    if (addr >= CSR_BASE && addr < CSR_BASE + 0x1000) {
+        unsigned reg = addr - CSR_BASE;
+        if (reg == 0x000) // memc_status
+            return m.ready ? 1 << (5 + IFACE) : 0;
+        unsigned ecc = 0x300 + IFACE * 0x100; // ecc_value0..3 at 0x18
+        if (reg >= ecc + 0x18 && reg < ecc + 0x28)
+            return m.ecc_value[(reg - ecc - 0x18) / 4] |
+                   (m.ecc_valid ? 1u << 30 : 0);
+        return 0;
+    }
+    // data phase
+    uint32_t w;
+    if (m.column + 4 > sizeof(m.reg)) {
+        printf("MODEL: read past end of page\n");
+        exit(1);
+    }
+    memcpy(&w, m.reg + m.column, sizeof(w));
+    m.column += 4;
+    m.port_reads++;
+    if ((addr >> 10) & 1) // ecc_last
+        m.ecc_valid = m.column == PAGE_SIZE;
+    return w;
+}
+
+void smc_nand_model_write(uintptr_t addr, uint32_t val)
+{
+    if (addr >= CSR_BASE && addr < CSR_BASE + 0x1000) {
+        if (addr - CSR_BASE == 0x00c && (val & (1 << (3 + IFACE))))
+            m.ready = false;
+        return;
+    }
+    // command phase: READ0 with address cycles, then READSTART
+    unsigned cycles = (addr >> 21) & 0x7;
+    if (((addr >> 3) & 0xff) != 0x00 || ((addr >> 11) & 0xff) != 0x30) {
+        printf("MODEL: unexpected command at 0x%lx\n", (unsigned long)addr);
+        exit(1);
+    }
+    if (m.pending_row) {
+        m.row |= (val & 0xff) << 16;
+        m.pending_row = 0;
+    } else {
+        m.row = val >> 16;
+        m.column = val & 0xffff;
+        if (cycles > 4) {
+            m.pending_row = 1;
+            return;
+        }
+    }
+    if (m.row >= PAGES) {
+        printf("MODEL: page %u out of range\n", m.row);
+        exit(1);
+    }
+    model_load(m.row, m.column);
+}
+
+struct dma_tx *dma_transfer_fixed_src(struct dma *dma, unsigned chan,
+                                      uint32_t *src, uint32_t *dst, unsigned sz,
+                                      dma_cb_t cb, void *cb_arg)
+{
+    for (unsigned w = 0; w < sz / sizeof(uint32_t); ++w)
+        dst[w] = smc_nand_model_read((uintptr_t)src);
+    m.dma_reads += sz / sizeof(uint32_t);
+    m.port_reads -= sz / sizeof(uint32_t);
+    return (struct dma_tx *)dma;
+}
+
+int dma_wait(struct dma_tx *tx)
+{
+    return 0;
+}
+
+void panic(const char *msg)
+{
+    printf("PANIC: %s\n", msg);
+    exit(1);
+}
+
+static uint8_t pattern(unsigned lpage, unsigned i)
+{
+    return (uint8_t)(lpage * 131 + i * 7 + (i >> 8));
+}
+
+static bool is_bad(unsigned block)
+{
+    for (unsigned i = 0; i < NUM_BAD; ++i)
+        if (bad_blocks[i] == block)
+            return true;
+    return false;
+}
+
+// Program logical pages onto the good blocks, leaving the last good block
+// erased, with codes in the spare area as the image packer would
+static void model_program(void)
+{
+    unsigned lpage = 0;
+    memset(m.page, 0xff, sizeof(m.page));
+    for (unsigned p = 0; p < PAGES; ++p) {
+        unsigned block = p / PAGES_PER_BLOCK;
+        uint8_t *page = m.page[p];
+        if (is_bad(block)) {
+            page[PAGE_SIZE + SMC_NAND_OOB_BBM] = 0x00;
+            continue;
+        }
+        if (lpage >= GOOD_PAGES - PAGES_PER_BLOCK) // erased
+            continue;
+        for (unsigned i = 0; i < PAGE_SIZE; ++i)
+            page[i] = pattern(lpage, i);
+        ecc_calculate_region(page, PAGE_SIZE, SMC_NAND_ECC_STEP,
+                             page + PAGE_SIZE + SMC_NAND_OOB_ECC);
+        lpage++;
+    }
+}
+
+static uint8_t *expected(uint32_t offset, uint32_t len)
+{
+    uint8_t *buf = malloc(len);
+    for (uint32_t i = 0; i < len; ++i) {
+        unsigned lpage = (offset + i) / PAGE_SIZE;
+        buf[i] = lpage >= GOOD_PAGES - PAGES_PER_BLOCK ? 0xff :
+                 pattern(lpage, (offset + i) % PAGE_SIZE);
+    }
+    return buf;
+}
+
+static int failures;
+
+static void check(const char *name, bool ok)
+{
+    printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok)
+        failures++;
+}
+
+static void test_stream(struct blkdev *dev, const char *name,
+                        uint32_t offset, uint32_t len, unsigned misalign)
+{
+    static struct readahead ra;
+    uint8_t *mem = aligned_alloc(DMA_MAX_BURST_BYTES,
+                                 len + DMA_MAX_BURST_BYTES);
+    uint8_t *ref = expected(offset, len);
+    int rc = readahead_read(&ra, dev, offset, mem + misalign, len);
+    check(name, !rc && !memcmp(mem + misalign, ref, len));
+    free(mem);
+    free(ref);
+}
+
+int main()
+{
+    const struct smc_nand_cfg cfg = {
+        .page_size = PAGE_SIZE,
+        .oob_size = OOB_SIZE,
+        .pages_per_block = PAGES_PER_BLOCK,
+        .blocks = BLOCKS,
+        .row_cycles = 2,
+    };
+    struct dma *fake_dmac = (struct dma *)&m;
+    struct smc_nand_stats st;
+    uint8_t page[PAGE_SIZE] __attribute__((aligned(DMA_MAX_BURST_BYTES)));
+    uint8_t *ref;
+    int rc;
+
+    model_program();
+
+    // CPU only
+    struct smc_nand *n = smc_nand_init(CSR_BASE, IFACE, NAND_BASE, &cfg,
+                                       NULL, 0);
+    struct blkdev *dev = smc_nand_blkdev(n);
+    test_stream(dev, "pio: whole device", 0, GOOD_PAGES * PAGE_SIZE, 0);
+    smc_nand_get_stats(n, &st);
+    check("pio: bad blocks skipped", st.bad_blocks == NUM_BAD);
+    check("pio: all pages passed hw ecc", st.hw_ecc_ok == st.pages &&
+          st.pages == GOOD_PAGES);
+    rc = smc_nand_read_page(n, GOOD_PAGES, page);
+    check("pio: read past last good block fails", rc != 0);
+    smc_nand_deinit(n);
+
+    // DMA
+    n = smc_nand_init(CSR_BASE, IFACE, NAND_BASE, &cfg, fake_dmac, 0);
+    dev = smc_nand_blkdev(n);
+    m.port_reads = m.dma_reads = 0;
+    test_stream(dev, "dma: whole device", 0, GOOD_PAGES * PAGE_SIZE, 0);
+    printf("  port words: %u by cpu, %u by dma\n", m.port_reads, m.dma_reads);
+    test_stream(dev, "dma: unaligned range", 3 * PAGE_SIZE + 100,
+                5 * PAGE_SIZE + 33, 0);
+    test_stream(dev, "dma: unaligned destination", PAGE_SIZE,
+                9 * PAGE_SIZE, 4);
+    test_stream(dev, "dma: within one page", 7 * PAGE_SIZE + 10, 300, 0);
+    test_stream(dev, "dma: empty range", 0, 0, 0);
+    smc_nand_deinit(n);
+
+    // Bit errors in the cells: hw ecc mismatches, software corrects
+    n = smc_nand_init(CSR_BASE, IFACE, NAND_BASE, &cfg, fake_dmac, 0);
+    dev = smc_nand_blkdev(n);
+    unsigned phys = 1 * PAGES_PER_BLOCK + 2; // block 0 is bad: logical page 2
+    m.page[phys][700] ^= 0x10;
+    m.page[phys][1500] ^= 0x01;
+    rc = smc_nand_read_page(n, 2, page);
+    ref = expected(2 * PAGE_SIZE, PAGE_SIZE);
+    smc_nand_get_stats(n, &st);
+    check("single-bit errors corrected",
+          !rc && !memcmp(page, ref, PAGE_SIZE) && st.corrected == 2);
+    m.page[phys][701] ^= 0x40; // second error in the same step
+    rc = smc_nand_read_page(n, 2, page);
+    smc_nand_get_stats(n, &st);
+    check("double-bit error detected", rc != 0 && st.uncorrectable == 1);
+    m.page[phys][701] ^= 0x40;
+    m.page[phys][700] ^= 0x10;
+    m.page[phys][1500] ^= 0x01;
+    free(ref);
+
+    // Controller codes never match: every page takes the software path
+    m.hw_ecc_broken = true;
+    test_stream(dev, "sw ecc only: whole device", 0,
+                GOOD_PAGES * PAGE_SIZE, 0);
+    smc_nand_deinit(n);
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
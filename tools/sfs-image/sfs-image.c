@@ -0,0 +1,855 @@
+// Build, inspect and verify Simple File System (SFS) images on the host, and
+// run lib/sfs.c itself against an image in RAM to measure and regression-test
+// mount, lookup and load.
+//
+//   sfs-image pack [-a align] -o image blob:name:load_addr[:entry_offset]...
+//   sfs-image list image
+//   sfs-image verify image
+//   sfs-image sim [-n iters] [-b block_size] image
+//   sfs-image syscfg [-c cfg_word] [-s sfs_offset] -o record
+//                    subsys:name[:flags[:chan]]...
+//   sfs-image syscfg-load record
+//
+// Blobs produced by tools/sfs-lz4.py and tools/sfs-merkle.py are recognized
+// by their magic, and the descriptor flags and checksum are set accordingly
+// (checksum over the uncompressed data, or the root of the manifest).
+//
+// The simulator maps host memory at the load addresses found in the image,
+// so they must be free in the host process (low addresses usually are). It
+// mounts the image both as memory-mapped storage (as SMC SRAM) and through
+// a block device (as NAND), which exercises lib/readahead.c.
+//
+// The syscfg command emits a version 2 boot config record (trch/syscfg.h),
+// which names blobs by hash, and checks it by parsing it back with
+// trch/syscfg.c; syscfg-load parses any record the way TRCH does.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blkdev.h"
+#include "dma.h"
+#include "ecc.h"
+#include "lz4.h"
+#include "sfs.h"
+#include "sha256.h"
+#include "subsys.h"
+#include "syscfg.h"
+
+// On-storage layout: must match lib/sfs.c
+#define FILE_NAME_LENGTH 200
+#define ECC_BLOCK_SIZE 256
+#define SFS_FD_VALID    0x1
+#define SFS_FD_LZ4      0x2
+#define SFS_FD_MERKLE   0x4
+#define SFS_LZ4_MAGIC   0x345a4653 /* "SFZ4" */
+#define SFS_MERKLE_MAGIC 0x4d534653 /* "SFSM" */
+#define MAX_FILES 32
+
+typedef struct {
+    uint32_t valid;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t load_addr;
+    uint32_t load_addr_high;
+    char  name[FILE_NAME_LENGTH];
+    uint32_t entry_offset;
+    uint8_t chcksum[SFS_CHECKSUM_SIZE];
+    uint8_t ecc[ECC_512_SIZE];
+} file_descriptor;
+
+typedef struct {
+    uint32_t low_mark_data;
+    uint32_t high_mark_fd;
+    uint32_t n_files;
+    uint32_t fsize;
+    uint8_t ecc[ECC_512_SIZE];
+} global_table;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t raw_size;
+} lz4_header;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t chunk_size;
+    uint32_t n_chunks;
+    uint32_t data_offset;
+} merkle_header;
+
+#define DEFAULT_ALIGN DMA_MAX_BURST_BYTES
+#define DEFAULT_BLOCK_SIZE 2048
+#define DEFAULT_ITERS 10000
+
+/* Needed by lib/ */
+
+void panic(const char *msg)
+{
+    fprintf(stderr, "PANIC: %s\n", msg);
+    exit(2);
+}
+
+void *mem_vcpy(void *restrict dest, volatile void *restrict src, unsigned n)
+{
+    return memcpy(dest, (void *)src, n);
+}
+
+// The simulator mounts without a DMA controller
+struct dma_tx *dma_transfer(struct dma *dma, unsigned chan,
+                            uint32_t *src, uint32_t *dst, unsigned sz,
+                            dma_cb_t cb, void *cb_arg)
+{
+    return NULL;
+}
+
+int dma_wait(struct dma_tx *tx)
+{
+    return -1;
+}
+
+/* Helpers */
+
+static void *read_file(const char *path, uint32_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    // aligned and padded, for word reads and for the block device
+    uint8_t *buf = aligned_alloc(4096, (sz + 4095) / 4096 * 4096 + 4096);
+    if (!buf || fread(buf, 1, sz, f) != (size_t)sz) {
+        perror(path);
+        fclose(f);
+        free(buf);
+        return NULL;
+    }
+    fclose(f);
+    *size = sz;
+    return buf;
+}
+
+static void print_digest(const uint8_t *d, unsigned n)
+{
+    for (unsigned i = 0; i < n; ++i)
+        printf("%02x", d[i]);
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const char *flags_str(uint32_t valid)
+{
+    if (valid & SFS_FD_LZ4)
+        return "lz4";
+    if (valid & SFS_FD_MERKLE)
+        return "merkle";
+    return "-";
+}
+
+/* Checksum of a blob as stored in the descriptor. Returns the flags for the
+ * descriptor, or -1 if the blob is malformed. */
+static int blob_checksum(const uint8_t *data, uint32_t size, uint8_t *sum,
+                         uint32_t *load_size)
+{
+    uint32_t magic = 0;
+
+    if (size >= sizeof(magic))
+        memcpy(&magic, data, sizeof(magic));
+    if (magic == SFS_LZ4_MAGIC && size >= sizeof(lz4_header)) {
+        lz4_header hdr;
+        memcpy(&hdr, data, sizeof(hdr));
+        uint8_t *raw = malloc(hdr.raw_size + 1);
+        int n = lz4_decompress(raw, hdr.raw_size,
+                               (const uint32_t *)(data + sizeof(hdr)),
+                               size - sizeof(hdr));
+        if (n != hdr.raw_size) {
+            free(raw);
+            return -1;
+        }
+        mbedtls_sha256_ret(raw, hdr.raw_size, sum, 0);
+        free(raw);
+        *load_size = hdr.raw_size;
+        return SFS_FD_LZ4;
+    }
+    if (magic == SFS_MERKLE_MAGIC && size >= sizeof(merkle_header)) {
+        merkle_header hdr;
+        memcpy(&hdr, data, sizeof(hdr));
+        if (hdr.data_offset > size || !hdr.chunk_size ||
+            sizeof(hdr) + hdr.n_chunks * SFS_CHECKSUM_SIZE > hdr.data_offset)
+            return -1;
+        mbedtls_sha256_ret(data + sizeof(hdr),
+                           hdr.n_chunks * SFS_CHECKSUM_SIZE, sum, 0);
+        *load_size = size - hdr.data_offset;
+        return SFS_FD_MERKLE;
+    }
+    mbedtls_sha256_ret(data, size, sum, 0);
+    *load_size = size;
+    return 0;
+}
+
+/* Returns 0 if good, 1 if corrected, -1 if uncorrectable */
+static int check_ecc(void *buf, unsigned len, uint8_t *ecc)
+{
+    struct ecc_region_stats stats = {0};
+    if (ecc_check_region(buf, len, ECC_BLOCK_SIZE, ecc, &stats))
+        return -1;
+    return stats.corrected ? 1 : 0;
+}
+
+/* Parse (and correct) the tables of an image */
+static int parse(uint8_t *img, uint32_t size, global_table *gt,
+                 file_descriptor *fds)
+{
+    int errors = 0;
+
+    if (size < sizeof(*gt)) {
+        fprintf(stderr, "image too small\n");
+        return -1;
+    }
+    memcpy(gt, img, sizeof(*gt));
+    int rc = check_ecc(gt, offsetof(global_table, ecc), gt->ecc);
+    if (rc < 0) {
+        fprintf(stderr, "global table: uncorrectable ECC error\n");
+        return -1;
+    }
+    if (rc > 0)
+        printf("global table: corrected ECC error\n");
+    if (gt->n_files > MAX_FILES ||
+        sizeof(*gt) + gt->n_files * sizeof(file_descriptor) > size) {
+        fprintf(stderr, "bad number of files: %u\n", gt->n_files);
+        return -1;
+    }
+    for (unsigned i = 0; i < gt->n_files; ++i) {
+        file_descriptor *fd = &fds[i];
+        memcpy(fd, img + sizeof(*gt) + i * sizeof(*fd), sizeof(*fd));
+        rc = check_ecc(fd, offsetof(file_descriptor, ecc), fd->ecc);
+        if (rc < 0) {
+            printf("file #%u: uncorrectable ECC error\n", i);
+            fd->valid = 0;
+            errors++;
+        } else if (rc > 0) {
+            printf("file #%u: corrected ECC error\n", i);
+        }
+        fd->name[FILE_NAME_LENGTH - 1] = '\0';
+    }
+    return errors;
+}
+
+/* pack */
+
+static int cmd_pack(int argc, char **argv)
+{
+    const char *out = NULL;
+    uint32_t align = DEFAULT_ALIGN;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:o:")) != -1) {
+        switch (opt) {
+            case 'a': align = strtoul(optarg, NULL, 0); break;
+            case 'o': out = optarg; break;
+            default: return 1;
+        }
+    }
+    unsigned n_files = argc - optind;
+    if (!out || !n_files || n_files > MAX_FILES || !align ||
+        (align & (align - 1)) || align % sizeof(uint32_t)) {
+        fprintf(stderr, "usage: sfs-image pack [-a align] -o image "
+                "blob:name:load_addr[:entry_offset]... (up to %u, "
+                "align a power of 2)\n", MAX_FILES);
+        return 1;
+    }
+
+    global_table gt = {0};
+    file_descriptor fds[MAX_FILES];
+    uint8_t *blobs[MAX_FILES];
+    uint32_t off = sizeof(gt) + n_files * sizeof(file_descriptor);
+
+    memset(fds, 0, sizeof(fds));
+    gt.n_files = n_files;
+    gt.high_mark_fd = off;
+    off = (off + align - 1) & ~(align - 1);
+    gt.low_mark_data = off;
+
+    for (unsigned i = 0; i < n_files; ++i) {
+        char *spec = strdup(argv[optind + i]);
+        char *path = strtok(spec, ":");
+        char *name = strtok(NULL, ":");
+        char *load = strtok(NULL, ":");
+        char *entry = strtok(NULL, ":");
+        file_descriptor *fd = &fds[i];
+        uint32_t load_size;
+
+        if (!path || !name || !load || strlen(name) >= FILE_NAME_LENGTH) {
+            fprintf(stderr, "bad file spec: %s\n", argv[optind + i]);
+            return 1;
+        }
+        blobs[i] = read_file(path, &fd->size);
+        if (!blobs[i])
+            return 1;
+        int flags = blob_checksum(blobs[i], fd->size, fd->chcksum,
+                                  &load_size);
+        if (flags < 0) {
+            fprintf(stderr, "%s: malformed LZ4 or manifest blob\n", path);
+            return 1;
+        }
+        fd->valid = SFS_FD_VALID | flags;
+        fd->offset = off;
+        fd->load_addr = strtoul(load, NULL, 0);
+        fd->entry_offset = entry ? strtoul(entry, NULL, 0) : 0;
+        strcpy(fd->name, name);
+        ecc_calculate_region(fd, offsetof(file_descriptor, ecc),
+                             ECC_BLOCK_SIZE, fd->ecc);
+        off = (off + fd->size + align - 1) & ~(align - 1);
+        free(spec);
+    }
+    gt.fsize = off;
+    ecc_calculate_region(&gt, offsetof(global_table, ecc), ECC_BLOCK_SIZE,
+                         gt.ecc);
+
+    uint8_t *img = calloc(1, gt.fsize);
+    memcpy(img, &gt, sizeof(gt));
+    memcpy(img + sizeof(gt), fds, n_files * sizeof(file_descriptor));
+    for (unsigned i = 0; i < n_files; ++i) {
+        memcpy(img + fds[i].offset, blobs[i], fds[i].size);
+        free(blobs[i]);
+    }
+    FILE *f = fopen(out, "wb");
+    if (!f || fwrite(img, 1, gt.fsize, f) != gt.fsize) {
+        perror(out);
+        return 1;
+    }
+    fclose(f);
+    free(img);
+    printf("%s: %u files, %u bytes\n", out, n_files, gt.fsize);
+    return 0;
+}
+
+/* list */
+
+static int cmd_list(int argc, char **argv)
+{
+    global_table gt;
+    file_descriptor fds[MAX_FILES];
+    uint32_t size;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: sfs-image list image\n");
+        return 1;
+    }
+    uint8_t *img = read_file(argv[1], &size);
+    if (!img || parse(img, size, &gt, fds) < 0)
+        return 1;
+    printf("%u files, data from 0x%x, size %u\n",
+           gt.n_files, gt.low_mark_data, gt.fsize);
+    printf("%-3s %-24s %-8s %-6s %10s %10s %10s %10s  %s\n", "#", "name",
+           "hash", "flags", "offset", "size", "load", "entry", "sha256");
+    for (unsigned i = 0; i < gt.n_files; ++i) {
+        file_descriptor *fd = &fds[i];
+        if (!(fd->valid & SFS_FD_VALID))
+            continue;
+        printf("%-3u %-24s %08x %-6s 0x%08x %10u 0x%08x 0x%08x  ", i,
+               fd->name, sfs_name_hash(fd->name), flags_str(fd->valid), fd->offset, fd->size, fd->load_addr,
+               fd->entry_offset);
+        print_digest(fd->chcksum, 8);
+        printf("...\n");
+    }
+    free(img);
+    return 0;
+}
+
+/* verify */
+
+static int verify_merkle(const file_descriptor *fd, const uint8_t *data)
+{
+    merkle_header hdr;
+    uint8_t digest[SFS_CHECKSUM_SIZE];
+    int bad = 0;
+
+    memcpy(&hdr, data, sizeof(hdr));
+    uint32_t image_size = fd->size - hdr.data_offset;
+    for (unsigned c = 0; c < hdr.n_chunks; ++c) {
+        uint32_t off = c * hdr.chunk_size;
+        uint32_t len = image_size - off < hdr.chunk_size ? image_size - off
+                                                         : hdr.chunk_size;
+        mbedtls_sha256_ret(data + hdr.data_offset + off, len, digest, 0);
+        if (memcmp(digest, data + sizeof(hdr) + c * SFS_CHECKSUM_SIZE,
+                   SFS_CHECKSUM_SIZE)) {
+            printf("%s: chunk %u corrupted\n", fd->name, c);
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static int cmd_verify(int argc, char **argv)
+{
+    global_table gt;
+    file_descriptor fds[MAX_FILES];
+    uint32_t size, load_size;
+    uint8_t sum[SFS_CHECKSUM_SIZE];
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: sfs-image verify image\n");
+        return 1;
+    }
+    uint8_t *img = read_file(argv[1], &size);
+    if (!img)
+        return 1;
+    int errors = parse(img, size, &gt, fds);
+    if (errors < 0)
+        return 1;
+    if (gt.fsize > size) {
+        printf("image truncated: %u < %u bytes\n", size, gt.fsize);
+        errors++;
+    }
+    for (unsigned i = 0; i < gt.n_files; ++i) {
+        file_descriptor *fd = &fds[i];
+        if (!(fd->valid & SFS_FD_VALID))
+            continue;
+        if (fd->offset < gt.high_mark_fd || fd->offset + fd->size > size ||
+            fd->offset + fd->size < fd->offset) {
+            printf("%s: data out of bounds\n", fd->name);
+            errors++;
+            continue;
+        }
+        const uint8_t *data = img + fd->offset;
+        int flags = blob_checksum(data, fd->size, sum, &load_size);
+        if (flags < 0 ||
+            flags != (fd->valid & (SFS_FD_LZ4 | SFS_FD_MERKLE))) {
+            printf("%s: content does not match flags (%s)\n", fd->name,
+                   flags_str(fd->valid));
+            errors++;
+            continue;
+        }
+        if (memcmp(sum, fd->chcksum, SFS_CHECKSUM_SIZE)) {
+            printf("%s: checksum mismatch\n", fd->name);
+            errors++;
+            continue;
+        }
+        if ((fd->valid & SFS_FD_MERKLE) && verify_merkle(fd, data)) {
+            errors++;
+            continue;
+        }
+        printf("%s: ok\n", fd->name);
+    }
+    free(img);
+    printf("%s\n", errors ? "FAILED" : "PASSED");
+    return errors ? 1 : 0;
+}
+
+/* sim */
+
+struct ram_blkdev {
+    const uint8_t *img;
+    unsigned pending; // block in flight
+    uint8_t *buf;
+};
+
+static int ram_read_start(struct blkdev *dev, unsigned block, uint8_t *buf)
+{
+    struct ram_blkdev *rd = dev->priv;
+    rd->pending = block;
+    rd->buf = buf;
+    return 0;
+}
+
+static int ram_read_finish(struct blkdev *dev)
+{
+    struct ram_blkdev *rd = dev->priv;
+    memcpy(rd->buf, rd->img + rd->pending * dev->block_size, dev->block_size);
+    return 0;
+}
+
+static int map_load_regions(const uint8_t *img, const global_table *gt,
+                            const file_descriptor *fds)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    for (unsigned i = 0; i < gt->n_files; ++i) {
+        const file_descriptor *fd = &fds[i];
+        if (!(fd->valid & SFS_FD_VALID))
+            continue;
+        uint32_t size = fd->size;
+        if (fd->valid & SFS_FD_LZ4) { // uncompressed size is in the blob
+            lz4_header hdr;
+            memcpy(&hdr, img + fd->offset, sizeof(hdr));
+            size = hdr.raw_size;
+        }
+        uintptr_t start = fd->load_addr & ~(page - 1);
+        uintptr_t end = ((uintptr_t)fd->load_addr + size + page - 1) &
+                        ~(page - 1);
+        void *p = mmap((void *)start, end - start, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE |
+                       MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED && errno != EEXIST) {
+            fprintf(stderr, "%s: cannot map load address 0x%x on host: %s\n",
+                    fd->name, fd->load_addr, strerror(errno));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_loaded(struct sfs_file *f, const struct sfs_stat *st)
+{
+    uint8_t sum[SFS_CHECKSUM_SIZE];
+
+    if (st->n_chunks) {
+        for (unsigned c = 0; c < st->n_chunks; ++c)
+            if (sfs_verify_chunk(f, c))
+                return 1;
+        return 0;
+    }
+    mbedtls_sha256_ret((const uint8_t *)(uintptr_t)st->load_addr, st->size,
+                       sum, 0);
+    return memcmp(sum, st->chcksum, SFS_CHECKSUM_SIZE) ? 1 : 0;
+}
+
+// Files with any of the @skip flags are expected to be rejected by the mount
+static int sim(const char *mode, struct sfs *fs, const global_table *gt,
+               const file_descriptor *fds, uint32_t skip, unsigned iters,
+               double mount_ns)
+{
+    int errors = 0;
+    unsigned lookups = 0;
+    double t;
+
+    if (!fs) {
+        printf("%s: mount failed\n", mode);
+        return 1;
+    }
+    printf("%s: mount %.1f us\n", mode, mount_ns / 1e3);
+
+    t = now_ns();
+    for (unsigned it = 0; it < iters; ++it) {
+        for (unsigned i = 0; i < gt->n_files; ++i, ++lookups)
+            if ((fds[i].valid & SFS_FD_VALID) &&
+                !sfs_open(fs, fds[i].name) != !!(fds[i].valid & skip))
+                errors++;
+        if (sfs_open(fs, "no-such-file"))
+            errors++;
+        lookups++;
+    }
+    printf("%s: lookup %.1f ns (%u lookups, incl. misses)\n", mode,
+           (now_ns() - t) / lookups, lookups);
+
+    uint32_t hashes[MAX_FILES];
+    for (unsigned i = 0; i < gt->n_files; ++i)
+        hashes[i] = sfs_name_hash(fds[i].name);
+    lookups = 0;
+    t = now_ns();
+    for (unsigned it = 0; it < iters; ++it) {
+        for (unsigned i = 0; i < gt->n_files; ++i, ++lookups)
+            if ((fds[i].valid & SFS_FD_VALID) &&
+                !sfs_open_hash(fs, hashes[i]) != !!(fds[i].valid & skip))
+                errors++;
+    }
+    printf("%s: lookup by hash %.1f ns (%u lookups)\n", mode,
+           (now_ns() - t) / lookups, lookups);
+
+    for (unsigned i = 0; i < gt->n_files; ++i) {
+        struct sfs_stat st;
+        struct sfs_file *f = sfs_open(fs, fds[i].name);
+        if (!f)
+            continue;
+        sfs_stat(f, &st);
+        memset((void *)(uintptr_t)st.load_addr, 0, st.size);
+        t = now_ns();
+        int rc = sfs_read(f, NULL, NULL);
+        double dt = now_ns() - t;
+        bool ok = !rc && !check_loaded(f, &st);
+        printf("%s: load %-24s %10u bytes %8.1f us %8.1f MB/s  %s\n", mode,
+               fds[i].name, st.size, dt / 1e3, st.size / (dt / 1e3),
+               ok ? "ok" : "FAIL");
+        if (!ok)
+            errors++;
+    }
+    sfs_unmount(fs);
+    return errors;
+}
+
+static void async_done(void *arg, int rc)
+{
+    *(int *)arg = rc;
+}
+
+// Without a DMA controller, sfs_read_async loads synchronously, and must
+// verify files with a manifest as sfs_read does: a flipped byte in storage
+// has to fail the load, and the load has to pass again once it is restored.
+static int sim_async_corrupt(uint8_t *img, const global_table *gt,
+                             const file_descriptor *fds)
+{
+    struct sfs *fs = sfs_mount(img, NULL);
+    int errors = 0;
+
+    if (!fs)
+        return 1;
+    for (unsigned i = 0; i < gt->n_files; ++i) {
+        if (!(fds[i].valid & SFS_FD_MERKLE))
+            continue;
+        const merkle_header *hdr = (const merkle_header *)(img + fds[i].offset);
+        uint8_t *byte = img + fds[i].offset + hdr->data_offset;
+        struct sfs_file *f = sfs_open(fs, fds[i].name);
+        int bad = -1, good = -1;
+
+        *byte ^= 0x1;
+        sfs_read_async(f, /* chan */ 0, async_done, &bad);
+        *byte ^= 0x1;
+        sfs_read_async(f, /* chan */ 0, async_done, &good);
+        bool ok = bad > 0 && good == 0;
+        printf("mem: async load %-24s corrupted chunk rejected  %s\n",
+               fds[i].name, ok ? "ok" : "FAIL");
+        if (!ok)
+            errors++;
+    }
+    sfs_unmount(fs);
+    return errors;
+}
+
+static int cmd_sim(int argc, char **argv)
+{
+    unsigned iters = DEFAULT_ITERS;
+    unsigned block_size = DEFAULT_BLOCK_SIZE;
+    global_table gt;
+    file_descriptor fds[MAX_FILES];
+    uint32_t size;
+    int opt;
+    double t;
+
+    while ((opt = getopt(argc, argv, "n:b:")) != -1) {
+        switch (opt) {
+            case 'n': iters = strtoul(optarg, NULL, 0); break;
+            case 'b': block_size = strtoul(optarg, NULL, 0); break;
+            default: return 1;
+        }
+    }
+    if (optind + 1 != argc || !block_size ||
+        block_size % DMA_MAX_BURST_BYTES) {
+        fprintf(stderr, "usage: sfs-image sim [-n iters] [-b block_size] "
+                "image (block size a multiple of %u)\n", DMA_MAX_BURST_BYTES);
+        return 1;
+    }
+    uint8_t *img = read_file(argv[optind], &size);
+    if (!img || parse(img, size, &gt, fds) < 0 || map_load_regions(img, &gt, fds))
+        return 1;
+
+    int errors = 0;
+    t = now_ns();
+    struct sfs *fs = sfs_mount(img, NULL);
+    errors += sim("mem", fs, &gt, fds, 0, iters, now_ns() - t);
+    errors += sim_async_corrupt(img, &gt, fds);
+
+    uint32_t padded = (size + block_size - 1) / block_size * block_size;
+    uint8_t *blk_img = calloc(1, padded);
+    memcpy(blk_img, img, size);
+    struct ram_blkdev rd = { .img = blk_img };
+    struct blkdev dev = {
+        .priv = &rd,
+        .name = "ram",
+        .block_size = block_size,
+        .num_blocks = padded / block_size,
+        .read_start = ram_read_start,
+        .read_finish = ram_read_finish,
+    };
+    t = now_ns();
+    fs = sfs_mount_blk(&dev, 0);
+    errors += sim("blk", fs, &gt, fds, SFS_FD_LZ4, iters, now_ns() - t);
+
+    free(blk_img);
+    free(img);
+    printf("%s\n", errors ? "FAILED" : "PASSED");
+    return errors ? 1 : 0;
+}
+
+/* syscfg */
+
+static int parse_blob_spec(const char *arg, struct syscfg_blob *b)
+{
+    char *spec = strdup(arg);
+    char *subsys = strtok(spec, ":");
+    char *name = strtok(NULL, ":");
+    char *flags = strtok(NULL, ":");
+    char *chan = strtok(NULL, ":");
+    int rc = 0;
+
+    b->subsys = SUBSYS_INVALID;
+    if (subsys && !strcmp(subsys, "RTPS_R52"))
+        b->subsys = SUBSYS_RTPS_R52;
+    else if (subsys && !strcmp(subsys, "RTPS_A53"))
+        b->subsys = SUBSYS_RTPS_A53;
+    else if (subsys && !strcmp(subsys, "HPPS"))
+        b->subsys = SUBSYS_HPPS;
+    if (b->subsys == SUBSYS_INVALID || !name ||
+        strlen(name) >= FILE_NAME_LENGTH) {
+        rc = -1;
+        goto out;
+    }
+    b->hash = sfs_name_hash(name);
+    b->name = NULL;
+    b->flags = SYSCFG_BLOB_VERIFY | SYSCFG_BLOB_WARM; // as v1
+    if (flags && strcmp(flags, "-")) {
+        b->flags = 0;
+        for (const char *c = flags; *c; ++c) {
+            switch (*c) {
+                case 'v': b->flags |= SYSCFG_BLOB_VERIFY; break;
+                case 'c': b->flags |= SYSCFG_BLOB_COMPRESSED; break;
+                case 'w': b->flags |= SYSCFG_BLOB_WARM; break;
+                default: rc = -1; goto out;
+            }
+        }
+    } else if (flags) {
+        b->flags = 0;
+    }
+    b->chan = SYSCFG_BLOB_CHAN_ANY;
+    if (chan) {
+        b->chan = strtoul(chan, NULL, 0);
+        if (b->chan >= SYSCFG_BLOB_CHAN_ANY)
+            rc = -1;
+    }
+out:
+    free(spec);
+    return rc;
+}
+
+static int cmd_syscfg(int argc, char **argv)
+{
+    const char *out = NULL;
+    uint32_t cfg_word = 0, sfs_offset = 0;
+    bool have_sfs_offset = false;
+    struct syscfg_blob blobs[SYSCFG_MAX_BLOBS];
+    struct syscfg *cfg;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:s:o:")) != -1) {
+        switch (opt) {
+            case 'c': cfg_word = strtoul(optarg, NULL, 0); break;
+            case 's':
+                sfs_offset = strtoul(optarg, NULL, 0);
+                have_sfs_offset = true;
+                break;
+            case 'o': out = optarg; break;
+            default: return 1;
+        }
+    }
+    unsigned num_blobs = argc - optind;
+    if (!out || num_blobs > SYSCFG_MAX_BLOBS) {
+        fprintf(stderr, "usage: sfs-image syscfg [-c cfg_word] "
+                "[-s sfs_offset] -o record subsys:name[:flags[:chan]]... "
+                "(up to %u; subsys RTPS_R52, RTPS_A53 or HPPS; flags of "
+                "v(erify), c(ompressed), w(arm), or -; default vw)\n",
+                SYSCFG_MAX_BLOBS);
+        return 1;
+    }
+    if (have_sfs_offset)
+        cfg_word |= SYSCFG__HAVE_SFS_OFFSET__MASK;
+
+    unsigned words = SYSCFG_V2__BLOBS__WORD + num_blobs * SYSCFG_V2__BLOB__WORDS;
+    uint32_t *rec = calloc(words, sizeof(uint32_t));
+    rec[0] = SYSCFG_V2__MAGIC;
+    rec[SYSCFG_V2__CFG__WORD] = cfg_word;
+    rec[SYSCFG_V2__SFS_OFFSET__WORD] = sfs_offset;
+    rec[SYSCFG_V2__NUM_BLOBS__WORD] = num_blobs;
+    for (unsigned i = 0; i < num_blobs; ++i) {
+        struct syscfg_blob *b = &blobs[i];
+        uint32_t *entry = rec + SYSCFG_V2__BLOBS__WORD +
+                          i * SYSCFG_V2__BLOB__WORDS;
+        if (parse_blob_spec(argv[optind + i], b)) {
+            fprintf(stderr, "bad blob spec: %s\n", argv[optind + i]);
+            return 1;
+        }
+        entry[0] = b->hash;
+        entry[1] = (b->subsys << SYSCFG_V2__BLOB_SUBSYS__SHIFT) |
+                   (b->chan << SYSCFG_V2__BLOB_CHAN__SHIFT) |
+                   (b->flags << SYSCFG_V2__BLOB_FLAGS__SHIFT);
+    }
+
+    // Round trip: parse the record back the way TRCH will
+    cfg = calloc(1, sizeof(*cfg));
+    if (syscfg_load(cfg, (uint8_t *)rec)) {
+        fprintf(stderr, "%s: record rejected by syscfg_load\n", out);
+        return 1;
+    }
+    int errors = cfg->version != 2 || cfg->num_blobs != num_blobs ||
+                 cfg->sfs_offset != sfs_offset ||
+                 cfg->have_sfs_offset != have_sfs_offset;
+    for (unsigned i = 0; i < num_blobs && i < cfg->num_blobs; ++i) {
+        struct syscfg_blob *b = &cfg->blobs[i];
+        if (b->hash != blobs[i].hash || b->subsys != blobs[i].subsys ||
+            b->chan != blobs[i].chan || b->flags != blobs[i].flags) {
+            fprintf(stderr, "blob %u: parsed back differently\n", i);
+            errors++;
+        }
+    }
+    free(cfg);
+    if (errors) {
+        fprintf(stderr, "%s: round trip through syscfg_load FAILED\n", out);
+        return 1;
+    }
+
+    FILE *f = fopen(out, "wb");
+    if (!f || fwrite(rec, sizeof(uint32_t), words, f) != words) {
+        perror(out);
+        return 1;
+    }
+    fclose(f);
+    free(rec);
+    printf("%s: v2 record, %u blobs, %u bytes\n", out, num_blobs,
+           words * (unsigned)sizeof(uint32_t));
+    return 0;
+}
+
+static int cmd_syscfg_load(int argc, char **argv)
+{
+    struct syscfg *cfg;
+    uint32_t size;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: sfs-image syscfg-load record\n");
+        return 1;
+    }
+    uint8_t *rec = read_file(argv[1], &size);
+    if (!rec)
+        return 1;
+    cfg = calloc(1, sizeof(*cfg));
+    int rc = syscfg_load(cfg, rec);
+    if (rc)
+        fprintf(stderr, "%s: rejected: %d\n", argv[1], rc);
+    free(cfg);
+    free(rec);
+    return rc ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "pack"))
+        return cmd_pack(argc - 1, argv + 1);
+    if (argc >= 2 && !strcmp(argv[1], "list"))
+        return cmd_list(argc - 1, argv + 1);
+    if (argc >= 2 && !strcmp(argv[1], "verify"))
+        return cmd_verify(argc - 1, argv + 1);
+    if (argc >= 2 && !strcmp(argv[1], "sim"))
+        return cmd_sim(argc - 1, argv + 1);
+    if (argc >= 2 && !strcmp(argv[1], "syscfg"))
+        return cmd_syscfg(argc - 1, argv + 1);
+    if (argc >= 2 && !strcmp(argv[1], "syscfg-load"))
+        return cmd_syscfg_load(argc - 1, argv + 1);
+    fprintf(stderr, "usage: sfs-image pack|list|verify|sim|syscfg|"
+            "syscfg-load ...\n");
+    return 1;
+}
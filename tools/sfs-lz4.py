@@ -0,0 +1,123 @@
+#!/usr/bin/python
+
+# Compress a blob for storage in the Simple File System (SFS).
+#
+# Output is the format loaded by lib/sfs.c for files whose descriptor has
+# the SFS_FD_LZ4 flag set: a header (magic, uncompressed size; both 32-bit
+# little-endian) followed by one LZ4 block (raw block format, no frame).
+#
+# The SHA-256 checksum in the file descriptor must be computed over the
+# uncompressed data, since that is what ends up in memory (it is printed).
+
+import argparse
+import hashlib
+import struct
+import sys
+
+SFS_LZ4_MAGIC = 0x345a4653 # "SFZ4"
+
+MIN_MATCH = 4
+MAX_OFFSET = 0xffff
+LAST_LITERALS = 5   # per LZ4 spec: last 5 bytes are always literals
+MFLIMIT = 12        # per LZ4 spec: last match must start before this
+
+def emit_len(out, n):
+    while n >= 0xff:
+        out.append(0xff)
+        n -= 0xff
+    out.append(n)
+
+def emit_seq(out, lits, match_len, offset):
+    lit_len = len(lits)
+    token = (min(lit_len, 0xf) << 4)
+    if match_len:
+        token |= min(match_len - MIN_MATCH, 0xf)
+    out.append(token)
+    if lit_len >= 0xf:
+        emit_len(out, lit_len - 0xf)
+    out.extend(lits)
+    if match_len:
+        out.extend(struct.pack('<H', offset))
+        if match_len - MIN_MATCH >= 0xf:
+            emit_len(out, match_len - MIN_MATCH - 0xf)
+
+def compress(data):
+    data = bytearray(data)
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    limit = n - MFLIMIT
+    while i < limit:
+        seq = bytes(data[i:i + MIN_MATCH])
+        cand = table.get(seq)
+        table[seq] = i
+        if cand is None or i - cand > MAX_OFFSET:
+            i += 1
+            continue
+        end = n - LAST_LITERALS
+        m = MIN_MATCH
+        while i + m < end and data[cand + m] == data[i + m]:
+            m += 1
+        emit_seq(out, data[anchor:i], m, i - cand)
+        i += m
+        anchor = i
+    emit_seq(out, data[anchor:], 0, 0)
+    return out
+
+def decompress(block, raw_size):
+    out = bytearray()
+    pos = [0]
+    def read_byte():
+        b = block[pos[0]]
+        pos[0] += 1
+        return b
+    def read_len(n):
+        if n != 0xf:
+            return n
+        while True:
+            b = read_byte()
+            n += b
+            if b != 0xff:
+                return n
+    while pos[0] < len(block):
+        token = read_byte()
+        lit_len = read_len(token >> 4)
+        out.extend(block[pos[0]:pos[0] + lit_len])
+        pos[0] += lit_len
+        if pos[0] >= len(block):
+            break
+        offset = read_byte() | (read_byte() << 8)
+        match_len = read_len(token & 0xf) + MIN_MATCH
+        for _ in range(match_len):
+            out.append(out[-offset])
+    if len(out) != raw_size:
+        raise Exception("size mismatch after decompression: %u != %u" %
+                        (len(out), raw_size))
+    return out
+
+parser = argparse.ArgumentParser(
+    description="Compress a blob for SFS (LZ4 block with SFS header)")
+parser.add_argument('input',
+    help='Uncompressed blob')
+parser.add_argument('output',
+    help='Output file to be stored in SFS with the LZ4 flag set')
+parser.add_argument('--verify', action='store_true',
+    help='Decompress the output and compare against the input')
+args = parser.parse_args()
+
+raw = bytearray(open(args.input, 'rb').read())
+block = compress(raw)
+if args.verify and decompress(block, len(raw)) != raw:
+    print("ERROR: verification failed")
+    sys.exit(1)
+
+with open(args.output, 'wb') as f:
+    f.write(struct.pack('<II', SFS_LZ4_MAGIC, len(raw)))
+    f.write(block)
+
+stored = len(block) + 8
+print("%s: %u -> %u bytes (%.1f%%)" % (args.input, len(raw), stored,
+      100.0 * stored / len(raw) if len(raw) else 0))
+print("sha256 (uncompressed): %s" % hashlib.sha256(raw).hexdigest())
@@ -0,0 +1,64 @@
+#!/usr/bin/python
+
+# Add a hash-tree manifest to a blob for storage in the Simple File System.
+#
+# Output is the format loaded by lib/sfs.c for files whose descriptor has
+# the SFS_FD_MERKLE flag set: a header (magic, chunk size, number of chunks,
+# offset of the image; all 32-bit little-endian), one SHA-256 digest per
+# chunk of the image, padding, and then the image itself.
+#
+# The SHA-256 checksum in the file descriptor must be set to the root, i.e.
+# the SHA-256 over the concatenated chunk digests (it is printed). The loader
+# checks each chunk as it arrives, and can re-check any subset of chunks.
+
+import argparse
+import hashlib
+import struct
+import sys
+
+SFS_MERKLE_MAGIC = 0x4d534653 # "SFSM"
+HEADER_SIZE = 16
+DIGEST_SIZE = 32
+DATA_ALIGN = 256 # DMA burst (DMA_MAX_BURST_BYTES)
+
+def align(n, a):
+    return (n + a - 1) // a * a
+
+def manifest(data, chunk_size):
+    digests = []
+    for off in range(0, len(data), chunk_size):
+        digests.append(hashlib.sha256(data[off:off + chunk_size]).digest())
+    return digests
+
+def chunk_size_arg(s):
+    n = int(s, 0)
+    if n < DATA_ALIGN or n & (n - 1):
+        raise argparse.ArgumentTypeError(
+            "must be a power of 2 and at least %u" % DATA_ALIGN)
+    return n
+
+parser = argparse.ArgumentParser(
+    description="Add a hash-tree manifest to a blob for SFS")
+parser.add_argument('input',
+    help='Blob')
+parser.add_argument('output',
+    help='Output file to be stored in SFS with the MERKLE flag set')
+parser.add_argument('--chunk-size', type=chunk_size_arg, default=64 * 1024,
+    help='Bytes of blob covered by each digest (power of 2)')
+args = parser.parse_args()
+
+data = bytearray(open(args.input, 'rb').read())
+digests = manifest(data, args.chunk_size)
+data_offset = align(HEADER_SIZE + DIGEST_SIZE * len(digests), DATA_ALIGN)
+
+with open(args.output, 'wb') as f:
+    f.write(struct.pack('<IIII', SFS_MERKLE_MAGIC, args.chunk_size,
+                        len(digests), data_offset))
+    for d in digests:
+        f.write(d)
+    f.write(b'\0' * (data_offset - HEADER_SIZE - DIGEST_SIZE * len(digests)))
+    f.write(data)
+
+print("%s: %u bytes in %u chunks of %u bytes (+%u bytes manifest)" %
+      (args.input, len(data), len(digests), args.chunk_size, data_offset))
+print("sha256 (root): %s" % hashlib.sha256(b''.join(digests)).hexdigest())
@@ -9,6 +9,7 @@
 #include "console.h"
 #include "hwinfo.h"
 #include "debug.h"
+#include "ecc-eng.h"
 #include "smc.h"
 #include "sha256.h"
 #include "panic.h"
@@ -25,6 +26,17 @@
 
 #define SHA256_CHECKSUM_SIZE 32
 
+#define ECC_GROUP_BYTES (ECC_GROUP_DATA_WORDS * sizeof(uint32_t))
+#if CONFIG_BL1_ECC
+/* The config blob and the BL1 image are stored ECC-encoded (see ecc-eng.h):
+ * data offset off (a multiple of ECC_GROUP_BYTES) is at STORAGE_OFFSET(off) */
+#define STORAGE_OFFSET(off) \
+    ((off) / ECC_GROUP_BYTES * ECC_GROUP_WORDS * sizeof(uint32_t))
+#else /* !CONFIG_BL1_ECC */
+#define STORAGE_OFFSET(off) (off)
+#endif /* !CONFIG_BL1_ECC */
+#define LOAD_CHUNK_SIZE 0x1000 /* granularity of interleaving copy and hash */
+
 /* Do not use global variable.
  * Currently, global variable is not ready for relocation
  */
@@ -76,6 +88,20 @@ static uint32_t blob_offsets[NUM_BLOB_COPIES] = {
     CONFIG_CFG_ADDR_1
 };
 
+/* Optional hash-tree manifest in front of the BL1 image, in the format of
+ * tools/sfs-merkle.py: if present, bl1_offset points to this header, the
+ * image follows at data_offset, bl1_size is the size of the image, and the
+ * checksum in the config blob is the root (SHA-256 over chunk digests). */
+#define BL1_MERKLE_MAGIC 0x4d534653 /* "SFSM" */
+typedef struct {
+    uint32_t magic;
+    uint32_t chunk_size;
+    uint32_t n_chunks;
+    uint32_t data_offset;
+} bl1_manifest;
+
+#define MAX_BL1_SRCS (NUM_FAILOVER_MEM_RANKS * NUM_BLOB_COPIES)
+
 typedef struct {
     uint32_t bl1_size;
     uint32_t bl1_offset;     /* where copies of bl1 image is stored in NVRAM */
@@ -114,65 +140,57 @@ static inline int diff_checksum(unsigned char * a, unsigned char * b) {
     return 0;
 }
 
-#define ECC_ENG_DECODE_INPUT_REG0 	0x30006500
-#define ECC_ENG_DECODE_INPUT_REG1 	0x30006504
-#define ECC_ENG_DECODE_OUTPUT_REG 	0x30006508
-#define ECC_ENG_ENCODE_INPUT_REG 	0x30006510
-#define ECC_ENG_ENCODE_OUTPUT_REG0 	0x30006514
-#define ECC_ENG_ENCODE_OUTPUT_REG1 	0x30006518
-#define ECC_ENG_DECODE_STATUS_REG 	0x30006520
-
-#define ECC_DECODE_DONE	0x2
-
+/* Without the engine's code (ecc_eng_learn failed), the engine's output is
+ * taken as is, and there is nothing to fall back to if it stops responding */
+static int ecc_decode(const struct ecc_code *ecc, uint32_t *dst,
+                      uint32_t *src, unsigned nwords, struct ecc_stats *stats)
+{
+    const struct ecc_code *code = ecc->learned ? ecc : NULL;
+    struct ecc_stats eng_stats = {0};
+    int rc = ecc_eng_decode(ECC_ENG_BASE, code, dst, src, nwords, &eng_stats);
+    if (rc == ECC_ENG_TIMEOUT) {
+        if (!code) {
+            DPRINTF("BL0: ECC engine not responding\r\n");
+            return -1;
+        }
+        DPRINTF("BL0: ECC engine not responding, decoding in software\r\n");
+        return ecc_sw_decode(code, dst, src, nwords, stats);
+    }
+    stats->words += eng_stats.words;
+    stats->corrected += eng_stats.corrected;
+    stats->uncorrectable += eng_stats.uncorrectable;
+    return rc;
+}
 
-#define ECC_LENGTH	4  /* for debugging only. Actual value is 5 */
 /* load_memcpy_ecc():
-    copied and modified from lib/sfs.c */
-static int load_memcpy_ecc(uint32_t *mem_addr, uint32_t *load_addr, unsigned size, bool apply_ecc)
+    copied and modified from lib/sfs.c
+    With ECC (ecc not NULL), mem_addr holds size bytes of data in the layout
+    described in ecc-eng.h, i.e. it occupies 5/4 of size in storage. */
+static int load_memcpy_ecc(uint32_t *mem_addr, uint32_t *load_addr, unsigned size,
+                           const struct ecc_code *ecc)
 {
     unsigned w, b;
 
     uint32_t nwords = size / sizeof(uint32_t);
 
-    if (apply_ecc) {
-        uint32_t * ecc_eng_decode_input0 = (uint32_t *)ECC_ENG_DECODE_INPUT_REG0; 
-        uint32_t * ecc_eng_decode_input1 = (uint32_t *)ECC_ENG_DECODE_INPUT_REG1; 
-        uint32_t volatile * ecc_eng_decode_output = (uint32_t *)ECC_ENG_DECODE_OUTPUT_REG; 
-        uint32_t volatile * ecc_eng_decode_status = (uint32_t *)ECC_ENG_DECODE_STATUS_REG; 
-	//
-        /* assume 
-         *  1. all data + ECC stored at mem_addr is of size which is a multiple of 5
-         *  2. all data store at mem_addr is a multiple of 4
-         */
-        uint8_t * s_ptr = (uint8_t *)mem_addr;
-        uint32_t buff[2];
-        uint8_t * ptr_buff = (uint8_t *)&buff[0];
-    
-        /* every 5 32-bit words have 4 32-bit data and 1 32-bit ECC */
-        for (w = 0; w < nwords; w++, load_addr++, mem_addr++) {
-            /* read ECC_LENGTH bytes from mem_addr and write the data into ECC engine */
-            int i;
-            for (i = 0; i < ECC_LENGTH; i++, s_ptr++)
-                ptr_buff[i] = *s_ptr;
-#if 1
-	    uint32_t t_status = *ecc_eng_decode_status;
-            *ecc_eng_decode_input0 = buff[0];
-            *ecc_eng_decode_input1 = buff[1];
-            while (*ecc_eng_decode_status != t_status + 1) {
-                DPRINTF("Wait, status = 0x%x\r\n", *ecc_eng_decode_status);
-            }
-	    t_status = *ecc_eng_decode_status;
-            /* read 4 bytes from ecc_eng_decode_input_out and write it to mem_addr */
-            * load_addr = * ecc_eng_decode_output;
-	    if (*ecc_eng_decode_input0 != * ecc_eng_decode_output)
-                DPRINTF("Error: 0x%x != 0x%x at 0x%x-th word over total 0x%x words\r\n", * ecc_eng_decode_input0, * ecc_eng_decode_output, w, nwords);
-#else
-            *ecc_eng_decode_input0 = buff[0];
-            *ecc_eng_decode_input1 = buff[1]; 
-            * load_addr = buff[0];
-	    if (buff[0] != * mem_addr) DPRINTF("buff[0] = 0x%x != * mem_addr = 0x%x\r\n", buff[0], *mem_addr);
-#endif
+    if (ecc) {
+        struct ecc_stats stats = {0};
+        uint32_t tail[ECC_GROUP_DATA_WORDS];
+        unsigned groups = size / ECC_GROUP_BYTES;
+        unsigned rem_bytes = size % ECC_GROUP_BYTES;
+        int rc = ecc_decode(ecc, load_addr, mem_addr,
+                            groups * ECC_GROUP_DATA_WORDS, &stats);
+        if (!rc && rem_bytes) { /* last group is partly used: decode aside */
+            rc = ecc_decode(ecc, tail, mem_addr + groups * ECC_GROUP_WORDS,
+                            (rem_bytes + 3) / sizeof(uint32_t), &stats);
+            uint8_t *load_addr_8 =
+                (uint8_t *)(load_addr + groups * ECC_GROUP_DATA_WORDS);
+            for (b = 0; b < rem_bytes; b++)
+                load_addr_8[b] = ((uint8_t *)tail)[b];
         }
+        DPRINTF("BL0: ECC: %u words: %u corrected, %u uncorrectable\r\n",
+                stats.words, stats.corrected, stats.uncorrectable);
+        return rc;
     }
     else {
         uint32_t rem_bytes = (size) % sizeof(uint32_t);
@@ -193,6 +211,190 @@ static int load_memcpy_ecc(uint32_t *mem_addr, uint32_t *load_addr, unsigned siz
         return 0;
 }
     
+/* load_bl1():
+    Load the BL1 image straight to its final address, in one pass, hashing
+    each chunk as it lands. The first VECTOR_TABLE_SIZE bytes are held back in
+    vtbl instead, because BL1's vector table may go where the vector table
+    that BL0 is still using is; the caller installs them right before jump.
+    Returns the number of bytes held back, or -1 on checksum failure. */
+static int load_bl1(uint8_t *mem_addr, bl0_blob *cfg, uint32_t *vtbl,
+                    const struct ecc_code *ecc)
+{
+    mbedtls_sha256_context ctx;
+    unsigned char output[SHA256_CHECKSUM_SIZE];
+    uint8_t *load_addr = (uint8_t *)cfg->bl1_load_addr;
+    unsigned vtbl_size = cfg->bl1_size < VECTOR_TABLE_SIZE ?
+                            cfg->bl1_size : VECTOR_TABLE_SIZE;
+    unsigned off, n;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, false);
+
+    if (load_memcpy_ecc((uint32_t *)mem_addr, vtbl, vtbl_size, ecc))
+        return -1;
+    mbedtls_sha256_update_ret(&ctx, (unsigned char *)vtbl, vtbl_size);
+
+    for (off = vtbl_size; off < cfg->bl1_size; off += n) {
+        n = cfg->bl1_size - off;
+        if (n > LOAD_CHUNK_SIZE)
+            n = LOAD_CHUNK_SIZE;
+        if (load_memcpy_ecc((uint32_t *)(mem_addr + STORAGE_OFFSET(off)),
+                            (uint32_t *)(load_addr + off), n, ecc))
+            return -1;
+        mbedtls_sha256_update_ret(&ctx, load_addr + off, n);
+    }
+
+    mbedtls_sha256_finish_ret(&ctx, output);
+    if (diff_checksum(output, cfg->checksum))
+        return -1;
+    return vtbl_size;
+}
+
+#if CONFIG_FAILOVER_CHUNKS
+static bool digest_eq(const uint8_t *a, const uint8_t *b)
+{
+    for (int i = 0; i < SHA256_CHECKSUM_SIZE; i++)
+        if (a[i] != b[i])
+            return false;
+    return true;
+}
+
+/* Copies of the config blob that describe the same image (location aside) */
+static bool same_image(bl0_blob *a, bl0_blob *b)
+{
+    return a->bl1_size == b->bl1_size &&
+           a->bl1_load_addr == b->bl1_load_addr &&
+           a->bl1_entry_offset == b->bl1_entry_offset &&
+           digest_eq(a->checksum, b->checksum);
+}
+
+static void copy_hash(mbedtls_sha256_context *ctx, uint8_t *src, uint8_t *dst,
+                      unsigned n)
+{
+    load_memcpy_ecc((uint32_t *)src, (uint32_t *)dst, n, NULL);
+    mbedtls_sha256_update_ret(ctx, dst, n);
+}
+
+/* A copy's manifest is usable if it is consistent with the config blob of
+ * the same copy, and its digests hash to the root in that blob */
+static bool manifest_ok(bl1_manifest *h, bl0_blob *cfg)
+{
+    mbedtls_sha256_context ctx;
+    unsigned char root[SHA256_CHECKSUM_SIZE];
+
+    if (h->magic != BL1_MERKLE_MAGIC || !h->chunk_size ||
+        h->n_chunks != (cfg->bl1_size + h->chunk_size - 1) / h->chunk_size)
+        return false;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, false);
+    mbedtls_sha256_update_ret(&ctx, (unsigned char *)(h + 1),
+                              h->n_chunks * SHA256_CHECKSUM_SIZE);
+    mbedtls_sha256_finish_ret(&ctx, root);
+    return digest_eq(root, cfg->checksum);
+}
+
+/* load_bl1_chunks():
+    Load a BL1 image that has a manifest from all copies at once: chunk by
+    chunk, from the first copy (in failover order) whose chunk matches its
+    digest. A corrupted chunk costs a re-read of that chunk from the next
+    copy, instead of a re-read and re-hash of the whole image, so the worst
+    case stays close to loading one copy. Chunks are placed as in load_bl1.
+    The config and manifest are taken from the first copy whose manifest
+    matches the root in its own config blob; the other copies are used if
+    their config describes the same image.
+    Returns the number of bytes held back in vtbl, -1 if no copy has a valid
+    config and manifest or some chunk is corrupted in all copies, or -2 if
+    the image has no manifest (in both cases, the caller then falls back to
+    loading copy after copy). */
+static int load_bl1_chunks(uint8_t **bases, unsigned n_bases, bl0_blob *cfg,
+                           uint32_t *vtbl)
+{
+    uint8_t *srcs[MAX_BL1_SRCS]; /* image in each copy, or NULL if unusable */
+    bl1_manifest *hdrs[MAX_BL1_SRCS];
+    bl0_blob blobs[MAX_BL1_SRCS];
+    unsigned n_srcs = 0;
+    bl1_manifest *hdr = NULL;
+    const uint8_t *digests = NULL;
+    unsigned i, j, c;
+
+    for (i = 0; i < n_bases; i++) {
+        for (j = 0; j < NUM_BLOB_COPIES; j++) {
+            bl0_blob *blob = &blobs[n_srcs];
+            if (load_memcpy_ecc((uint32_t *)(bases[i] + blob_offsets[j]),
+                                (uint32_t *)blob, sizeof(*blob), NULL))
+                continue;
+            hdrs[n_srcs++] = (bl1_manifest *)(bases[i] + blob->bl1_offset);
+        }
+    }
+    for (i = 0; i < n_srcs && hdrs[i]->magic != BL1_MERKLE_MAGIC; i++)
+        ;
+    if (i == n_srcs)
+        return -2;
+
+    for (i = 0; i < n_srcs && !hdr; i++) {
+        if (!manifest_ok(hdrs[i], &blobs[i])) {
+            DPRINTF("BL0: manifest in copy %u does not match its root\r\n", i);
+            continue;
+        }
+        *cfg = blobs[i];
+        hdr = hdrs[i];
+        digests = (const uint8_t *)(hdr + 1);
+    }
+    if (!hdr) {
+        DPRINTF("BL0: config or manifest corrupted in all copies\r\n");
+        return -1;
+    }
+    show_config(cfg);
+
+    for (i = 0; i < n_srcs; i++) {
+        bl1_manifest *h = hdrs[i];
+        srcs[i] = same_image(&blobs[i], cfg) &&
+                  h->magic == hdr->magic && h->chunk_size == hdr->chunk_size &&
+                  h->n_chunks == hdr->n_chunks &&
+                  h->data_offset == hdr->data_offset ?
+                        (uint8_t *)h + h->data_offset : NULL;
+    }
+
+    uint8_t *load_addr = (uint8_t *)cfg->bl1_load_addr;
+    unsigned vtbl_size = cfg->bl1_size < VECTOR_TABLE_SIZE ?
+                            cfg->bl1_size : VECTOR_TABLE_SIZE;
+    DPRINTF("BL0: load BL1 image from %u copies to (0x%x), size(0x%x), "
+            "%u chunks\r\n", n_srcs, load_addr, cfg->bl1_size, hdr->n_chunks);
+
+    for (c = 0; c < hdr->n_chunks; c++) {
+        unsigned off = c * hdr->chunk_size;
+        unsigned n = cfg->bl1_size - off < hdr->chunk_size ?
+                        cfg->bl1_size - off : hdr->chunk_size;
+        unsigned held = off >= vtbl_size ? 0 :
+                        vtbl_size - off < n ? vtbl_size - off : n;
+
+        for (i = 0; i < n_srcs; i++) {
+            mbedtls_sha256_context ctx;
+            unsigned char output[SHA256_CHECKSUM_SIZE];
+            if (!srcs[i])
+                continue;
+            mbedtls_sha256_init(&ctx);
+            mbedtls_sha256_starts_ret(&ctx, false);
+            if (held)
+                copy_hash(&ctx, srcs[i] + off, (uint8_t *)vtbl + off, held);
+            if (n > held)
+                copy_hash(&ctx, srcs[i] + off + held,
+                          load_addr + off + held, n - held);
+            mbedtls_sha256_finish_ret(&ctx, output);
+            if (digest_eq(output, digests + c * SHA256_CHECKSUM_SIZE))
+                break;
+            DPRINTF("BL0: chunk %u corrupted in copy %u\r\n", c, i);
+        }
+        if (i == n_srcs) {
+            DPRINTF("BL0: chunk %u corrupted in all copies\r\n", c);
+            return -1;
+        }
+    }
+    DPRINTF("BL0: checksum success\r\n");
+    return vtbl_size;
+}
+#endif /* CONFIG_FAILOVER_CHUNKS */
+
 static int parity_check(uint8_t data)
 {
     int i, j, count;
@@ -298,11 +500,35 @@ int main_relocated ( void )
     /* load configuration blob */
     DPRINTF("BL0: read configuration blob\r\n");
     bl0_blob config_blob;
+    uint32_t bl1_vtbl[VECTOR_TABLE_SIZE / sizeof(uint32_t)];
+    int bl1_vtbl_size;
     int i, j;
     int mem_ranks_trial = failover ? NUM_FAILOVER_MEM_RANKS : 1;
     int curr_mem_chip = mem_chip;
-
-    for (i = 0; i < mem_ranks_trial; i++) {
+    bool loaded = false;
+#if CONFIG_BL1_ECC
+    struct ecc_code ecc_code; /* not global: BL0 runs relocated */
+    struct ecc_code *ecc = &ecc_code;
+    if (ecc_eng_learn(ECC_ENG_BASE, ecc))
+        DPRINTF("BL0: ECC: engine's code unknown: no software fallback, "
+                "uncorrectable words not detected\r\n");
+#else /* !CONFIG_BL1_ECC */
+    struct ecc_code *ecc = NULL;
+#endif /* !CONFIG_BL1_ECC */
+
+#if CONFIG_FAILOVER_CHUNKS
+    uint8_t *mem_bases[NUM_FAILOVER_MEM_RANKS];
+    mem_bases[0] = get_smc_sram_rank_addr(smc, mem_chip);
+    if (mem_ranks_trial > 1)
+        mem_bases[1] = get_smc_sram_rank_addr(smc, mem_chip_backup);
+    bl1_vtbl_size = load_bl1_chunks(mem_bases, mem_ranks_trial,
+                                    &config_blob, bl1_vtbl);
+    if (bl1_vtbl_size == -1)
+        DPRINTF("BL0: chunked load failed, loading copy after copy\r\n");
+    loaded = bl1_vtbl_size >= 0; /* else, no manifest, or failed */
+#endif /* CONFIG_FAILOVER_CHUNKS */
+
+    for (i = 0; !loaded && i < mem_ranks_trial; i++) {
         mem_base_addr = get_smc_sram_rank_addr(smc, curr_mem_chip);
         /* 
            fail-over within a memory rank. 
@@ -314,34 +540,19 @@ int main_relocated ( void )
             DPRINTF("BL0: cp config_blob from 0x%x to %p\r\n",
                    mem_addr, &config_blob);
             if (load_memcpy_ecc((uint32_t *)(mem_addr), (uint32_t *)&config_blob,
-                        sizeof(config_blob), false)) {
+                        sizeof(config_blob), ecc)) {
                 DPRINTF("ECC failure in Configuration blob\r\n");
                 continue;
             };
             show_config(&config_blob);
 
-            /* 
-             load BL1 image to temporary address (bl1_load_addr + bl1_entry_offset).
-             This image is to be copied again.
-             TODO: reduce the extra copy except the vector table.
-             */
-            load_addr = (uint8_t *) (config_blob.bl1_load_addr);
-            load_addr += config_blob.bl1_entry_offset;
-            mem_addr = mem_base_addr + config_blob.bl1_offset; /* + vtbl_size; */
+            /* load BL1 image to its final address (except vector table) */
+            mem_addr = mem_base_addr + config_blob.bl1_offset;
             DPRINTF("BL0: load BL1 image (0x%x) to (0x%x), size(0x%x)\r\n",
-                   mem_addr, load_addr, config_blob.bl1_size);
-            if (load_memcpy_ecc((uint32_t *)mem_addr, (uint32_t *)load_addr,
-                       config_blob.bl1_size, false)) {
-                DPRINTF("ECC failure in BL1 image read\r\n");
-                continue;
-	    };
-   
-            /* checksum */   
-            unsigned char output[SHA256_CHECKSUM_SIZE];
-            mbedtls_sha256_ret((unsigned char *) load_addr,
-                               config_blob.bl1_size, output, false);
-            if (diff_checksum(output, config_blob.checksum)) {
-                DPRINTF("Checksum Failure\r\n");
+                   mem_addr, config_blob.bl1_load_addr, config_blob.bl1_size);
+            bl1_vtbl_size = load_bl1(mem_addr, &config_blob, bl1_vtbl, ecc);
+            if (bl1_vtbl_size < 0) {
+                DPRINTF("BL1 image read or checksum failure\r\n");
                 continue;
             }
             break;
@@ -355,13 +566,11 @@ int main_relocated ( void )
         PANICX("BL0: FATAL: all backup copies failed\r\n");
     }
 
-    /* move bl1 image to the actual bl1_load_addr */ 
+    /* install BL1 vector table: BL0 takes no more exceptions from here on */
     load_addr = (uint8_t *) config_blob.bl1_load_addr;
-    mem_addr = (uint8_t *) config_blob.bl1_load_addr;
-    mem_addr += config_blob.bl1_entry_offset;
-    DPRINTF("BL0: move BL1 image from (0x%x) to (0x%x), size(0x%x)\r\n",
-           mem_addr, load_addr, config_blob.bl1_size);
-    load_memcpy_ecc((uint32_t *)mem_addr, (uint32_t *)load_addr, config_blob.bl1_size, false);
+    DPRINTF("BL0: install BL1 vector table at (0x%x), size(0x%x)\r\n",
+           load_addr, bl1_vtbl_size);
+    load_memcpy_ecc(bl1_vtbl, (uint32_t *)load_addr, bl1_vtbl_size, NULL);
 
     smc_deinit(smc);
  
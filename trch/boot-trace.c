@@ -0,0 +1,94 @@
+#include <stdint.h>
+
+#include "console.h"
+#include "etimer.h"
+#include "panic.h"
+
+#include "boot-trace.h"
+
+#define MAX_PHASES 48
+
+struct phase {
+    char name[BOOT_TRACE_NAME_LEN];
+    uint64_t start;  // ns
+    uint64_t end;    // ns, 0 while in progress
+};
+
+static struct etimer *timer;
+static uint64_t t0;
+static struct phase phases[MAX_PHASES];
+static unsigned num_phases;
+
+// There is no 64-bit division (no libgcc), so divide in 16-bit steps with
+// the 32-bit hardware divider. Result wraps after ~71 minutes.
+static uint32_t ns_to_us(uint64_t ns)
+{
+    uint32_t hi = ns >> 32, lo = (uint32_t)ns;
+    uint32_t r = hi % 1000;
+    uint32_t x = (r << 16) | (lo >> 16);
+    uint32_t q1 = x / 1000;
+    x = ((x % 1000) << 16) | (lo & 0xffff);
+    return (q1 << 16) + x / 1000;
+}
+
+// name := "phase arg", truncated
+static void format_name(char *name, const char *phase, const char *arg)
+{
+    unsigned n = 0;
+    const char *s;
+    for (s = phase; *s && n < BOOT_TRACE_NAME_LEN - 1; ++s)
+        name[n++] = *s;
+    if (arg && n < BOOT_TRACE_NAME_LEN - 1) {
+        name[n++] = ' ';
+        for (s = arg; *s && n < BOOT_TRACE_NAME_LEN - 1; ++s)
+            name[n++] = *s;
+    }
+    while (n < BOOT_TRACE_NAME_LEN)
+        name[n++] = '\0';
+}
+
+void boot_trace_init(struct etimer *et)
+{
+    timer = et;
+    num_phases = 0;
+    t0 = et ? etimer_capture(et) : 0;
+}
+
+int boot_trace_begin(const char *phase, const char *arg)
+{
+    if (!timer || num_phases == MAX_PHASES)
+        return -1;
+    struct phase *p = &phases[num_phases];
+    format_name(p->name, phase, arg);
+    p->end = 0;
+    p->start = etimer_capture(timer) - t0;
+    return num_phases++;
+}
+
+void boot_trace_end(int id)
+{
+    if (id < 0)
+        return;
+    ASSERT(id < num_phases);
+    phases[id].end = etimer_capture(timer) - t0;
+    DPRINTF("BOOT TRACE: %s: %u us\r\n", phases[id].name,
+            ns_to_us(phases[id].end - phases[id].start));
+}
+
+unsigned boot_trace_count()
+{
+    return num_phases;
+}
+
+int boot_trace_get(unsigned id, char *name, uint32_t *start_us,
+                   uint32_t *duration_us)
+{
+    if (id >= num_phases)
+        return 1;
+    struct phase *p = &phases[id];
+    for (unsigned i = 0; i < BOOT_TRACE_NAME_LEN; ++i)
+        name[i] = p->name[i];
+    *start_us = ns_to_us(p->start);
+    *duration_us = p->end ? ns_to_us(p->end - p->start) : 0;
+    return 0;
+}
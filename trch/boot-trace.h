@@ -0,0 +1,40 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <stdint.h>
+
+struct etimer;
+
+// Timestamps of named boot phases (SMC init, syscfg load, blob loads, resets,
+// ...), kept in RAM, to find out where boot time goes. Phases may nest.
+// A phase is named "phase arg" (arg is optional), truncated to fit.
+
+#define BOOT_TRACE_NAME_LEN 16 // including NUL, as reported by boot_trace_get
+
+#if CONFIG_BOOT_TRACE
+void boot_trace_init(struct etimer *et);
+
+// Returns an id to pass to boot_trace_end, or -1 if trace is full
+int boot_trace_begin(const char *phase, const char *arg);
+void boot_trace_end(int id);
+
+unsigned boot_trace_count();
+// Times are in microseconds since boot_trace_init
+int boot_trace_get(unsigned id, char *name, uint32_t *start_us,
+                   uint32_t *duration_us);
+#else // !CONFIG_BOOT_TRACE
+static inline void boot_trace_init(struct etimer *et) {}
+static inline int boot_trace_begin(const char *phase, const char *arg)
+{
+    return -1;
+}
+static inline void boot_trace_end(int id) {}
+static inline unsigned boot_trace_count() { return 0; }
+static inline int boot_trace_get(unsigned id, char *name, uint32_t *start_us,
+                                 uint32_t *duration_us)
+{
+    return 1;
+}
+#endif // !CONFIG_BOOT_TRACE
+
+#endif // BOOT_TRACE_H
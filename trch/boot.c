@@ -8,46 +8,520 @@
 #include "syscfg.h"
 #include "mem-map.h"
 #include "sfs.h"
+#include "dmas.h"
+#include "arm.h"
+#include "clock.h"
+#include "sha256.h"
 
 #include "boot.h"
+#include "boot-trace.h"
+
+#define BOOT_LOAD_CHANS TRCH_DMA_CHANS // max loads in flight
+#define MAX_LOADS (NUM_SUBSYSS * MAX_BLOBS)
+
+struct boot_load {
+    subsys_t subsys;
+    const char *name;
+    struct sfs_file *file;
+    uint8_t flags; // SYSCFG_BLOB_*
+    uint8_t chan_hint;
+    int chan; // -1 until issued
+    int trace; // boot trace phase
+    uint64_t ticks; // clock, when issued, then how long the load took
+    volatile bool done; // set by completion callback (may be from ISR)
+    volatile int rc;
+    bool reaped; // completed, but result not processed yet
+    bool checking; // resident copy being checked (SYSCFG_BLOB_WARM only)
+    bool checked;
+};
+
+struct boot_plan {
+    struct boot_load loads[MAX_LOADS];
+    unsigned num_loads;
+    unsigned pending[NUM_SUBSYSS]; // per subsystem: loads not yet completed
+    subsys_t failed;
+    unsigned resident; // blobs whose resident copy was reused
+    unsigned resident_bytes;
+    uint64_t resident_load_ticks; // what their loads took last time
+    uint64_t check_ticks; // spent checking resident copies
+
+    // progress of the reboot
+    subsys_t remaining; // not released from reset yet
+    unsigned next; // next load to issue
+    unsigned chans_busy; // bitmask
+};
+
+// The reboot in progress, run in steps (see boot_reboot_step)
+struct boot_reboot {
+    bool active;
+    subsys_t subsys;
+    struct syscfg *cfg;
+    int rc;
+    int trace; // boot trace phase
+};
+
+enum boot_step {
+    BOOT_STEP_DONE,
+    BOOT_STEP_AGAIN, // more work to do right away
+    BOOT_STEP_WAIT, // for a load to complete
+};
 
 static subsys_t reboot_requests;
+static struct boot_plan plan; // lifetime = reboot, but don't alloc on stack
+static struct boot_reboot reboot;
+static boot_notify_t *notify;
+static void *notify_arg;
+
+/* Check a chunk of a loaded blob against its hash-tree manifest. If @repair,
+ * a chunk that doesn't match is reloaded from storage instead of failing the
+ * check. Returns 1 if the chunk was reloaded, 0 if intact, -1 if corrupt. */
+static int verify_chunk(struct sfs_file *f, unsigned chunk, bool repair)
+{
+    if (!sfs_verify_chunk(f, chunk))
+        return 0;
+    if (!repair || sfs_read_chunk(f, chunk) || sfs_verify_chunk(f, chunk))
+        return -1;
+    return 1;
+}
+
+static int verify_chunks(struct sfs_file *f, const struct sfs_stat *st)
+{
+    for (unsigned i = 0; i < st->n_chunks; ++i)
+        if (verify_chunk(f, i, /* repair */ false))
+            return -1;
+    return 0;
+}
+
+/* For the estimate of the time saved by reusing resident blobs */
+static uint64_t now_ticks()
+{
+#if CONFIG_CLOCK
+    if (clock_initialized())
+        return clock_now();
+#endif // CONFIG_CLOCK
+    return 0;
+}
+
+#if CONFIG_CLOCK
+// without the 64-bit division helpers from libgcc
+static uint32_t ticks_ms(uint64_t ticks)
+{
+    uint32_t per_ms = clock_freq() / 1000;
+    while ((ticks >> 32) && per_ms > 1) {
+        ticks >>= 1;
+        per_ms >>= 1;
+    }
+    return per_ms ? (uint32_t)ticks / per_ms : 0;
+}
+#endif // CONFIG_CLOCK
+
+/* Blobs without a manifest are not checked after a fresh load */
+static int verify_load(struct boot_load *ld)
+{
+    struct sfs_stat st;
+    if (!(ld->flags & SYSCFG_BLOB_VERIFY))
+        return 0;
+    sfs_stat(ld->file, &st);
+    if (!st.n_chunks)
+        return 0;
+    int bt = boot_trace_begin("verify", ld->name);
+    int rc = verify_chunks(ld->file, &st);
+    boot_trace_end(bt);
+    if (rc)
+        printf("BOOT: %s: blob corrupted: %s\r\n", subsys_name(ld->subsys),
+               ld->name);
+    return rc;
+}
+
+enum resident {
+    RESIDENT_NO,
+    RESIDENT_YES,
+    RESIDENT_CHECKING, // call again
+};
+
+#if CONFIG_BOOT_WARM
+/* What was last loaded where, so that on reboot (e.g. after a watchdog
+ * expiry, when usually only the CPUs crashed) a blob whose copy in memory is
+ * still intact does not need to be reloaded from storage. */
+struct load_record {
+    struct sfs_file *file; // NULL if slot free
+    struct sfs_stat st;
+    uint64_t load_ticks; // how long the load took, 0 if unknown
+};
+static struct load_record load_records[MAX_LOADS];
+
+static struct load_record *find_record(struct sfs_file *f)
+{
+    for (unsigned i = 0; i < MAX_LOADS; ++i)
+        if (load_records[i].file == f)
+            return &load_records[i];
+    return NULL;
+}
+
+static void record_forget(struct sfs_file *f)
+{
+    struct load_record *r = find_record(f);
+    if (r)
+        r->file = NULL;
+}
+
+static void record_load(struct sfs_file *f, uint64_t load_ticks)
+{
+    struct load_record *r = find_record(NULL);
+    if (!r) // can only happen if the set of blobs changed between boots
+        return;
+    sfs_stat(f, &r->st);
+    r->load_ticks = load_ticks;
+    for (unsigned i = 0; i < SFS_CHECKSUM_SIZE; ++i) {
+        if (r->st.chcksum[i]) {
+            r->file = f;
+            return;
+        }
+    }
+    // no checksum in descriptor: can't verify, so always reload
+}
+
+#define RESIDENT_HASH_STEP 0x4000 // bytes, per step, of blobs without manifest
+
+/* The check of a resident blob runs in steps, a chunk (or for blobs without
+ * a manifest, RESIDENT_HASH_STEP bytes) at a time, so that it does not hold
+ * off the other tasks of the scheduler (WDT, commands, ...) for the whole
+ * blob. There is one check at a time. */
+struct resident_check {
+    struct load_record *r; // NULL when no check in progress
+    unsigned pos; // next chunk, or next byte to hash
+    unsigned reloaded; // chunks
+    mbedtls_sha256_context sha;
+};
+static struct resident_check check;
+
+// ticks * num / den, without the 64-bit division helpers from libgcc
+static uint64_t ticks_scale(uint64_t ticks, unsigned num, unsigned den)
+{
+    unsigned shift = 0;
+    while (ticks >> 32) {
+        ticks >>= 1;
+        shift++;
+    }
+    return (uint64_t)((uint32_t)ticks / den * num) << shift;
+}
+
+static enum resident resident_done(struct resident_check *c, unsigned *size,
+                                   uint64_t *load_ticks)
+{
+    struct load_record *r = c->r;
+    c->r = NULL;
+    if (c->reloaded)
+        printf("BOOT: resident blob at 0x%x: reloaded %u of %u chunks\r\n",
+               r->st.load_addr, c->reloaded, r->st.n_chunks);
+    unsigned reloaded_bytes = c->reloaded * r->st.chunk_size;
+    *size = reloaded_bytes < r->st.size ? r->st.size - reloaded_bytes : 0;
+    *load_ticks = r->load_ticks;
+    if (r->st.n_chunks) // the reloaded chunks are not saved
+        *load_ticks = ticks_scale(r->load_ticks,
+                                  r->st.n_chunks - c->reloaded, r->st.n_chunks);
+    return RESIDENT_YES;
+}
+
+/* One step of the check of whether a blob's copy in memory is intact: returns
+ * RESIDENT_YES once it is (repaired, if it has a manifest), with the bytes
+ * not reloaded in *size, and what loading them took last time in *load_ticks */
+static enum resident resident_step(struct sfs_file *f, unsigned *size,
+                                   uint64_t *load_ticks)
+{
+    struct resident_check *c = &check;
+
+    if (!c->r) {
+        c->r = find_record(f);
+        if (!c->r)
+            return RESIDENT_NO;
+        c->pos = 0;
+        c->reloaded = 0;
+        if (!c->r->st.n_chunks) {
+            mbedtls_sha256_init(&c->sha);
+            mbedtls_sha256_starts_ret(&c->sha, /* is224 */ 0);
+        }
+    }
+    struct load_record *r = c->r;
+
+    if (r->st.n_chunks) { // only the chunks that changed need reloading
+        if (c->pos == r->st.n_chunks)
+            return resident_done(c, size, load_ticks);
+        int rc = verify_chunk(f, c->pos++, /* repair */ true);
+        if (rc < 0) {
+            c->r = NULL;
+            return RESIDENT_NO;
+        }
+        c->reloaded += rc;
+        return RESIDENT_CHECKING;
+    }
+
+    if (c->pos < r->st.size) {
+        unsigned n = r->st.size - c->pos;
+        if (n > RESIDENT_HASH_STEP)
+            n = RESIDENT_HASH_STEP;
+        mbedtls_sha256_update_ret(&c->sha,
+            (const unsigned char *)r->st.load_addr + c->pos, n);
+        c->pos += n;
+        return RESIDENT_CHECKING;
+    }
+    uint8_t digest[SFS_CHECKSUM_SIZE];
+    mbedtls_sha256_finish_ret(&c->sha, digest);
+    for (unsigned i = 0; i < SFS_CHECKSUM_SIZE; ++i) {
+        if (digest[i] != r->st.chcksum[i]) {
+            printf("BOOT: resident blob at 0x%x corrupted: reloading\r\n",
+                   r->st.load_addr);
+            c->r = NULL;
+            return RESIDENT_NO;
+        }
+    }
+    return resident_done(c, size, load_ticks);
+}
+#else // !CONFIG_BOOT_WARM
+#define record_forget(f)
+#define record_load(f, load_ticks)
+#define resident_step(f, size, load_ticks) RESIDENT_NO
+#endif // !CONFIG_BOOT_WARM
+
+static unsigned subsys_index(subsys_t subsys)
+{
+    unsigned b = 0;
+    while (!(subsys & (1 << b)))
+        b++;
+    return b;
+}
 
-static int boot_load(subsys_t subsys, struct syscfg *cfg, struct sfs *fs)
-{
-   struct syscfg_rtps_r52 *cfg_r52;
-   struct syscfg_rtps_a53 *cfg_a53;
-   struct syscfg_hpps *cfg_hpps;
-   ASSERT(fs);
-   switch (subsys) {
-      case SUBSYS_RTPS_R52:
-         printf("BOOT: load RTPS\r\n");
-         cfg_r52 = &cfg->rtps_r52;
-         for (int i = 0; cfg_r52->blobs[i]; ++i) {
-            if (sfs_load(fs, cfg_r52->blobs[i], NULL, NULL))
-               return 1;
-         }
-         break;
-      case SUBSYS_RTPS_A53:
-         cfg_a53 = &cfg->rtps_a53;
-         for (int i = 0; cfg_a53->blobs[i]; ++i) {
-            if (sfs_load(fs, cfg_a53->blobs[i], NULL, NULL))
-               return 1;
-         }
-         break;
-      case SUBSYS_HPPS:
-         printf("BOOT: load HPPS\r\n");
-         cfg_hpps = &cfg->hpps;
-         for (int i = 0; cfg_hpps->blobs[i]; ++i) {
-            if (sfs_load(fs, cfg_hpps->blobs[i], NULL, NULL))
-               return 1;
-         }
-         break;
-      default:
-         printf("BOOT: ERROR: unknown subsystem %x\r\n", subsys);
-         return 1;
-   };
-   return 0;
+static void load_completed(void *arg, int rc)
+{
+    struct boot_load *ld = arg;
+    ld->rc = rc;
+    ld->done = true;
+    if (notify)
+        notify(notify_arg);
+}
+
+static int plan_load(struct boot_plan *p, const struct syscfg_blob *blob,
+                     struct sfs *fs)
+{
+    ASSERT(p->num_loads < MAX_LOADS);
+    struct boot_load *ld = &p->loads[p->num_loads];
+    ld->subsys = blob->subsys;
+    ld->file = sfs_open_hash(fs, blob->hash);
+    if (!ld->file) {
+        if (blob->name)
+            printf("BOOT: ERROR: %s: blob not found: %s\r\n",
+                   subsys_name(blob->subsys), blob->name);
+        else
+            printf("BOOT: ERROR: %s: blob not found: #%08x\r\n",
+                   subsys_name(blob->subsys), blob->hash);
+        return 1;
+    }
+    ld->name = sfs_name(ld->file);
+    ld->flags = blob->flags;
+    ld->chan_hint = blob->chan;
+    if (ld->chan_hint != SYSCFG_BLOB_CHAN_ANY &&
+        ld->chan_hint >= BOOT_LOAD_CHANS) {
+        printf("BOOT: %s: no DMA channel %u: using any\r\n",
+               ld->name, ld->chan_hint);
+        ld->chan_hint = SYSCFG_BLOB_CHAN_ANY;
+    }
+
+    p->num_loads++;
+    ld->chan = -1;
+    ld->done = false;
+    ld->rc = 0;
+    ld->reaped = false;
+    ld->checking = false;
+    ld->checked = false;
+    p->pending[subsys_index(ld->subsys)]++;
+    return 0;
+}
+
+/* Resolve all blobs of all requested subsystems up front, so that a missing
+ * file is detected before any transfer is started: the subsystem that it
+ * belongs to is failed, and none of its blobs is loaded, but the other
+ * subsystems are loaded and released as usual. Blobs are looked up by the
+ * name hash from the config, and loaded in config order, except that the
+ * compressed ones go last: they are decompressed by the CPU, which cannot
+ * issue other loads meanwhile, so better when the DMA loads are in flight. */
+static void plan_loads(struct boot_plan *p, subsys_t subsys,
+                       struct syscfg *cfg, struct sfs *fs)
+{
+    p->num_loads = 0;
+    p->failed = 0;
+    p->resident = 0;
+    p->resident_bytes = 0;
+    p->resident_load_ticks = 0;
+    p->check_ticks = 0;
+    for (unsigned b = 0; b < NUM_SUBSYSS; ++b)
+        p->pending[b] = 0;
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        for (unsigned i = 0; i < cfg->num_blobs; ++i) {
+            const struct syscfg_blob *blob = &cfg->blobs[i];
+            bool compressed = blob->flags & SYSCFG_BLOB_COMPRESSED;
+            if (!(subsys & blob->subsys) || (p->failed & blob->subsys) ||
+                compressed != (pass == 1))
+                continue;
+            if (plan_load(p, blob, fs))
+                p->failed |= blob->subsys;
+        }
+    }
+
+    // drop the blobs planned before their subsystem failed
+    unsigned n = 0;
+    for (unsigned i = 0; i < p->num_loads; ++i) {
+        struct boot_load *ld = &p->loads[i];
+        if (p->failed & ld->subsys)
+            p->pending[subsys_index(ld->subsys)]--;
+        else
+            p->loads[n++] = *ld;
+    }
+    p->num_loads = n;
+}
+
+/* DMA channel for a load: the hinted one, or any free one, or -1 if busy */
+static int pick_chan(struct boot_load *ld, unsigned chans_busy)
+{
+    if (ld->chan_hint != SYSCFG_BLOB_CHAN_ANY)
+        return chans_busy & (1 << ld->chan_hint) ? -1 : ld->chan_hint;
+    for (unsigned chan = 0; chan < BOOT_LOAD_CHANS; ++chan)
+        if (!(chans_busy & (1 << chan)))
+            return chan;
+    return -1;
+}
+
+static int boot_reset(subsys_t subsys, struct syscfg *cfg);
+
+/* Issue loads onto free DMA channels (in subsystem order), and as each
+ * subsystem's last blob lands, release it from reset, while the blobs of the
+ * other subsystems may still be in flight. Instead of waiting for the loads
+ * to complete, returns, so that the caller can do other work meanwhile. */
+static enum boot_step run_loads(struct boot_plan *p, struct syscfg *cfg,
+                                int *rc)
+{
+    for (unsigned b = 0; b < NUM_SUBSYSS; ++b) {
+        subsys_t s = (subsys_t)(1 << b);
+        if (!(p->remaining & s) || p->pending[b])
+            continue;
+        if (p->failed & s) {
+            printf("BOOT: %s: not released from reset: load failed\r\n",
+                   subsys_name(s));
+            *rc = 1;
+        } else {
+            printf("BOOT: %s: loaded, releasing reset\r\n", subsys_name(s));
+            int bt = boot_trace_begin("reset", subsys_name(s));
+            *rc |= boot_reset(s, cfg);
+            boot_trace_end(bt);
+        }
+        p->remaining &= ~s;
+    }
+    if (!p->remaining)
+        return BOOT_STEP_DONE;
+
+    // in order: a load waiting for its channel, or for the check of its
+    // resident copy, holds up the ones after it (while those issued before
+    // it are in flight)
+    bool progress = false;
+    while (p->next < p->num_loads) {
+        struct boot_load *ld = &p->loads[p->next];
+        if ((ld->flags & SYSCFG_BLOB_WARM) && !ld->checked) {
+            unsigned size;
+            uint64_t load_ticks;
+            uint64_t start = now_ticks();
+            if (!ld->checking) {
+                ld->checking = true;
+                ld->trace = boot_trace_begin("verify", ld->name);
+            }
+            enum resident res = resident_step(ld->file, &size, &load_ticks);
+            p->check_ticks += now_ticks() - start;
+            progress = true;
+            if (res == RESIDENT_CHECKING)
+                break; // one step at a time
+            boot_trace_end(ld->trace);
+            ld->checking = false;
+            ld->checked = true;
+            if (res == RESIDENT_YES) {
+                p->next++;
+                p->pending[subsys_index(ld->subsys)]--;
+                p->resident++;
+                p->resident_bytes += size;
+                p->resident_load_ticks += load_ticks;
+                continue;
+            }
+        }
+        int chan = pick_chan(ld, p->chans_busy);
+        if (chan < 0)
+            break;
+        p->next++;
+        progress = true;
+        record_forget(ld->file); // destination is about to be overwritten
+        ld->trace = boot_trace_begin("load", ld->name);
+        ld->ticks = now_ticks();
+        if (sfs_read_async(ld->file, chan, load_completed, ld)) {
+            boot_trace_end(ld->trace);
+            p->failed |= ld->subsys;
+            p->pending[subsys_index(ld->subsys)]--;
+            continue;
+        }
+        ld->chan = chan;
+        p->chans_busy |= 1 << chan;
+    }
+
+    // Results are processed after the freed channels were refilled, since
+    // checking a blob takes a while.
+    bool reaped = false;
+    for (unsigned i = 0; i < p->next; ++i) {
+        struct boot_load *ld = &p->loads[i];
+        if (!ld->reaped)
+            continue;
+        ld->reaped = false;
+        if (!ld->rc)
+            ld->rc = verify_load(ld);
+        p->pending[subsys_index(ld->subsys)]--;
+        if (ld->rc) {
+            printf("BOOT: %s: load failed: rc %d\r\n",
+                   subsys_name(ld->subsys), ld->rc);
+            p->failed |= ld->subsys;
+        } else {
+            record_load(ld->file, ld->ticks);
+        }
+        reaped = true;
+    }
+
+    for (unsigned i = 0; i < p->next; ++i) {
+        struct boot_load *ld = &p->loads[i];
+        if (ld->chan < 0 || !ld->done)
+            continue;
+        boot_trace_end(ld->trace);
+        ld->ticks = now_ticks() - ld->ticks;
+        p->chans_busy &= ~(1 << ld->chan);
+        ld->chan = -1;
+        ld->reaped = true;
+        reaped = true;
+    }
+
+    // a load that completes after the check above notifies
+    if (reaped || progress || !p->chans_busy)
+        return BOOT_STEP_AGAIN;
+    return BOOT_STEP_WAIT;
+}
+
+/* The time saved is estimated from what loading the same blobs took when they
+ * were last loaded, less what checking them took now. */
+static void report_resident(struct boot_plan *p)
+{
+    if (!p->resident)
+        return;
+    printf("BOOT: reused %u resident blobs: skipped reloading %u KB\r\n",
+           p->resident, p->resident_bytes / 1024);
+#if CONFIG_CLOCK
+    uint32_t load_ms = ticks_ms(p->resident_load_ticks);
+    uint32_t check_ms = ticks_ms(p->check_ticks);
+    printf("BOOT: est. %d ms saved: loading took %u ms, checking %u ms\r\n",
+           (int)(load_ms - check_ms), load_ms, check_ms);
+#else // !CONFIG_CLOCK
+    printf("BOOT: time saved not estimated: no clock\r\n");
+#endif // !CONFIG_CLOCK
 }
 
 static int boot_reset(subsys_t subsys, struct syscfg *cfg)
@@ -114,7 +588,14 @@ void boot_request(subsys_t subsys)
     printf("BOOT: accepted reboot request for subsystems %s\r\n",
            subsys_name(subsys));
     reboot_requests |= subsys; // coallesce requests
-    // TODO: SEV (to prevent race between requests check and WFE in main loop)
+    if (notify)
+        notify(notify_arg);
+}
+
+void boot_notify_register(boot_notify_t *cb, void *arg)
+{
+    notify_arg = arg;
+    notify = cb;
 }
 
 bool boot_pending()
@@ -124,31 +605,72 @@ bool boot_pending()
 
 int boot_handle(subsys_t *subsys)
 {
-    int b = 0;
-    while (b < NUM_SUBSYSS && !(reboot_requests & (1 << b)))
-        b++;
-    if (b == NUM_SUBSYSS)
+    subsys_t requests = reboot_requests;
+    if (!requests)
         return 1;
-    *subsys = (subsys_t)(1 << b);
+    *subsys = requests;
     return 0;
 }
 
-int boot_reboot(subsys_t subsys, struct syscfg *cfg, struct sfs *fs)
+void boot_reboot_begin(subsys_t subsys, struct syscfg *cfg, struct sfs *fs)
 {
-    int rc = 0;
+    ASSERT(!reboot.active);
     printf("BOOT: rebooting subsys %s...\r\n", subsys_name(subsys));
+    reboot.active = true;
+    reboot.subsys = subsys;
+    reboot.cfg = cfg;
+    reboot.rc = 0;
+    reboot.trace = boot_trace_begin("boot", subsys_name(subsys));
+    // served by this reboot: requests that arrive while it is in progress,
+    // even for the same subsystems, stay pending for the next one
+    reboot_requests &= ~subsys;
+    plan.remaining = 0; // until planned
+    plan.resident = 0;
+    plan.next = 0;
+    plan.chans_busy = 0;
 
     if (cfg->load_binaries && fs) {
-        rc |= boot_load(subsys, cfg, fs);
-    } else if (cfg->load_binaries) {
+        // releases each subsystem from reset once its blobs are loaded
+        printf("BOOT: load %s\r\n", subsys_name(subsys));
+        plan_loads(&plan, subsys, cfg, fs);
+        plan.remaining = subsys;
+        return;
+    }
+
+    if (cfg->load_binaries) {
         if (!fs)
             printf("BOOT: not loading binaries: no Simple File System\r\n");
         else
             printf("BOOT: not loading binaries: configured as preloaded\r\n");
     }
-    rc |= boot_reset(subsys, cfg);
+    for (unsigned b = 0; b < NUM_SUBSYSS; ++b) {
+        if (subsys & (1 << b)) {
+            int bt = boot_trace_begin("reset", subsys_name(1 << b));
+            reboot.rc |= boot_reset((subsys_t)(1 << b), cfg);
+            boot_trace_end(bt);
+        }
+    }
+}
 
-    reboot_requests &= ~subsys;
-    printf("BOOT: rebooted subsys %s: rc %u\r\n", subsys_name(subsys), rc);
-   return rc;
+bool boot_reboot_step(int *rc)
+{
+    ASSERT(reboot.active);
+    enum boot_step step = run_loads(&plan, reboot.cfg, &reboot.rc);
+    if (step == BOOT_STEP_AGAIN && notify)
+        notify(notify_arg);
+    if (step != BOOT_STEP_DONE)
+        return false;
+
+    reboot.active = false;
+    report_resident(&plan);
+    boot_trace_end(reboot.trace);
+    printf("BOOT: rebooted subsys %s: rc %u\r\n", subsys_name(reboot.subsys),
+           reboot.rc);
+    *rc = reboot.rc;
+    return true;
+}
+
+bool boot_reboot_active()
+{
+    return reboot.active;
 }
@@ -8,9 +8,20 @@
 
 struct sfs;
 
+// Called on requests and on load completions (possibly from an ISR), when
+// there is work for boot_handle or boot_reboot_step
+typedef void (boot_notify_t)(void *arg);
+void boot_notify_register(boot_notify_t *cb, void *arg);
+
 void boot_request(subsys_t subsys);
 bool boot_pending();
 int boot_handle(subsys_t *subsys);
-int boot_reboot(subsys_t subsys, struct syscfg *cfg, struct sfs *fs);
+
+// A reboot is run in steps, so that other work can run while its loads are
+// in flight: after begin, call step whenever notified, until it returns true
+// with the result of the reboot in *rc.
+void boot_reboot_begin(subsys_t subsys, struct syscfg *cfg, struct sfs *fs);
+bool boot_reboot_step(int *rc);
+bool boot_reboot_active();
 
 #endif // BOOT_H
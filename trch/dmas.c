@@ -8,7 +8,8 @@
 // Global because standalone test also needs to set it, but ISR is here
 struct dma *trch_dma;
 
-static uint8_t trch_dma_mcode[256]; // store in TRCH SRAM
+// store in TRCH SRAM; 128 bytes of microcode per channel
+static uint8_t trch_dma_mcode[TRCH_DMA_CHANS * 128];
 
 struct dma *trch_dma_init()
 {
@@ -18,14 +19,16 @@ struct dma *trch_dma_init()
         return NULL;
 
     nvic_int_enable(TRCH_IRQ__TRCH_DMA_ABORT);
-    nvic_int_enable(TRCH_IRQ__TRCH_DMA_EV0);
+    for (unsigned ev = 0; ev < TRCH_DMA_CHANS; ++ev)
+        nvic_int_enable(TRCH_IRQ__TRCH_DMA_EV0 + ev);
     return trch_dma;
 }
 
 void trch_dma_deinit()
 {
     nvic_int_disable(TRCH_IRQ__TRCH_DMA_ABORT);
-    nvic_int_disable(TRCH_IRQ__TRCH_DMA_EV0);
+    for (unsigned ev = 0; ev < TRCH_DMA_CHANS; ++ev)
+        nvic_int_disable(TRCH_IRQ__TRCH_DMA_EV0 + ev);
 
     dma_destroy(trch_dma);
 }
@@ -38,3 +41,10 @@ void dma_trch_dma_abort_isr() {
 }
 
 DMA_EV_ISR(trch_dma, 0);
+DMA_EV_ISR(trch_dma, 1);
+DMA_EV_ISR(trch_dma, 2);
+DMA_EV_ISR(trch_dma, 3);
+DMA_EV_ISR(trch_dma, 4);
+DMA_EV_ISR(trch_dma, 5);
+DMA_EV_ISR(trch_dma, 6);
+DMA_EV_ISR(trch_dma, 7);
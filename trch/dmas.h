@@ -3,6 +3,8 @@
 
 #include "dma.h"
 
+#define TRCH_DMA_CHANS 8 // one event (IRQ) per channel
+
 struct dma *trch_dma_init();
 void trch_dma_deinit();
 
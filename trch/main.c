@@ -5,12 +5,17 @@
 
 #include "arm.h"
 #include "boot.h"
+#include "boot-trace.h"
 #include "command.h"
 #include "board.h"
+#include "clock.h"
 #include "console.h"
 #include "dmas.h"
+#include "etimer.h"
 #include "event.h"
 #include "hwinfo.h"
+#include "intc.h"
+#include "irq-stats.h"
 #include "links.h"
 #include "mailbox.h"
 #include "sfs.h"
@@ -20,19 +25,42 @@
 #include "panic.h"
 #include "console.h"
 #include "reset.h"
+#include "sched.h"
 #include "server.h"
 #include "sleep.h"
 #include "smc.h"
+#include "smc-nand.h"
 #include "swtimer.h"
 #include "systick.h"
 #include "test.h"
+#if TEST_BUSYLOOP
+#include "test-busyloop.h"
+#endif // TEST_BUSYLOOP
 #include "watchdog.h"
+#include "work.h"
 #include "syscfg.h"
+#if CONFIG_TICKLESS
+#include "tickless.h"
+#endif // CONFIG_TICKLESS
 
 #define SYSTICK_INTERVAL_MS     500
 #define SYSTICK_INTERVAL_CYCLES (SYSTICK_INTERVAL_MS * (SYSTICK_CLK_HZ / 1000))
 #define MAIN_LOOP_SILENT_ITERS 16
 
+// Generated from irqmap (in isr.c)
+extern void irqmap_prio_init(void);
+
+#if CONFIG_TICKLESS
+// Granularity of wakeups; and the longest sleep, which with the watchdog
+// enabled is bounded by the kicks from the tick ISR
+#define TICKLESS_MIN_CYCLES     (SYSTICK_CLK_HZ / 10000)
+#if CONFIG_TRCH_WDT
+#define TICKLESS_MAX_CYCLES     SYSTICK_INTERVAL_CYCLES
+#else // !CONFIG_TRCH_WDT
+#define TICKLESS_MAX_CYCLES     SYSTICK_MAX_INTERVAL
+#endif // !CONFIG_TRCH_WDT
+#endif // CONFIG_TICKLESS
+
 // Default boot config (if not loaded from NV mem)
 static struct syscfg syscfg = {
     .sfs_offset = 0x0,
@@ -42,10 +70,47 @@ static struct syscfg syscfg = {
     .load_binaries = false,
 };
 
+#if CONFIG_CLOCK || CONFIG_BOOT_TRACE
+extern struct etimer *elapsed_timer; // defined near ISR
+#endif // CONFIG_CLOCK || CONFIG_BOOT_TRACE
+
+#if CONFIG_SMC_TUNE
+// SMC timings are tuned against the start of the SRAM rank (holds syscfg and
+// SFS), of which the signatures are taken with safe timings
+#define SMC_TUNE_WORDS (0x10000 / sizeof(uint32_t))
+static uint32_t smc_tune_buf[SMC_TUNE_WORDS / SMC_TUNE_BLOCK_WORDS];
+#endif // CONFIG_SMC_TUNE
+
+#if CONFIG_SMC_NAND
+// Not used by boot loads from a file system on NAND, since those are not
+// issued on DMA channels (see sfs_read_async)
+#define SMC_NAND_DMA_CHAN (TRCH_DMA_CHANS - 1)
+#endif // CONFIG_SMC_NAND
+
 #if CONFIG_TRCH_WDT
 static bool trch_wdt_started = false;
 #endif // CONFIG_TRCH_WDT
 
+// Tasks of the main loop, by priority: work deferred from ISRs (e.g. reading
+// an incoming message) goes first, then replies (e.g. PSCI), and reboots,
+// whose loads take long, run in steps behind everything else
+enum {
+    TASK_PRIO_WORK = 0,
+    TASK_PRIO_CMDS,
+    TASK_PRIO_TIMERS,
+    TASK_PRIO_EVENTS,
+    TASK_PRIO_LINKS,
+    TASK_PRIO_BOOT,
+};
+
+static struct sched_task work_task;
+static struct sched_task cmds_task;
+static struct sched_task timers_task;
+static struct sched_task events_task;
+static struct sched_task links_task;
+static struct sched_task boot_task;
+static struct sfs *trch_fs = NULL;
+
 static void trch_panic(const char *msg)
 {
 #if CONFIG_TRCH_WDT && !CONFIG_RELEASE
@@ -55,6 +120,23 @@ static void trch_panic(const char *msg)
     panic(msg);
 }
 
+#if CONFIG_CLOCK
+static uint64_t etimer_clock_read(void *arg)
+{
+    return etimer_capture(arg);
+}
+
+static void etimer_clock_alarm(void *arg, uint64_t deadline)
+{
+    etimer_event(arg, deadline);
+}
+
+static void etimer_clock_event(struct etimer *et, void *arg)
+{
+    clock_alarm_isr();
+}
+#endif // CONFIG_CLOCK
+
 #if CONFIG_SYSTICK
 static void systick_tick(void *arg)
 {
@@ -70,13 +152,90 @@ static void systick_tick(void *arg)
         watchdog_kick(COMP_CPU_TRCH);
 #endif // CONFIG_TRCH_WDT
 
-#if CONFIG_SLEEP_TIMER
+#if CONFIG_TICKLESS
+    tickless_tick(systick_interval());
+#elif CONFIG_SLEEP_TIMER
     sleep_tick(SYSTICK_INTERVAL_CYCLES);
     sw_timer_tick(SYSTICK_INTERVAL_CYCLES);
 #endif // CONFIG_SLEEP_TIMER
+
+    sched_ready(&timers_task);
+    sched_ready(&links_task); // shared memory links have no interrupt
 }
 #endif // CONFIG_SYSTICK
 
+static bool work_run(void *arg)
+{
+    // one item at a time, to let the scheduler re-evaluate in between
+    return work_run_one() && work_pending();
+}
+
+static bool cmds_run(void *arg)
+{
+    static struct cmd cmd; /* lifetime = body, but don't alloc on stack */
+    if (!cmd_dequeue(&cmd))
+        cmd_handle(&cmd);
+    return cmd_pending();
+}
+
+static bool timers_run(void *arg)
+{
+    sw_timer_run();
+    return false;
+}
+
+static bool events_run(void *arg)
+{
+    struct ev_loop *el = arg;
+    ev_loop_process(el); /* only one at a time, to let other tasks in */
+    return ev_loop_pending(el);
+}
+
+static bool links_run(void *arg)
+{
+    if (links_poll())
+        trch_panic("poll links");
+    return false;
+}
+
+static bool boot_run(void *arg)
+{
+    int rc;
+    if (!boot_reboot_active()) {
+        subsys_t subsys;
+        if (boot_handle(&subsys))
+            return false;
+        boot_reboot_begin(subsys, &syscfg, trch_fs);
+    }
+    if (!boot_reboot_step(&rc))
+        return false; // notifies when there is more to do
+    if (rc)
+        trch_panic("reboot request failed");
+    return boot_pending(); // requested while the reboot was in progress
+}
+
+static void main_idle(void *arg)
+{
+    static unsigned iter = 0;
+    if (iter++ % MAIN_LOOP_SILENT_ITERS == 0)
+        printf("[%u] Waiting for interrupt...\r\n", iter);
+
+#if CONFIG_TRCH_WDT && !CONFIG_SYSTICK // with SysTick, we kick from ISR
+    // Kicking from here is insufficient, because we sleep. There are two
+    // ways to complete: (A) have TRCH disable the watchdog in response to
+    // the WFI output signal from the core, and/or (B) have a scheduler
+    // (with a tick interval shorter than the watchdog timeout interval)
+    // and kick from the scheuduler tick. As a temporary stop-gap, we go
+    // with (C): kick before WFI, which returns at the latest on the first
+    // stage timeout IRQ.
+    watchdog_kick(COMP_CPU_TRCH);
+#endif // CONFIG_TRCH_WDT
+
+#if CONFIG_TICKLESS
+    tickless_update();
+#endif // CONFIG_TICKLESS
+}
+
 int main ( void )
 {
     console_init();
@@ -86,6 +245,9 @@ int main ( void )
     asm("svc #0");
 
     nvic_init(TRCH_SCS_BASE);
+    nvic_set_prio_grouping(INTC_PREEMPT_BITS);
+    irqmap_prio_init();
+    irq_stats_init(); // before any IRQ is enabled
 
     sleep_set_busyloop_factor(TRCH_M4_BUSYLOOP_FACTOR);
 
@@ -102,6 +264,9 @@ int main ( void )
     sleep_set_clock(SYSTICK_CLK_HZ);
     sw_timer_init(SYSTICK_CLK_HZ);
 #endif // CONFIG_SLEEP_TIMER
+#if CONFIG_TICKLESS
+    tickless_init(systick_retarget, TICKLESS_MIN_CYCLES, TICKLESS_MAX_CYCLES);
+#endif // CONFIG_TICKLESS
 #endif // CONFIG_SYSTICK
 
     struct ev_loop main_event_loop;
@@ -112,10 +277,43 @@ int main ( void )
         panic("standalone tests");
 #endif /* CONFIG_TESTS */
 
+#if CONFIG_CLOCK || CONFIG_BOOT_TRACE
+    // after standalone tests, since they create their own instance
+    elapsed_timer = etimer_create("ETMR", ETIMER__BASE,
+#if CONFIG_CLOCK
+            etimer_clock_event, NULL,
+#else // !CONFIG_CLOCK
+            NULL, NULL,
+#endif // !CONFIG_CLOCK
+            ETIMER_NOMINAL_FREQ_HZ, ETIMER_CLK_FREQ_HZ, ETIMER_MAX_DIVIDER);
+    if (!elapsed_timer ||
+        etimer_configure(elapsed_timer, ETIMER_CLK_FREQ_HZ, ETIMER_SYNC_SW, 0))
+        panic("elapsed timer");
+    // never destroy, the clock and boot trace are kept for the lifetime of
+    // the system
+#endif // CONFIG_CLOCK || CONFIG_BOOT_TRACE
+#if CONFIG_CLOCK
+    // the count is in nominal units (ns), regardless of the clock source
+    clock_init(etimer_clock_read, etimer_clock_alarm, elapsed_timer,
+               ETIMER_NOMINAL_FREQ_HZ);
+    nvic_int_enable(TRCH_IRQ__ELAPSED_TIMER);
+    sleep_calibrate_busyloop();
+#endif // CONFIG_CLOCK
+#if TEST_BUSYLOOP
+    if (test_busyloop())
+        panic("busyloop test");
+#endif // TEST_BUSYLOOP
+#if CONFIG_BOOT_TRACE
+    boot_trace_init(elapsed_timer);
+#endif // CONFIG_BOOT_TRACE
+    int bt; // boot trace phase
+
 #if CONFIG_TRCH_DMA
+    bt = boot_trace_begin("dma", NULL);
     struct dma *trch_dma = trch_dma_init();
     if (!trch_dma)
         panic("TRCH DMA");
+    boot_trace_end(bt);
     // never destroy, it is used by drivers
 #else // !CONFIG_TRCH_DMA
     struct dma *trch_dma = NULL;
@@ -123,11 +321,31 @@ int main ( void )
 #endif // !CONFIG_TRCH_DMA
 
 #if CONFIG_SMC
+    bt = boot_trace_begin("smc", NULL);
     struct smc *lsio_smc = smc_init(SMC_LSIO_CSR_BASE, &lsio_smc_mem_cfg,
                                     SMC_IFACE_MASK_ALL, SMC_CHIP_MASK_ALL);
     if (!lsio_smc)
         panic("LSIO SMC");
+    boot_trace_end(bt);
     uint8_t *smc_sram_base = (uint8_t *)SMC_LSIO_SRAM_BASE0;
+#if CONFIG_SMC_TUNE
+    bt = boot_trace_begin("smctune", NULL);
+    smc_tune(lsio_smc, &lsio_smc_mem_cfg, SMC_IFACE_SRAM, /* chip */ 0,
+             (const volatile uint32_t *)smc_sram_base, SMC_TUNE_WORDS,
+             smc_tune_buf);
+    boot_trace_end(bt);
+#endif // CONFIG_SMC_TUNE
+#if CONFIG_SMC_NAND
+    struct smc_nand *lsio_nand = NULL;
+    int nand_iface = smc_get_iface(lsio_smc, SMC_IFACE_NAND);
+    if (nand_iface >= 0) {
+        bt = boot_trace_begin("nand", NULL);
+        lsio_nand = smc_nand_init(SMC_LSIO_CSR_BASE, nand_iface,
+                                  SMC_LSIO_NAND_BASE0, &lsio_smc_nand_cfg,
+                                  trch_dma, SMC_NAND_DMA_CHAN);
+        boot_trace_end(bt);
+    }
+#endif // CONFIG_SMC_NAND
 #endif // CONFIG_SMC
 
     uint8_t *syscfg_addr;
@@ -137,21 +355,39 @@ int main ( void )
     syscfg_addr = smc_sram_base + CONFIG_SYSCFG_ADDR;
 #endif /* CONFIG_SYSCFG_MEM__* */
 
+    bt = boot_trace_begin("syscfg", NULL);
     if (syscfg_load(&syscfg, syscfg_addr))
         panic("SYS CFG");
+    boot_trace_end(bt);
 
-    struct sfs *trch_fs = NULL;
 #if CONFIG_SFS
     if (syscfg.have_sfs_offset) {
+        bt = boot_trace_begin("sfs", NULL);
+#if CONFIG_SMC_NAND
+        if (syscfg.hpps.rootfs_loc == MEMDEV_TRCH_SMC_NAND) {
+            if (!lsio_nand)
+                panic("TRCH SMC NAND not found");
+            trch_fs = sfs_mount_blk(smc_nand_blkdev(lsio_nand),
+                                    syscfg.sfs_offset);
+        } else
+#endif // CONFIG_SMC_NAND
         trch_fs = sfs_mount(smc_sram_base + syscfg.sfs_offset, trch_dma);
         if (!trch_fs)
-            panic("TRCH SMC SRAM FS mount");
+            panic("TRCH SMC FS mount");
+        boot_trace_end(bt);
     }
 #endif /* CONFIG_SFS */
 
+#if TEST_SFS_LZ4
+    if (test_sfs_lz4(trch_fs))
+        panic("SFS LZ4 test");
+#endif // TEST_SFS_LZ4
+
 #if CONFIG_RT_MMU
+    bt = boot_trace_begin("rtmmu", NULL);
     if (rt_mmu_init())
         panic("RTPS/TRCH-HPPS MMU setup");
+    boot_trace_end(bt);
     // Never de-init since need some of the mappings while running. We could
     // remove mappings for loading the boot image binaries, but we don't
     // bother, since then would have to recreate them when reseting HPPS/RTPS.
@@ -162,7 +398,9 @@ int main ( void )
         panic("RTPS/TRCH-HPPS MMU test");
 #endif // TEST_RT_MMU
 
+    bt = boot_trace_begin("links", NULL);
     links_init(syscfg.rtps_mode);
+    boot_trace_end(bt);
     boot_request(syscfg.subsystems);
 
 #if CONFIG_TRCH_WDT
@@ -173,58 +411,26 @@ int main ( void )
 
     cmd_handler_register(server_process);
 
-    unsigned iter = 0;
-    while (1) {
-        bool verbose = iter++ % MAIN_LOOP_SILENT_ITERS == 0;
-        if (verbose)
-            printf("TRCH: main loop\r\n");
-
-#if CONFIG_TRCH_WDT && !CONFIG_SYSTICK // with SysTick, we kick from ISR
-        // Kicking from here is insufficient, because we sleep. There are two
-        // ways to complete: (A) have TRCH disable the watchdog in response to
-        // the WFI output signal from the core, and/or (B) have a scheduler
-        // (with a tick interval shorter than the watchdog timeout interval)
-        // and kick from the scheuduler tick. As a temporary stop-gap, we go
-        // with (C): kick on return from WFI/WFI as a result of first stage
-        // timeout IRQ.
-        watchdog_kick(COMP_CPU_TRCH);
-#endif // CONFIG_TRCH_WDT
-
-        //printf("main\r\n");
-
-        sw_timer_run();
-
-        subsys_t subsys;
-        while (!boot_handle(&subsys)) {
-            int rc = boot_reboot(subsys, &syscfg, trch_fs);
-            if (rc) {
-                trch_panic("reboot request failed");
-            }
-            verbose = true; // to end log with 'waiting' msg
-        }
-
-        /* only process one at a time, and go around the main loop */
-        if (!ev_loop_process(&main_event_loop)) {
-            verbose = true; /* to end output with 'waiting' msg */
-        }
-
-        if (links_poll())
-            trch_panic("poll links");
-
-        /* TODO: implement using event loop */
-        static struct cmd cmd; /* lifetime = body, but don't alloc on stack */
-        while (!cmd_dequeue(&cmd)) {
-            cmd_handle(&cmd);
-            verbose = true; // to end log with 'waiting' msg
-        }
-
-        int_disable(); // the check and the WFI must be atomic
-        if (!cmd_pending() && !boot_pending() &&
-            !ev_loop_pending(&main_event_loop)) {
-            if (verbose)
-                printf("[%u] Waiting for interrupt...\r\n", iter);
-            asm("wfi"); // ignores PRIMASK set by int_disable
-        }
-        int_enable();
-    }
+    sched_init();
+    sched_add(&work_task, "work", TASK_PRIO_WORK, work_run, NULL);
+    sched_add(&cmds_task, "cmds", TASK_PRIO_CMDS, cmds_run, NULL);
+    sched_add(&timers_task, "timers", TASK_PRIO_TIMERS, timers_run, NULL);
+    sched_add(&events_task, "events", TASK_PRIO_EVENTS, events_run,
+              &main_event_loop);
+    sched_add(&links_task, "links", TASK_PRIO_LINKS, links_run, NULL);
+    sched_add(&boot_task, "boot", TASK_PRIO_BOOT, boot_run, NULL);
+    work_notify_register(sched_ready_cb, &work_task);
+    cmd_notify_register(sched_ready_cb, &cmds_task);
+    ev_loop_notify(&main_event_loop, sched_ready_cb, &events_task);
+    boot_notify_register(sched_ready_cb, &boot_task);
+
+    // anything that arrived before the notifications were registered
+    sched_ready(&work_task);
+    sched_ready(&cmds_task);
+    sched_ready(&events_task);
+    sched_ready(&links_task);
+    sched_ready(&boot_task);
+
+    printf("TRCH: main loop\r\n");
+    sched_loop(main_idle, NULL);
 }
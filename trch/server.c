@@ -2,13 +2,17 @@
 #include <unistd.h>
 
 #include "boot.h"
+#include "boot-trace.h"
 #include "command.h"
 #include "hwinfo.h"
+#include "irq-stats.h"
 #include "link.h"
+#include "mem.h"
 #include "mailbox-link.h"
 #include "panic.h"
 #include "console.h"
 #include "server.h"
+#include "sleep.h"
 #include "psci.h"
 
 #define MAX_MBOX_LINKS          8
@@ -98,6 +102,86 @@ int server_process(struct cmd *cmd, void *reply, size_t reply_sz)
             }
             return 0;
         }
+        case CMD_BOOT_TRACE: {
+            uint8_t first = cmd->msg[CMD_MSG_PAYLOAD_OFFSET];
+            struct cmd_boot_trace *pl =
+                (struct cmd_boot_trace *)(&reply_u8[CMD_MSG_PAYLOAD_OFFSET]);
+            printf("BOOT_TRACE ...\r\n");
+            printf("\tfirst = %u\r\n", first);
+            ASSERT(CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl) <= reply_sz);
+            ASSERT(BOOT_TRACE_NAME_LEN == CMD_BOOT_TRACE_NAME_LEN);
+
+            reply_u8[0] = CMD_BOOT_TRACE;
+            for (i = 1; i < CMD_MSG_PAYLOAD_OFFSET; i++)
+                reply_u8[i] = 0;
+            pl->total = boot_trace_count();
+            pl->first = first;
+            pl->count = 0;
+            pl->rsvd = 0;
+            while (pl->count < CMD_BOOT_TRACE_PHASES) {
+                struct cmd_boot_trace_phase *ph = &pl->phases[pl->count];
+                if (boot_trace_get(first + pl->count, ph->name,
+                                   &ph->start_us, &ph->duration_us))
+                    break;
+                pl->count++;
+            }
+            return CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl);
+        }
+        case CMD_BUSYLOOP: {
+            uint8_t calibrate = cmd->msg[CMD_MSG_PAYLOAD_OFFSET];
+            struct cmd_busyloop *pl =
+                (struct cmd_busyloop *)(&reply_u8[CMD_MSG_PAYLOAD_OFFSET]);
+            printf("BUSYLOOP ...\r\n");
+            printf("\tcalibrate = %u\r\n", calibrate);
+            ASSERT(CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl) <= reply_sz);
+
+            reply_u8[0] = CMD_BUSYLOOP;
+            for (i = 1; i < CMD_MSG_PAYLOAD_OFFSET; i++)
+                reply_u8[i] = 0;
+            pl->rc = 0;
+            if (calibrate) {
+#if CONFIG_CLOCK
+                sleep_calibrate_busyloop();
+#else // !CONFIG_CLOCK
+                pl->rc = -1;
+#endif // !CONFIG_CLOCK
+            }
+            pl->factor = sleep_get_busyloop_factor();
+            return CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl);
+        }
+        case CMD_IRQ_STATS: {
+            unsigned index =
+                *(uint16_t *)(&cmd->msg[CMD_MSG_PAYLOAD_OFFSET]);
+            unsigned core;
+            struct irq_stat st;
+            struct cmd_irq_stats *pl =
+                (struct cmd_irq_stats *)(&reply_u8[CMD_MSG_PAYLOAD_OFFSET]);
+            printf("IRQ_STATS ...\r\n");
+            printf("\tindex = %u\r\n", index);
+            ASSERT(CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl) <= reply_sz);
+            ASSERT(IRQ_STATS_BUCKETS == CMD_IRQ_STATS_BUCKETS);
+
+            if (!index)
+                irq_stats_print();
+
+            reply_u8[0] = CMD_IRQ_STATS;
+            for (i = 1; i < CMD_MSG_PAYLOAD_OFFSET; i++)
+                reply_u8[i] = 0;
+            bzero(pl, sizeof(*pl));
+            if (!irq_stats_next(&index, &core, &st)) {
+                pl->index = index;
+                pl->valid = 1;
+                pl->core = core;
+                pl->irq = st.irq;
+                pl->count = st.count;
+                pl->max_cycles = st.max;
+                pl->total_cycles_lo = (uint32_t)st.total;
+                pl->total_cycles_hi = (uint32_t)(st.total >> 32);
+                for (i = 0; i < CMD_IRQ_STATS_BUCKETS; i++)
+                    pl->hist[i] = st.hist[i];
+            }
+            return CMD_MSG_PAYLOAD_OFFSET + sizeof(*pl);
+        }
         case CMD_MBOX_LINK_CONNECT: {
             struct cmd_mbox_link_connect *pl =
                 (struct cmd_mbox_link_connect *)(&cmd->msg[CMD_MSG_PAYLOAD_OFFSET]);
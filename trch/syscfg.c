@@ -2,6 +2,7 @@
 #include <unistd.h>
 
 #include "console.h"
+#include "sfs.h"
 #include "subsys.h"
 #include "syscfg.h"
 
@@ -62,9 +63,28 @@ static void print_str_array(const char **sa)
         printf("%s ", sa[i]);
 }
 
+static void print_blobs(struct syscfg *cfg)
+{
+    for (unsigned i = 0; i < cfg->num_blobs; ++i) {
+        struct syscfg_blob *b = &cfg->blobs[i];
+        printf("\t\t%s: ", subsys_name(b->subsys));
+        if (b->name)
+            printf("%s", b->name);
+        else
+            printf("#%08x", b->hash);
+        if (b->chan != SYSCFG_BLOB_CHAN_ANY)
+            printf(" chan %u", b->chan);
+        printf("%s%s%s\r\n",
+               b->flags & SYSCFG_BLOB_VERIFY ? " verify" : "",
+               b->flags & SYSCFG_BLOB_COMPRESSED ? " compressed" : "",
+               b->flags & SYSCFG_BLOB_WARM ? " warm" : "");
+    }
+}
+
 void syscfg_print(struct syscfg *cfg)
 {
     printf("SYSTEM CONFIG:\r\n"
+           "\tversion:\t%u\r\n"
            "\thave sfs offset:\t%u\r\n"
            "\tsfs offset:\t0x%x\r\n"
            "\tload_binaries:\t%u\r\n"
@@ -72,33 +92,29 @@ void syscfg_print(struct syscfg *cfg)
            "\trtps mode:\t%s\r\n"
            "\trtps cores bitmask:\t0x%x\r\n"
            "\thpps rootfs loc:\t%s\r\n",
+           cfg->version,
            cfg->have_sfs_offset, cfg->sfs_offset,
            cfg->load_binaries,
            subsys_name(cfg->subsystems),
            rtps_mode_name(cfg->rtps_mode), cfg->rtps_cores,
            memdev_name(cfg->hpps.rootfs_loc));
-    printf("\trtps r52 blobs: ");
-    print_str_array(cfg->rtps_r52.blobs);
-    printf("\r\n");
-    printf("\trtps a53 blobs: ");
-    print_str_array(cfg->rtps_a53.blobs);
-    printf("\r\n");
-    printf("\thpps blobs: ");
-    print_str_array(cfg->hpps.blobs);
-    printf("\r\n");
+    if (cfg->version == 1) {
+        printf("\trtps r52 blobs: ");
+        print_str_array(cfg->rtps_r52.blobs);
+        printf("\r\n");
+        printf("\trtps a53 blobs: ");
+        print_str_array(cfg->rtps_a53.blobs);
+        printf("\r\n");
+        printf("\thpps blobs: ");
+        print_str_array(cfg->hpps.blobs);
+        printf("\r\n");
+    }
+    printf("\tblobs:\r\n");
+    print_blobs(cfg);
 }
 
-int syscfg_load(struct syscfg *cfg, uint8_t *addr)
+static void parse_cfg_word(struct syscfg *cfg, uint32_t word0)
 {
-    uint32_t *waddr = (uint32_t *)addr;
-    uint32_t word0;
-    ssize_t n;
-
-    uint32_t *wp = waddr;
-
-    word0 = *wp++;
-    printf("SYSCFG: @%p word0: %x\r\n", addr, word0);
-
     /* TODO: use field macros from lib/ */
     cfg->rtps_mode = (word0 & SYSCFG__RTPS_MODE__MASK) >> SYSCFG__RTPS_MODE__SHIFT;
     cfg->rtps_cores = (word0 & SYSCFG__RTPS_CORES__MASK)
@@ -110,7 +126,28 @@ int syscfg_load(struct syscfg *cfg, uint8_t *addr)
                                 >> SYSCFG__HAVE_SFS_OFFSET__SHIFT;
     cfg->load_binaries = (word0 & SYSCFG__LOAD_BINARIES__MASK)
                                 >> SYSCFG__LOAD_BINARIES__SHIFT;
-    cfg->sfs_offset = *wp++;
+}
+
+/* v1 has names only: hash them once here, and load the way v1 always did */
+static void add_v1_blobs(struct syscfg *cfg, subsys_t subsys,
+                         const char **names)
+{
+    for (int i = 0; names[i]; ++i) {
+        struct syscfg_blob *b = &cfg->blobs[cfg->num_blobs++];
+        b->hash = sfs_name_hash(names[i]);
+        b->name = names[i];
+        b->subsys = subsys;
+        b->chan = SYSCFG_BLOB_CHAN_ANY;
+        b->flags = SYSCFG_BLOB_VERIFY | SYSCFG_BLOB_WARM;
+    }
+}
+
+static int load_v1(struct syscfg *cfg, uint32_t *waddr)
+{
+    ssize_t n;
+
+    parse_cfg_word(cfg, waddr[0]);
+    cfg->sfs_offset = waddr[SYSCFG__SFS_OFFSET__WORD];
 
     n = parse_slist(cfg->rtps_r52.blobs_raw, sizeof(cfg->rtps_r52.blobs_raw),
             cfg->rtps_r52.blobs, sizeof(cfg->rtps_r52.blobs) / sizeof(char *),
@@ -128,6 +165,69 @@ int syscfg_load(struct syscfg *cfg, uint8_t *addr)
     if (n < 0)
         return 3;
 
+    cfg->version = 1;
+    cfg->num_blobs = 0;
+    add_v1_blobs(cfg, SUBSYS_RTPS_R52, cfg->rtps_r52.blobs);
+    add_v1_blobs(cfg, SUBSYS_RTPS_A53, cfg->rtps_a53.blobs);
+    add_v1_blobs(cfg, SUBSYS_HPPS, cfg->hpps.blobs);
+    return 0;
+}
+
+static int load_v2(struct syscfg *cfg, uint32_t *waddr)
+{
+    uint32_t num_blobs = waddr[SYSCFG_V2__NUM_BLOBS__WORD];
+    uint32_t *entry = waddr + SYSCFG_V2__BLOBS__WORD;
+
+    if (num_blobs > SYSCFG_MAX_BLOBS) {
+        printf("SYSCFG: ERROR: too many blobs: %u > %u\r\n",
+               num_blobs, SYSCFG_MAX_BLOBS);
+        return 4;
+    }
+    parse_cfg_word(cfg, waddr[SYSCFG_V2__CFG__WORD]);
+    cfg->sfs_offset = waddr[SYSCFG_V2__SFS_OFFSET__WORD];
+
+    for (unsigned i = 0; i < num_blobs; ++i, entry += SYSCFG_V2__BLOB__WORDS) {
+        struct syscfg_blob *b = &cfg->blobs[i];
+        uint32_t flags = entry[1];
+        b->hash = entry[0];
+        b->name = NULL;
+        b->subsys = (flags & SYSCFG_V2__BLOB_SUBSYS__MASK)
+                        >> SYSCFG_V2__BLOB_SUBSYS__SHIFT;
+        b->chan = (flags & SYSCFG_V2__BLOB_CHAN__MASK)
+                        >> SYSCFG_V2__BLOB_CHAN__SHIFT;
+        b->flags = (flags & SYSCFG_V2__BLOB_FLAGS__MASK)
+                        >> SYSCFG_V2__BLOB_FLAGS__SHIFT;
+        if (b->subsys != SUBSYS_RTPS_R52 && b->subsys != SUBSYS_RTPS_A53 &&
+            b->subsys != SUBSYS_HPPS) {
+            printf("SYSCFG: ERROR: blob #%08x: invalid subsystem: %x\r\n",
+                   b->hash, b->subsys);
+            return 5;
+        }
+    }
+    // the per-subsystem lists of names only exist in v1
+    cfg->rtps_r52.blobs[0] = NULL;
+    cfg->rtps_a53.blobs[0] = NULL;
+    cfg->hpps.blobs[0] = NULL;
+
+    cfg->version = 2;
+    cfg->num_blobs = num_blobs;
+    return 0;
+}
+
+int syscfg_load(struct syscfg *cfg, uint8_t *addr)
+{
+    uint32_t *waddr = (uint32_t *)addr;
+    int rc;
+
+    printf("SYSCFG: @%p word0: %x\r\n", addr, waddr[0]);
+
+    if (waddr[0] == SYSCFG_V2__MAGIC)
+        rc = load_v2(cfg, waddr);
+    else
+        rc = load_v1(cfg, waddr);
+    if (rc)
+        return rc;
+
     syscfg_print(cfg);
     return 0;
 }
@@ -40,6 +40,36 @@
 /* Max number of binary blobs in the lists of blobs */
 #define MAX_BLOBS 8
 
+/* Version 2 of the config record starts with a magic word (the first word of
+ * a v1 record is the config word above, whose upper bits are zero), and lists
+ * the blobs to load as fixed-size entries, in load order. A blob is named by
+ * the hash of its file name (see sfs_name_hash), so that no strings have to
+ * be parsed or compared at boot, and carries its own load flags. */
+#define SYSCFG_V2__MAGIC                   0x32474643 /* "CFG2" */
+#define SYSCFG_V2__CFG__WORD               1 /* same fields as v1 word 0 */
+#define SYSCFG_V2__SFS_OFFSET__WORD        2
+#define SYSCFG_V2__NUM_BLOBS__WORD         3
+#define SYSCFG_V2__BLOBS__WORD             4
+#define SYSCFG_V2__BLOB__WORDS             2 /* name hash, flags */
+
+/* Fields in the flags word of a v2 blob entry */
+#define SYSCFG_V2__BLOB_SUBSYS__SHIFT      0
+#define SYSCFG_V2__BLOB_SUBSYS__MASK       (0xf << SYSCFG_V2__BLOB_SUBSYS__SHIFT)
+#define SYSCFG_V2__BLOB_CHAN__SHIFT        4
+#define SYSCFG_V2__BLOB_CHAN__MASK         (0xf << SYSCFG_V2__BLOB_CHAN__SHIFT)
+#define SYSCFG_V2__BLOB_FLAGS__SHIFT       8
+#define SYSCFG_V2__BLOB_FLAGS__MASK        (0x7 << SYSCFG_V2__BLOB_FLAGS__SHIFT)
+
+/* Max number of blobs over all subsystems */
+#define SYSCFG_MAX_BLOBS (NUM_SUBSYSS * MAX_BLOBS)
+
+#define SYSCFG_BLOB_CHAN_ANY    0xf /* DMA channel hint: no preference */
+
+/* Load flags of a blob (v1 records get SYSCFG_BLOB_VERIFY|SYSCFG_BLOB_WARM) */
+#define SYSCFG_BLOB_VERIFY      0x1 /* check against manifest after load */
+#define SYSCFG_BLOB_COMPRESSED  0x2 /* decompressed by CPU: load after DMAs */
+#define SYSCFG_BLOB_WARM        0x4 /* on reboot, reuse copy if still intact */
+
 enum memdev {
     MEMDEV_TRCH_SMC_SRAM = 0x0,
     MEMDEV_TRCH_SMC_NAND = 0x1,
@@ -73,7 +103,16 @@ struct syscfg_hpps {
     const char *blobs[MAX_BLOBS];
 };
 
+struct syscfg_blob {
+    uint32_t hash; /* of the file name */
+    const char *name; /* NULL if the config has only the hash (v2) */
+    subsys_t subsys;
+    uint8_t chan; /* DMA channel hint */
+    uint8_t flags;
+};
+
 struct syscfg {
+    unsigned version;
     subsys_t subsystems; // bitmask of subsystems to boot
     enum rtps_mode rtps_mode;
     uint8_t rtps_cores; /* bitmask (valid only in SPLIT mode) */
@@ -83,8 +122,15 @@ struct syscfg {
     struct syscfg_rtps_r52 rtps_r52;
     struct syscfg_rtps_a53 rtps_a53;
     struct syscfg_hpps hpps;
+    struct syscfg_blob blobs[SYSCFG_MAX_BLOBS]; /* of all subsystems */
+    unsigned num_blobs;
 };
 
+/* syscfg_load: parse a config record of either version
+ *
+ * For either version, the blobs to load end up in cfg->blobs; the per
+ * subsystem lists of names are only filled in from a v1 record.
+ */
 int syscfg_load(struct syscfg *cfg, uint8_t *addr);
 void syscfg_print(struct syscfg *cfg);
 
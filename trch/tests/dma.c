@@ -6,6 +6,7 @@
 #include "hwinfo.h"
 #include "nvic.h"
 #include "test.h"
+#include "work.h"
 
 // We can't own it, because the ISR (which we can't own) needs to access it
 extern struct dma *trch_dma;
@@ -55,7 +56,8 @@ int test_trch_dma()
 
     printf("Waiting for DMA tx to complete\r\n");
 #if TEST_TRCH_DMA_CB
-    while (!dma_done);
+    while (!dma_done)
+        work_run_one(); // the callback is deferred from the ISR
 #else
     int rc = dma_wait(dma_tx);
     if (rc)
@@ -116,5 +116,6 @@ int test_etimer()
 cleanup:
     nvic_int_disable(TRCH_IRQ__ELAPSED_TIMER);
     etimer_destroy(et);
+    elapsed_timer = NULL;
     return rc;
 }
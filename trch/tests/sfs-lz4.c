@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include "console.h"
+#include "etimer.h"
+#include "hwinfo.h"
+#include "sfs.h"
+
+#include "test.h"
+
+// Benchmark loading the same blob stored raw vs. compressed. Both files must
+// be in the SFS image, each with its own load address:
+//   lz4-bench.raw: the blob as is
+//   lz4-bench.lz4: the blob compressed with tools/sfs-lz4.py (SFS_FD_LZ4 flag)
+#define BENCH_FILE_RAW "lz4-bench.raw"
+#define BENCH_FILE_LZ4 "lz4-bench.lz4"
+
+extern struct etimer *elapsed_timer; // defined near ISR
+
+static int timed_load(struct etimer *et, struct sfs *fs, const char *fname,
+                      struct sfs_stat *st, uint64_t *ns)
+{
+    struct sfs_file *f = sfs_open(fs, fname);
+    if (!f) {
+        printf("TEST: FAIL: SFS LZ4: file not found: %s\r\n", fname);
+        return 1;
+    }
+    sfs_stat(f, st);
+
+    uint64_t start = etimer_capture(et);
+    int rc = sfs_read(f, NULL, NULL);
+    *ns = etimer_capture(et) - start;
+    if (rc)
+        printf("TEST: FAIL: SFS LZ4: failed to load: %s\r\n", fname);
+    return rc;
+}
+
+int test_sfs_lz4(struct sfs *fs)
+{
+    struct sfs_stat st_raw, st_lz4;
+    uint64_t ns_raw, ns_lz4;
+    int rc = 1;
+
+    if (!fs) {
+        printf("TEST: FAIL: SFS LZ4: no file system\r\n");
+        return 1;
+    }
+
+    // there's only one instance, which boot trace may have created already
+    struct etimer *et = elapsed_timer;
+    if (!et) {
+        et = etimer_create("ETMR", ETIMER__BASE, NULL, NULL,
+                ETIMER_NOMINAL_FREQ_HZ, ETIMER_CLK_FREQ_HZ, ETIMER_MAX_DIVIDER);
+        if (!et)
+            return 1;
+        if (etimer_configure(et, ETIMER_CLK_FREQ_HZ, ETIMER_SYNC_SW, 0))
+            goto cleanup;
+    }
+
+    if (timed_load(et, fs, BENCH_FILE_RAW, &st_raw, &ns_raw))
+        goto cleanup;
+    if (timed_load(et, fs, BENCH_FILE_LZ4, &st_lz4, &ns_lz4))
+        goto cleanup;
+
+    if (st_raw.size != st_lz4.size) {
+        printf("TEST: FAIL: SFS LZ4: size mismatch: %u != %u\r\n",
+               st_raw.size, st_lz4.size);
+        goto cleanup;
+    }
+    const uint8_t *raw = (const uint8_t *)st_raw.load_addr;
+    const uint8_t *dec = (const uint8_t *)st_lz4.load_addr;
+    for (unsigned i = 0; i < st_raw.size; ++i) {
+        if (raw[i] != dec[i]) {
+            printf("TEST: FAIL: SFS LZ4: data mismatch at offset 0x%x\r\n", i);
+            goto cleanup;
+        }
+    }
+
+    // no 64-bit division (no libgcc); the loads take well under 4s
+    printf("TEST: SFS LZ4: %u bytes: raw %u us, compressed %u us\r\n",
+           st_raw.size, (uint32_t)ns_raw / 1000, (uint32_t)ns_lz4 / 1000);
+    rc = 0;
+cleanup:
+    if (et != elapsed_timer)
+        etimer_destroy(et);
+    return rc;
+}
@@ -1,4 +1,5 @@
 #include "test.h"
+#include "test-sha256.h"
 
 /* Run tests whose only dependency is at most the systick timer */
 int test_standalone()
@@ -36,5 +37,10 @@ int test_standalone()
     if (rc) return rc;
 #endif /* TEST_SHMEM */
 
+#if TEST_SHA256
+    rc = test_sha256();
+    if (rc) return rc;
+#endif /* TEST_SHA256 */
+
     return 0;
 }
@@ -1,6 +1,8 @@
 #ifndef TEST_H
 #define TEST_H
 
+struct sfs;
+
 int test_standalone();
 
 int test_trch_dma();
@@ -11,5 +13,6 @@ int test_wdts();
 int test_etimer();
 int test_core_rti_timer();
 int test_shmem();
+int test_sfs_lz4(struct sfs *fs);
 
 #endif // TEST_H
@@ -1,3 +1,5 @@
+#define DEBUG 0
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -7,6 +9,7 @@
 #include "reset.h"
 #include "hwinfo.h"
 #include "boot.h"
+#include "work.h"
 
 #include "watchdog.h"
 
@@ -64,13 +67,47 @@ static const struct wdt_group wdt_groups[] = {
                                /* timeouts ms */ { 5000, 400000} },
 };
 
-static void handle_timeout(struct wdt *wdt, unsigned stage, void *arg)
+// Reset of a group on expiration of any of its WDTs, deferred from the ISR
+static struct work timeout_work[NUM_CPU_GROUPS];
+
+static void handle_group_timeout(void *arg)
 {
     enum cpu_group_id gid = (unsigned)arg;
     const struct cpu_group *cpu_group = subsys_cpu_group(gid);
     int rc;
 
-    printf("watchdog: cpu %u: stage %u: expired\r\n", gid, stage);
+    printf("watchdog: cpu %u: expired: resetting\r\n", gid);
+
+    rc = reset_assert(cpu_group->cpu_set); // will prevent all CPUs from kicking
+    if (rc) {
+        printf("ERROR: WATCHDOG: failed to assert reset for cpu set: %x\r\n",
+               cpu_group->cpu_set);
+        return;
+    }
+
+    // Disable the WDTs for all other cores, so that they don't fire. By
+    // deiniting the WDTs in the group, we also disable their ISRs at the
+    // NVIC level. WDTs are re-initialized as part of the boot sequence.
+    watchdog_deinit_group(gid);
+
+    // NOTE: A potentially better alternative design is to reboot
+    // the cpu group here instead of the subsystem. Booting the subsystem
+    // means that the cpu group (i.e. subsystem's boot mode) is determined
+    // by boot config at boot time. This means that a reboot triggered
+    // by WDT would switch the mode if boot config changes between the
+    // preceding boot and the WDT triggered-reboot. We might want that.
+    // If we don't want it, then the boot interface should be changed to
+    // only allow booting cpu groups (i.e. booting an OS, i.e. booting
+    // into a mode given by the boot command instead of being pulled
+    // from the boot config) -- it's a subtle interface difference.
+    boot_request(cpu_group->subsys);
+}
+
+static void handle_timeout(struct wdt *wdt, unsigned stage, void *arg)
+{
+    enum cpu_group_id gid = (unsigned)arg;
+
+    DPRINTF("watchdog: cpu %u: stage %u: expired\r\n", gid, stage);
 
     if (gid == CPU_GROUP_TRCH) {
             ASSERT(stage == 0); // no last stage interrupt, because wired to hw reset
@@ -91,47 +128,16 @@ static void handle_timeout(struct wdt *wdt, unsigned stage, void *arg)
         ASSERT(stage == NUM_STAGES - 1); // first stage is handled by the target CPU
         ASSERT(!wdt_is_enabled(wdt)); // HW disables the timer on expiration
 
-        // The purpose of the following logic is to make the reset happen only
-        // once, upon the expiration of any WDT timer from the set of timers of
-        // a subsystem, instead of initiating a reset in response to the expiration
-        // of every timer in the set. The only-once logic is somewhat subtle, because we
-        // cannot know when the timers that were going to expire have expired and
-        // thus we could start the reboot. We cannot wait for all timers in the
-        // set to expire, becsause (1) the subsystem might not have enabled all
-        // timers, and (2) the subsystem might be in a half-broken state where
-        // it continues to kick some but not all timers.
-
-        rc = reset_assert(cpu_group->cpu_set); // will prevent all CPUs from kicking
-        if (rc) {
-            printf("ERROR: WATCHDOG: failed to assert reset for cpu set: %x\r\n",
-                   cpu_group->cpu_set);
-            return;
-        }
-
-        // Disable the WDTs for all other cores, so that they don't fire.  We
-        // might still get an ISR from timers that already expired before we
-        // disabled them, but that's ok: all of those ISRs (as well as the
-        // first one), will collectively enqueue only one reboot request. By
-        // deiniting the rest of the WDTs in the group, we also disable their
-        // ISRs at the NVIC level, so they won't fire. WDTs are re-initialized
-        // as part of the boot sequence.
-        watchdog_deinit_group(gid);
-
-        // Enqueue the request for the main loop
-        // Note: we cannot use the command queue because we want all ISRs
-        // in a sequence to collectively generate one request (see above).
-        //
-        // NOTE: A potentially better alternative design is to reboot
-        // the cpu group here instead of the subsystem. Booting the subsystem
-        // means that the cpu group (i.e. subsystem's boot mode) is determined
-        // by boot config at boot time. This means that a reboot triggered
-        // by WDT would switch the mode if boot config changes between the
-        // preceding boot and the WDT triggered-reboot. We might want that.
-        // If we don't want it, then the boot interface should be changed to
-        // only allow booting cpu groups (i.e. booting an OS, i.e. booting
-        // into a mode given by the boot command instead of being pulled
-        // from the boot config) -- it's a subtle interface difference.
-        boot_request(cpu_group->subsys);
+        // The reset must happen only once, upon the expiration of any WDT
+        // timer from the set of timers of a subsystem, instead of in response
+        // to the expiration of every timer in the set. We cannot wait for all
+        // timers in the set to expire, because (1) the subsystem might not
+        // have enabled all timers, and (2) the subsystem might be in a
+        // half-broken state where it continues to kick some but not all
+        // timers. The work item for the group is queued at most once, so all
+        // ISRs that fire before it runs (and deinits the group's WDTs)
+        // collectively generate one reset and one reboot request.
+        work_queue(&timeout_work[gid]);
     }
 }
 
@@ -185,6 +191,11 @@ static void destroy_wdt(struct wdt *wdt, unsigned irq)
 void watchdog_init_group(enum cpu_group_id gid)
 {
     const struct wdt_group *wdtg = &wdt_groups[gid];
+    // A second-stage ISR may have queued the item again while the previous
+    // timeout was handled: it must be off the queue before it is re-inited
+    work_cancel(&timeout_work[gid]);
+    work_init(&timeout_work[gid], wdtg->names[0], WORK_PRIO_HIGH,
+              handle_group_timeout, (void *)gid);
     for (unsigned i = 0; i < wdtg->num;  ++i) {
         struct wdt *wdt = create_wdt(wdtg->names[i],
                                      (wdtg->base + i * wdtg->as_size),